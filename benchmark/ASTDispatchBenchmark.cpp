@@ -0,0 +1,213 @@
+//! micro-benchmark of AST traversal dispatch
+
+#include <AST/AST.h>
+#include <AST/ASTVisitor.h>
+#include <Sema/ASTRewriter.h>
+#include <Util.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace toyc {
+
+namespace {
+
+/// build a balanced expression tree of about `size` nodes, mixing all
+/// expression kinds found in real programs
+auto BuildTree(size_t size, size_t &count) -> ExprPtr {
+  count++;
+  if (size <= 1) {
+    if (count % 2 == 0) {
+      return std::make_unique<IntegerLiteral>(static_cast<int64_t>(count),
+                                              "i64");
+    }
+    return std::make_unique<DeclRefExpr>(
+        std::make_unique<VarDecl>("x" + std::to_string(count % 16), "i64"));
+  }
+  switch (count % 4) {
+  case 0:
+    return std::make_unique<ParenExpr>(BuildTree(size - 1, count));
+  case 1:
+    return std::make_unique<ImplicitCastExpr>("i64",
+                                              BuildTree(size - 1, count));
+  case 2:
+    return std::make_unique<UnaryOperator>(Token(SUB, "-", 0, 0),
+                                           BuildTree(size - 1, count), "i64",
+                                           PREFIX);
+  default: {
+    size_t left = (size - 1) / 2;
+    ExprPtr l = BuildTree(left, count);
+    ExprPtr r = BuildTree(size - 1 - left, count);
+    return std::make_unique<BinaryOperator>(Token(ADD, "+", 0, 0), std::move(l),
+                                            std::move(r), "i64");
+  }
+  }
+}
+
+/// dispatch through `ASTVisitor::Visit`, as code generation does
+class CountingVisitor : public ASTVisitor<CountingVisitor> {
+public:
+  size_t count_{};
+
+  auto Codegen(const IntegerLiteral &expr) -> llvm::Value * {
+    count_++;
+    return nullptr;
+  }
+  auto Codegen(const FloatingLiteral &expr) -> llvm::Value * {
+    count_++;
+    return nullptr;
+  }
+  auto Codegen(const DeclRefExpr &expr) -> llvm::Value * {
+    count_++;
+    return nullptr;
+  }
+  auto Codegen(const ImplicitCastExpr &expr) -> llvm::Value * {
+    count_++;
+    return Visit(*expr.expr_);
+  }
+  auto Codegen(const ParenExpr &expr) -> llvm::Value * {
+    count_++;
+    return Visit(*expr.expr_);
+  }
+  auto Codegen(const CallExpr &expr) -> llvm::Value * {
+    count_++;
+    for (auto &arg : expr.args_) {
+      Visit(*arg);
+    }
+    return nullptr;
+  }
+  auto Codegen(const UnaryOperator &expr) -> llvm::Value * {
+    count_++;
+    return Visit(*expr.expr_);
+  }
+  auto Codegen(const BinaryOperator &expr) -> llvm::Value * {
+    count_++;
+    Visit(*expr.left_);
+    return Visit(*expr.right_);
+  }
+  auto Codegen(const ConditionalOperator &expr) -> llvm::Value * {
+    count_++;
+    Visit(*expr.cond_);
+    Visit(*expr.true_expr_);
+    return Visit(*expr.false_expr_);
+  }
+
+  auto Codegen(const CompoundStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const ExprStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const DeclStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const IfStmt &stmt) -> llvm::Value * { return nullptr; }
+  auto Codegen(const WhileStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const ForStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const ReturnStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const SwitchStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+  auto Codegen(const BreakStmt &stmt) -> llvm::Value * {
+    return nullptr;
+  }
+};
+
+/// dispatch through the `ASTRewriter` walk, as the AST passes do
+class CountingRewriter : public ASTRewriter {
+public:
+  size_t count_{};
+
+protected:
+  void Rewrite(ExprPtr &expr) override { count_++; }
+};
+
+/// the `dynamic_cast` chain the walks were written with before kind tags
+auto WalkDynamicCast(Expr *expr) -> size_t {
+  if (auto *e = dynamic_cast<ImplicitCastExpr *>(expr)) {
+    return 1 + WalkDynamicCast(e->expr_.get());
+  }
+  if (auto *e = dynamic_cast<ParenExpr *>(expr)) {
+    return 1 + WalkDynamicCast(e->expr_.get());
+  }
+  if (auto *e = dynamic_cast<CallExpr *>(expr)) {
+    size_t count = 1;
+    for (auto &arg : e->args_) {
+      count += WalkDynamicCast(arg.get());
+    }
+    return count;
+  }
+  if (auto *e = dynamic_cast<UnaryOperator *>(expr)) {
+    return 1 + WalkDynamicCast(e->expr_.get());
+  }
+  if (auto *e = dynamic_cast<BinaryOperator *>(expr)) {
+    return 1 + WalkDynamicCast(e->left_.get()) +
+           WalkDynamicCast(e->right_.get());
+  }
+  return 1;
+}
+
+/// @return best wall time of `runs` runs in milliseconds
+auto Measure(size_t runs, size_t expected, const std::function<size_t()> &fn)
+    -> double {
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = fn();
+    auto end = std::chrono::steady_clock::now();
+    if (count != expected) {
+      std::cerr << makeString("visited {} nodes, expected {}\n", count,
+                              expected);
+      exit(EXIT_FAILURE);
+    }
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+} // namespace toyc
+
+auto main(int argc, const char **argv) -> int {
+  size_t size = argc > 1 ? std::stoul(argv[1]) : 1 << 20;
+  size_t runs = argc > 2 ? std::stoul(argv[2]) : 10;
+
+  size_t count = 0;
+  toyc::ExprPtr root = toyc::BuildTree(size, count);
+
+  double visitor = toyc::Measure(runs, count, [&] {
+    toyc::CountingVisitor visitor;
+    visitor.Visit(*root);
+    return visitor.count_;
+  });
+  double rewriter = toyc::Measure(runs, count, [&] {
+    toyc::CountingRewriter rewriter;
+    rewriter.Run(root);
+    return rewriter.count_;
+  });
+  double dynamic_cast_walk = toyc::Measure(
+      runs, count, [&] { return toyc::WalkDynamicCast(root.get()); });
+
+  std::cout << makeString("{} nodes, best of {} runs\n", count, runs);
+  std::cout << makeString("  ASTVisitor::Visit    {:8.3f} ms\n", visitor);
+  std::cout << makeString("  ASTRewriter::Run     {:8.3f} ms\n", rewriter);
+  std::cout << makeString("  dynamic_cast chain   {:8.3f} ms\n",
+                          dynamic_cast_walk);
+  return 0;
+}
@@ -0,0 +1,104 @@
+//! benchmark of the AST dumper on large translation units
+
+#include <AST/AST.h>
+#include <AST/ASTPrint.h>
+#include <Parser/Parser.h>
+#include <Util.h>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <system_error>
+
+namespace toyc {
+
+namespace {
+
+/// a translation unit of `funcs` functions, about 100 nodes each
+auto MakeSource(size_t funcs) -> std::string {
+  std::string src = "i64 fn0(i64 a, i64 b) {\n  return a + b;\n}\n";
+  for (size_t i = 1; i < funcs; i++) {
+    src += makeString("i64 fn{}(i64 a, i64 b) {{\n"
+                      "  i64 x = a * 3 + b;\n"
+                      "  i64 y = (x - 1) * (a + 2);\n"
+                      "  if (x > y) {{\n"
+                      "    x = x + fn{}(y, a);\n"
+                      "  }} else {{\n"
+                      "    y = y - 1;\n"
+                      "  }}\n"
+                      "  while (x < 100) {{\n"
+                      "    x = x + y * 2;\n"
+                      "  }}\n"
+                      "  return x + y;\n"
+                      "}}\n",
+                      i, i - 1);
+  }
+  return src;
+}
+
+/// @return best wall time of `runs` runs in milliseconds
+auto Measure(size_t runs, const std::function<void()> &fn) -> double {
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+} // namespace toyc
+
+auto main(int argc, const char **argv) -> int {
+  size_t funcs = argc > 1 ? std::stoul(argv[1]) : 10000;
+  size_t runs = argc > 2 ? std::stoul(argv[2]) : 5;
+  /// the file system is part of what is measured, `/dev/null` by default
+  std::string dest = argc > 3 ? argv[3] : "/dev/null";
+
+  std::string src = toyc::MakeSource(funcs);
+  toyc::Parser parser;
+  parser.AddInput(src);
+  auto unit = parser.Parse();
+
+  std::cout << makeString("{} functions, best of {} runs\n", funcs, runs);
+  double stream = toyc::Measure(runs, [&] {
+    std::ofstream file(dest);
+    unit->Dump(file);
+  });
+  std::cout << makeString("  Dump to std::ostream    {:8.3f} ms\n", stream);
+
+  const std::pair<const char *, toyc::DumpFormat> formats[] = {
+      {"text", toyc::TEXT_DUMP},
+      {"json", toyc::JSON_DUMP},
+      {"binary", toyc::BINARY_DUMP},
+  };
+  for (bool color : {true, false}) {
+    for (const auto &[name, format] : formats) {
+      if (color && format != toyc::TEXT_DUMP) {
+        continue;
+      }
+      uint64_t bytes = 0;
+      double time = toyc::Measure(runs, [&] {
+        std::error_code ec;
+        llvm::raw_fd_ostream os(dest, ec);
+        toyc::ASTDumper(os, format, color).Dump(*unit);
+        bytes = os.tell();
+      });
+      std::cout << makeString("  {:6} {:9}        {:8.3f} ms {:10} bytes\n",
+                              name, color ? "colored" : "colorless", time,
+                              bytes);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,269 @@
+//! benchmark of the flat AST against the pointer tree
+
+#include <AST/AST.h>
+#include <AST/FlatAST.h>
+#include <Parser/Parser.h>
+#include <Sema/ASTRewriter.h>
+#include <Util.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace toyc {
+
+namespace {
+
+/// a translation unit of `funcs` functions, about 100 nodes each
+auto MakeSource(size_t funcs) -> std::string {
+  std::string src = "i64 fn0(i64 a, i64 b) {\n  return a + b;\n}\n";
+  for (size_t i = 1; i < funcs; i++) {
+    src += makeString("i64 fn{}(i64 a, i64 b) {{\n"
+                      "  i64 x = a * 3 + b;\n"
+                      "  i64 y = (x - 1) * (a + 2);\n"
+                      "  if (x > y) {{\n"
+                      "    x = x + fn{}(y, a);\n"
+                      "  }} else {{\n"
+                      "    y = y - 1;\n"
+                      "  }}\n"
+                      "  while (x < 100) {{\n"
+                      "    x = x + y * 2;\n"
+                      "  }}\n"
+                      "  return x + y;\n"
+                      "}}\n",
+                      i, i - 1);
+  }
+  return src;
+}
+
+/// heap bytes of a string beyond the inline buffer of libstdc++
+auto StringBytes(const std::string &str) -> size_t {
+  return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+auto TreeBytes(const Expr *expr) -> size_t;
+auto TreeBytes(const Stmt *stmt) -> size_t;
+
+/// bytes of the pointer tree, allocator overhead excluded
+auto TreeBytes(const Decl *decl) -> size_t {
+  if (decl == nullptr) {
+    return 0;
+  }
+  if (const auto *d = llvm::dyn_cast<ParmVarDecl>(decl)) {
+    return sizeof(ParmVarDecl) + StringBytes(d->name_) + StringBytes(d->type_);
+  }
+  if (const auto *d = llvm::dyn_cast<VarDecl>(decl)) {
+    return sizeof(VarDecl) + StringBytes(d->name_) + StringBytes(d->type_) +
+           TreeBytes(d->init_.get());
+  }
+  const auto &d = llvm::cast<FunctionDecl>(*decl);
+  size_t bytes = sizeof(FunctionDecl) + sizeof(FunctionProto) +
+                 StringBytes(d.proto_->name_) + StringBytes(d.proto_->type_) +
+                 d.proto_->params_.capacity() * sizeof(void *);
+  for (const auto &param : d.proto_->params_) {
+    bytes += TreeBytes(param.get());
+  }
+  return bytes + TreeBytes(d.body_.get());
+}
+
+auto TreeBytes(const Expr *expr) -> size_t {
+  if (expr == nullptr) {
+    return 0;
+  }
+  switch (expr->GetNodeKind()) {
+  case INTEGER_LITERAL:
+    return sizeof(IntegerLiteral) +
+           StringBytes(llvm::cast<IntegerLiteral>(*expr).type_);
+  case FLOATING_LITERAL:
+    return sizeof(FloatingLiteral) +
+           StringBytes(llvm::cast<FloatingLiteral>(*expr).type_);
+  case STRING_LITERAL: {
+    const auto &e = llvm::cast<StringLiteral>(*expr);
+    return sizeof(StringLiteral) + StringBytes(e.value_) + StringBytes(e.type_);
+  }
+  case DECL_REF_EXPR:
+    return sizeof(DeclRefExpr) +
+           TreeBytes(llvm::cast<DeclRefExpr>(*expr).decl_.get());
+  case IMPLICIT_CAST_EXPR: {
+    const auto &e = llvm::cast<ImplicitCastExpr>(*expr);
+    return sizeof(ImplicitCastExpr) + StringBytes(e.type_) +
+           TreeBytes(e.expr_.get());
+  }
+  case PAREN_EXPR:
+    return sizeof(ParenExpr) +
+           TreeBytes(llvm::cast<ParenExpr>(*expr).expr_.get());
+  case CALL_EXPR: {
+    const auto &e = llvm::cast<CallExpr>(*expr);
+    size_t bytes = sizeof(CallExpr) + TreeBytes(e.callee_.get()) +
+                   e.args_.capacity() * sizeof(void *);
+    for (const auto &arg : e.args_) {
+      bytes += TreeBytes(arg.get());
+    }
+    return bytes;
+  }
+  case UNARY_OPERATOR: {
+    const auto &e = llvm::cast<UnaryOperator>(*expr);
+    return sizeof(UnaryOperator) + StringBytes(e.type_) +
+           StringBytes(e.op_.value_) + TreeBytes(e.expr_.get());
+  }
+  case BINARY_OPERATOR: {
+    const auto &e = llvm::cast<BinaryOperator>(*expr);
+    return sizeof(BinaryOperator) + StringBytes(e.type_) +
+           StringBytes(e.op_.value_) + TreeBytes(e.left_.get()) +
+           TreeBytes(e.right_.get());
+  }
+  case CONDITIONAL_OPERATOR: {
+    const auto &e = llvm::cast<ConditionalOperator>(*expr);
+    return sizeof(ConditionalOperator) + StringBytes(e.type_) +
+           TreeBytes(e.cond_.get()) + TreeBytes(e.true_expr_.get()) +
+           TreeBytes(e.false_expr_.get());
+  }
+  default:
+    return 0;
+  }
+}
+
+auto TreeBytes(const Stmt *stmt) -> size_t {
+  if (stmt == nullptr) {
+    return 0;
+  }
+  switch (stmt->GetNodeKind()) {
+  case COMPOUND_STMT: {
+    const auto &s = llvm::cast<CompoundStmt>(*stmt);
+    size_t bytes = sizeof(CompoundStmt) + s.stmts_.capacity() * sizeof(void *);
+    for (const auto &child : s.stmts_) {
+      bytes += TreeBytes(child.get());
+    }
+    return bytes;
+  }
+  case EXPR_STMT:
+    return sizeof(ExprStmt) +
+           TreeBytes(llvm::cast<ExprStmt>(*stmt).expr_.get());
+  case DECL_STMT:
+    return sizeof(DeclStmt) +
+           TreeBytes(llvm::cast<DeclStmt>(*stmt).decl_.get());
+  case IF_STMT: {
+    const auto &s = llvm::cast<IfStmt>(*stmt);
+    return sizeof(IfStmt) + TreeBytes(s.cond_.get()) +
+           TreeBytes(s.then_stmt_.get()) + TreeBytes(s.else_stmt_.get());
+  }
+  case WHILE_STMT: {
+    const auto &s = llvm::cast<WhileStmt>(*stmt);
+    return sizeof(WhileStmt) + TreeBytes(s.cond_.get()) +
+           TreeBytes(s.stmt_.get());
+  }
+  case FOR_STMT: {
+    const auto &s = llvm::cast<ForStmt>(*stmt);
+    return sizeof(ForStmt) + TreeBytes(s.init_.get()) +
+           TreeBytes(s.cond_.get()) + TreeBytes(s.update_.get()) +
+           TreeBytes(s.body_.get());
+  }
+  case RETURN_STMT:
+    return sizeof(ReturnStmt) +
+           TreeBytes(llvm::cast<ReturnStmt>(*stmt).expr_.get());
+  case SWITCH_STMT: {
+    const auto &s = llvm::cast<SwitchStmt>(*stmt);
+    return sizeof(SwitchStmt) + TreeBytes(s.cond_.get()) +
+           TreeBytes(s.body_.get());
+  }
+  case CASE_STMT:
+    return sizeof(CaseStmt) +
+           TreeBytes(llvm::cast<CaseStmt>(*stmt).value_.get());
+  case DEFAULT_STMT:
+    return sizeof(DefaultStmt);
+  case BREAK_STMT:
+    return sizeof(BreakStmt);
+  default:
+    return 0;
+  }
+}
+
+/// count expressions and statements of the pointer tree
+class CountingRewriter : public ASTRewriter {
+public:
+  size_t count_{};
+
+protected:
+  void Rewrite(ExprPtr &expr) override { count_++; }
+  void Rewrite(StmtPtr &stmt) override { count_++; }
+};
+
+/// count expressions and statements of the flat AST, in the same order
+auto CountFlat(const FlatAST &ast, NodeId id) -> size_t {
+  size_t count = id.GetKind() < VAR_DECL ? 1 : 0;
+  ast.ForEachChild(id, [&](NodeId child) { count += CountFlat(ast, child); });
+  return count;
+}
+
+/// @return best wall time of `runs` runs in milliseconds
+auto Measure(size_t runs, const std::function<void()> &fn) -> double {
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+} // namespace toyc
+
+auto main(int argc, const char **argv) -> int {
+  size_t funcs = argc > 1 ? std::stoul(argv[1]) : 10000;
+  size_t runs = argc > 2 ? std::stoul(argv[2]) : 5;
+
+  std::string src = toyc::MakeSource(funcs);
+  toyc::Parser parser;
+  parser.AddInput(src);
+  auto unit = parser.Parse();
+
+  size_t tree_bytes = 0;
+  for (auto &decl : unit->decls_) {
+    tree_bytes += toyc::TreeBytes(decl.get());
+  }
+  auto flat_ast = toyc::FlatAST::Flatten(*unit);
+
+  size_t tree_count = 0;
+  double tree_walk = toyc::Measure(runs, [&] {
+    toyc::CountingRewriter rewriter;
+    rewriter.Run(*unit);
+    tree_count = rewriter.count_;
+  });
+  size_t flat_count = 0;
+  double flat_walk = toyc::Measure(runs, [&] {
+    flat_count = 0;
+    for (toyc::NodeId id : flat_ast.GetDecls()) {
+      flat_count += toyc::CountFlat(flat_ast, id);
+    }
+  });
+  if (tree_count != flat_count) {
+    std::cerr << makeString("walked {} nodes of the tree but {} flat nodes\n",
+                            tree_count, flat_count);
+    return 1;
+  }
+  double flatten = toyc::Measure(
+      runs, [&] { auto ast = toyc::FlatAST::Flatten(*unit); });
+  double expand = toyc::Measure(runs, [&] { auto tree = flat_ast.Expand(); });
+
+  std::cout << makeString("{} functions, {} nodes, best of {} runs\n", funcs,
+                          tree_count, runs);
+  std::cout << makeString("  pointer tree    {:10} bytes\n", tree_bytes);
+  std::cout << makeString("  flat AST        {:10} bytes ({:.2f}x smaller)\n",
+                          flat_ast.GetMemoryUsage(),
+                          static_cast<double>(tree_bytes) /
+                              static_cast<double>(flat_ast.GetMemoryUsage()));
+  std::cout << makeString("  walk tree       {:8.3f} ms\n", tree_walk);
+  std::cout << makeString("  walk flat       {:8.3f} ms\n", flat_walk);
+  std::cout << makeString("  flatten         {:8.3f} ms\n", flatten);
+  std::cout << makeString("  expand          {:8.3f} ms\n", expand);
+  return 0;
+}
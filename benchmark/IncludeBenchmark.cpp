@@ -0,0 +1,101 @@
+//! benchmark of precompiled includes against parsing include text
+
+#include <AST/FlatAST.h>
+#include <Parser/Parser.h>
+#include <Preprocessor/Preprocessor.h>
+#include <Util.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace toyc {
+
+namespace {
+
+/// an include file of `funcs` extern function declarations
+auto MakeInclude(size_t funcs) -> std::string {
+  std::string src;
+  for (size_t i = 0; i < funcs; i++) {
+    src += makeString("// function {}\n"
+                      "extern f64 fn{}(f64 x, i64 y, f64 z);\n",
+                      i, i);
+  }
+  return src;
+}
+
+/// @return best wall time of `runs` runs in milliseconds
+auto Measure(size_t runs, const std::function<void()> &fn) -> double {
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+} // namespace toyc
+
+auto main(int argc, const char **argv) -> int {
+  size_t funcs = argc > 1 ? std::stoul(argv[1]) : 10000;
+  size_t runs = argc > 2 ? std::stoul(argv[2]) : 10;
+
+  llvm::SmallString<128> path;
+  if (llvm::sys::fs::createTemporaryFile("toyc-include", "toyc", path)) {
+    std::cerr << "failed to create a temporary file\n";
+    return 1;
+  }
+  std::string src = path.str().str();
+  std::string cache = src + ".ast";
+  std::string content = toyc::MakeInclude(funcs);
+  if (!toyc::WriteTo(src, content)) {
+    std::cerr << makeString("failed to open file '{}'\n", src);
+    return 1;
+  }
+
+  /// what `toycc` does for an `#include` without and with a cached AST
+  double text = toyc::Measure(runs, [&] {
+    std::string input;
+    toyc::ReadFrom(src, input);
+    toyc::Preprocessor preprocessor;
+    preprocessor.SetInput(input);
+    input = preprocessor.Process();
+    toyc::Parser parser;
+    parser.AddInput(input);
+    parser.Parse();
+  });
+  {
+    toyc::Parser parser;
+    parser.AddInput(content);
+    toyc::FlatAST::Flatten(*parser.Parse()).Save(cache);
+  }
+  double load = toyc::Measure(runs, [&] { toyc::FlatAST::Load(cache); });
+  double precompiled = toyc::Measure(runs, [&] {
+    auto ast = toyc::FlatAST::Load(cache);
+    toyc::Parser parser;
+    for (toyc::NodeId id : ast->GetDecls()) {
+      parser.AddDeclaration(*ast->ExpandDecl(id));
+    }
+  });
+  llvm::sys::fs::remove(src);
+  llvm::sys::fs::remove(cache);
+
+  std::cout << makeString("{} declarations, {} bytes, best of {} runs\n",
+                          funcs, content.size(), runs);
+  std::cout << makeString("  preprocess + parse   {:8.3f} ms\n", text);
+  std::cout << makeString("  load AST             {:8.3f} ms\n", load);
+  std::cout << makeString("  load + declare       {:8.3f} ms\n", precompiled);
+  return 0;
+}
@@ -9,12 +9,15 @@
 
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Support/Casting.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace toyc {
@@ -24,40 +27,127 @@ enum Side {
   LEAF = 0,
 };
 
-struct ASTVisitor;
 struct TranslationUnitDecl;
 struct Decl;
 struct VarDecl;
 struct Stmt;
 struct Expr;
 
+/**
+ * @brief Kind tag of every AST node
+ *
+ * Visitors and passes `switch` on it, and it backs `classof`, so nodes can be
+ * tested with `llvm::isa` / `llvm::dyn_cast` instead of `dynamic_cast`.
+ */
+enum NodeKind {
+  /// Expr
+  INTEGER_LITERAL,
+  FLOATING_LITERAL,
+  STRING_LITERAL,
+  DECL_REF_EXPR,
+  IMPLICIT_CAST_EXPR,
+  PAREN_EXPR,
+  CALL_EXPR,
+  UNARY_OPERATOR,
+  BINARY_OPERATOR,
+  CONDITIONAL_OPERATOR,
+  /// Stmt
+  COMPOUND_STMT,
+  EXPR_STMT,
+  DECL_STMT,
+  IF_STMT,
+  WHILE_STMT,
+  FOR_STMT,
+  RETURN_STMT,
+  SWITCH_STMT,
+  CASE_STMT,
+  DEFAULT_STMT,
+  BREAK_STMT,
+  /// Decl
+  VAR_DECL,
+  PARM_VAR_DECL,
+  FUNCTION_DECL,
+};
+
+/**
+ * @brief 32-bit source location of a node, line and column from 1
+ *
+ * The line is kept in the high 20 bits and the column in the low 12 bits,
+ * larger values saturate, all bits clear is an unknown location.
+ */
+struct SourceLoc {
+  static constexpr uint32_t COL_BITS = 12;
+  static constexpr uint32_t MAX_COL = (1U << COL_BITS) - 1;
+  static constexpr uint32_t MAX_LINE = (1U << (32 - COL_BITS)) - 1;
+
+  uint32_t raw_{0};
+
+  SourceLoc() = default;
+  SourceLoc(size_t _line, size_t _col)
+      : raw_(static_cast<uint32_t>(std::min<size_t>(_line, MAX_LINE))
+                 << COL_BITS |
+             static_cast<uint32_t>(std::min<size_t>(_col, MAX_COL))) {}
+
+  auto IsValid() const -> bool { return raw_ != 0; }
+  auto GetLine() const -> uint32_t { return raw_ >> COL_BITS; }
+  auto GetCol() const -> uint32_t { return raw_ & MAX_COL; }
+
+  auto operator==(const SourceLoc &other) const -> bool = default;
+};
+
+/**
+ * @brief `std::make_unique` of a node at `loc`
+ */
+template <typename T, typename... Args>
+auto MakeNode(SourceLoc loc, Args &&...args) -> std::unique_ptr<T> {
+  auto node = std::make_unique<T>(std::forward<Args>(args)...);
+  node->loc_ = loc;
+  return node;
+}
+
 /* ================================== Expr ================================== */
 
 struct Expr {
+  const NodeKind node_kind_;
+  SourceLoc loc_;
+
+  explicit Expr(NodeKind _kind) : node_kind_(_kind) {}
   virtual ~Expr() = default;
+
+  auto GetNodeKind() const -> NodeKind { return node_kind_; }
+
   virtual auto GetType() const -> std::string = 0;
   virtual auto Assignable() const -> bool = 0;
   virtual auto IsConstant() const -> bool = 0;
-  virtual auto Accept(ASTVisitor &visitor) -> llvm::Value * = 0;
-  virtual void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-                    const std::string &_p = "") = 0;
+  virtual auto HasSideEffects() const -> bool = 0;
+  /// dump as a colored tree, see `ASTDumper` for other formats
+  void Dump(std::ostream &os = std::cerr) const;
 };
 
-struct Literal : public Expr {};
+struct Literal : public Expr {
+  explicit Literal(NodeKind _kind) : Expr(_kind) {}
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() >= INTEGER_LITERAL &&
+           expr->GetNodeKind() <= STRING_LITERAL;
+  }
+};
 
 struct IntegerLiteral : public Literal {
   int64_t value_;
   std::string type_;
 
   IntegerLiteral(int64_t value, std::string type)
-      : value_(value), type_(std::move(type)) {}
+      : Literal(INTEGER_LITERAL), value_(value), type_(std::move(type)) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return false; }
   auto IsConstant() const -> bool override { return true; };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override { return false; }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == INTEGER_LITERAL;
+  }
 };
 
 struct FloatingLiteral : public Literal {
@@ -65,14 +155,16 @@ struct FloatingLiteral : public Literal {
   std::string type_;
 
   FloatingLiteral(double value, std::string type)
-      : value_(value), type_(std::move(type)) {}
+      : Literal(FLOATING_LITERAL), value_(value), type_(std::move(type)) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return false; }
   auto IsConstant() const -> bool override { return true; };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override { return false; }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == FLOATING_LITERAL;
+  }
 };
 
 struct StringLiteral : public Literal {
@@ -80,28 +172,38 @@ struct StringLiteral : public Literal {
   std::string type_;
 
   StringLiteral(std::string value, std::string type)
-      : value_(std::move(value)), type_(std::move(type)) {}
+      : Literal(STRING_LITERAL), value_(std::move(value)),
+        type_(std::move(type)) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return false; }
   auto IsConstant() const -> bool override { return true; };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override { return false; }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == STRING_LITERAL;
+  }
 };
 
 struct DeclRefExpr : public Expr {
   std::unique_ptr<Decl> decl_;
 
-  explicit DeclRefExpr(std::unique_ptr<Decl> _decl) : decl_(std::move(_decl)) {}
-  explicit DeclRefExpr(DeclRefExpr *expr) : decl_(std::move(expr->decl_)) {}
+  explicit DeclRefExpr(std::unique_ptr<Decl> _decl)
+      : Expr(DECL_REF_EXPR), decl_(std::move(_decl)) {}
+  explicit DeclRefExpr(DeclRefExpr *expr)
+      : Expr(DECL_REF_EXPR), decl_(std::move(expr->decl_)) {
+    loc_ = expr->loc_;
+  }
 
   auto GetType() const -> std::string override;
-  auto Assignable() const -> bool override { return true; }
+  /// variables other than `const` ones
+  auto Assignable() const -> bool override;
   auto IsConstant() const -> bool override { return false; };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override { return false; }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == DECL_REF_EXPR;
+  }
 };
 
 struct ImplicitCastExpr : public Expr {
@@ -109,27 +211,37 @@ struct ImplicitCastExpr : public Expr {
   std::unique_ptr<Expr> expr_;
 
   ImplicitCastExpr(std::string type, std::unique_ptr<Expr> expr)
-      : type_(std::move(type)), expr_(std::move(expr)) {}
+      : Expr(IMPLICIT_CAST_EXPR), type_(std::move(type)),
+        expr_(std::move(expr)) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return expr_->Assignable(); }
   auto IsConstant() const -> bool override { return expr_->IsConstant(); };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override {
+    return expr_->HasSideEffects();
+  }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == IMPLICIT_CAST_EXPR;
+  }
 };
 
 struct ParenExpr : public Expr {
   std::unique_ptr<Expr> expr_;
 
-  explicit ParenExpr(std::unique_ptr<Expr> _expr) : expr_(std::move(_expr)) {}
+  explicit ParenExpr(std::unique_ptr<Expr> _expr)
+      : Expr(PAREN_EXPR), expr_(std::move(_expr)) {}
 
   auto GetType() const -> std::string override { return expr_->GetType(); }
   auto Assignable() const -> bool override { return expr_->Assignable(); }
   auto IsConstant() const -> bool override { return expr_->IsConstant(); };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override {
+    return expr_->HasSideEffects();
+  }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == PAREN_EXPR;
+  }
 };
 
 struct CallExpr : public Expr {
@@ -138,14 +250,16 @@ struct CallExpr : public Expr {
 
   CallExpr(std::unique_ptr<DeclRefExpr> _callee,
            std::vector<std::unique_ptr<Expr>> _args)
-      : callee_(std::move(_callee)), args_(std::move(_args)) {}
+      : Expr(CALL_EXPR), callee_(std::move(_callee)), args_(std::move(_args)) {}
 
   auto GetType() const -> std::string override { return callee_->GetType(); }
   auto Assignable() const -> bool override { return false; }
   auto IsConstant() const -> bool override { return false; };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override { return true; }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == CALL_EXPR;
+  }
 };
 
 enum UnarySide {
@@ -161,15 +275,20 @@ struct UnaryOperator : public Expr {
 
   UnaryOperator(Token _op, std::unique_ptr<Expr> _expr, std::string _type,
                 UnarySide _side)
-      : op_(std::move(_op)), expr_(std::move(_expr)), type_(std::move(_type)),
-        side_(_side) {}
+      : Expr(UNARY_OPERATOR), op_(std::move(_op)), expr_(std::move(_expr)),
+        type_(std::move(_type)), side_(_side) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return expr_->Assignable(); }
   auto IsConstant() const -> bool override { return expr_->IsConstant(); };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override {
+    return op_.type_ == INC_OP || op_.type_ == DEC_OP ||
+           expr_->HasSideEffects();
+  }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == UNARY_OPERATOR;
+  }
 };
 
 struct BinaryOperator : public Expr {
@@ -180,26 +299,73 @@ struct BinaryOperator : public Expr {
 
   BinaryOperator(Token _op, std::unique_ptr<Expr> _left,
                  std::unique_ptr<Expr> _right, std::string _type)
-      : op_(std::move(_op)), left_(std::move(_left)), right_(std::move(_right)),
-        type_(std::move(_type)) {}
+      : Expr(BINARY_OPERATOR), op_(std::move(_op)), left_(std::move(_left)),
+        right_(std::move(_right)), type_(std::move(_type)) {}
 
   auto GetType() const -> std::string override { return type_; }
   auto Assignable() const -> bool override { return false; }
   auto IsConstant() const -> bool override {
     return left_->IsConstant() && right_->IsConstant();
   };
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  auto HasSideEffects() const -> bool override {
+    return op_.type_ == EQUAL || left_->HasSideEffects() ||
+           right_->HasSideEffects();
+  }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == BINARY_OPERATOR;
+  }
+};
+
+/**
+ * @brief `cond_ ? true_expr_ : false_expr_`, only the selected arm is
+ * evaluated
+ *
+ * Both arms have the type of the node, the parser casts an `i64` arm to `f64`
+ * when the other one is `f64`.
+ */
+struct ConditionalOperator : public Expr {
+  std::unique_ptr<Expr> cond_;
+  std::unique_ptr<Expr> true_expr_;
+  std::unique_ptr<Expr> false_expr_;
+  std::string type_;
+
+  ConditionalOperator(std::unique_ptr<Expr> _cond,
+                      std::unique_ptr<Expr> _true_expr,
+                      std::unique_ptr<Expr> _false_expr, std::string _type)
+      : Expr(CONDITIONAL_OPERATOR), cond_(std::move(_cond)),
+        true_expr_(std::move(_true_expr)),
+        false_expr_(std::move(_false_expr)), type_(std::move(_type)) {}
+
+  auto GetType() const -> std::string override { return type_; }
+  auto Assignable() const -> bool override { return false; }
+  auto IsConstant() const -> bool override {
+    return cond_->IsConstant() && true_expr_->IsConstant() &&
+           false_expr_->IsConstant();
+  };
+  auto HasSideEffects() const -> bool override {
+    return cond_->HasSideEffects() || true_expr_->HasSideEffects() ||
+           false_expr_->HasSideEffects();
+  }
+
+  static auto classof(const Expr *expr) -> bool {
+    return expr->GetNodeKind() == CONDITIONAL_OPERATOR;
+  }
 };
 
 /* ================================== Stmt ================================== */
 
 struct Stmt {
+  const NodeKind node_kind_;
+  SourceLoc loc_;
+
+  explicit Stmt(NodeKind _kind) : node_kind_(_kind) {}
   virtual ~Stmt() = default;
-  virtual auto Accept(ASTVisitor &visitor) -> llvm::Value * = 0;
-  virtual void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-                    const std::string &_p = "") = 0;
+
+  auto GetNodeKind() const -> NodeKind { return node_kind_; }
+
+  /// dump as a colored tree, see `ASTDumper` for other formats
+  void Dump(std::ostream &os = std::cerr) const;
 };
 
 struct CompoundStmt : public Stmt {
@@ -207,32 +373,37 @@ struct CompoundStmt : public Stmt {
 
   explicit CompoundStmt(std::vector<std::unique_ptr<Stmt>> &&_stmts =
                             std::vector<std::unique_ptr<Stmt>>{})
-      : stmts_(std::move(_stmts)) {}
+      : Stmt(COMPOUND_STMT), stmts_(std::move(_stmts)) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == COMPOUND_STMT;
+  }
 };
 
 struct ExprStmt : public Stmt {
   std::unique_ptr<Expr> expr_;
 
-  explicit ExprStmt(std::unique_ptr<Expr> _expr) : expr_(std::move(_expr)) {}
+  explicit ExprStmt(std::unique_ptr<Expr> _expr)
+      : Stmt(EXPR_STMT), expr_(std::move(_expr)) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == EXPR_STMT;
+  }
 };
 
 struct DeclStmt : public Stmt {
   std::unique_ptr<Decl> decl_;
 
-  explicit DeclStmt(std::unique_ptr<Decl> _decl) : decl_(std::move(_decl)) {}
-  explicit DeclStmt(DeclStmt *stmt) : decl_(std::move(stmt->decl_)) {}
+  explicit DeclStmt(std::unique_ptr<Decl> _decl)
+      : Stmt(DECL_STMT), decl_(std::move(_decl)) {}
+  explicit DeclStmt(DeclStmt *stmt)
+      : Stmt(DECL_STMT), decl_(std::move(stmt->decl_)) {
+    loc_ = stmt->loc_;
+  }
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == DECL_STMT;
+  }
 };
 
 struct IfStmt : public Stmt {
@@ -242,12 +413,12 @@ struct IfStmt : public Stmt {
 
   IfStmt(std::unique_ptr<Expr> _cond, std::unique_ptr<Stmt> _thenStmt,
          std::unique_ptr<Stmt> _elseStmt)
-      : cond_(std::move(_cond)), then_stmt_(std::move(_thenStmt)),
-        else_stmt_(std::move(_elseStmt)) {}
+      : Stmt(IF_STMT), cond_(std::move(_cond)),
+        then_stmt_(std::move(_thenStmt)), else_stmt_(std::move(_elseStmt)) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == IF_STMT;
+  }
 };
 
 struct WhileStmt : public Stmt {
@@ -255,11 +426,11 @@ struct WhileStmt : public Stmt {
   std::unique_ptr<Stmt> stmt_;
 
   WhileStmt(std::unique_ptr<Expr> _cond, std::unique_ptr<Stmt> _stmt)
-      : cond_(std::move(_cond)), stmt_(std::move(_stmt)) {}
+      : Stmt(WHILE_STMT), cond_(std::move(_cond)), stmt_(std::move(_stmt)) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == WHILE_STMT;
+  }
 };
 
 struct ForStmt : public Stmt {
@@ -270,32 +441,89 @@ struct ForStmt : public Stmt {
 
   ForStmt(std::unique_ptr<DeclStmt> _init, std::unique_ptr<Expr> _cond,
           std::unique_ptr<Expr> _update, std::unique_ptr<Stmt> _body)
-      : init_(std::move(_init)), cond_(std::move(_cond)),
+      : Stmt(FOR_STMT), init_(std::move(_init)), cond_(std::move(_cond)),
         update_(std::move(_update)), body_(std::move(_body)) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == FOR_STMT;
+  }
 };
 
 struct ReturnStmt : public Stmt {
   std::unique_ptr<Expr> expr_;
 
-  explicit ReturnStmt(std::unique_ptr<Expr> _expr) : expr_(std::move(_expr)) {}
+  explicit ReturnStmt(std::unique_ptr<Expr> _expr)
+      : Stmt(RETURN_STMT), expr_(std::move(_expr)) {}
+
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == RETURN_STMT;
+  }
+};
+
+/**
+ * @brief `switch` on an `i64` value
+ *
+ * `body_` is a `CompoundStmt` whose statements may be `CaseStmt` and
+ * `DefaultStmt` labels, control enters after the matching label and falls
+ * through the following ones until a `break`.
+ */
+struct SwitchStmt : public Stmt {
+  std::unique_ptr<Expr> cond_;
+  std::unique_ptr<Stmt> body_;
+
+  SwitchStmt(std::unique_ptr<Expr> _cond, std::unique_ptr<Stmt> _body)
+      : Stmt(SWITCH_STMT), cond_(std::move(_cond)), body_(std::move(_body)) {}
+
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == SWITCH_STMT;
+  }
+};
+
+/// `case value:` label of the enclosing `SwitchStmt`, `value_` is constant
+struct CaseStmt : public Stmt {
+  std::unique_ptr<Expr> value_;
+
+  explicit CaseStmt(std::unique_ptr<Expr> _value)
+      : Stmt(CASE_STMT), value_(std::move(_value)) {}
+
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == CASE_STMT;
+  }
+};
+
+/// `default:` label of the enclosing `SwitchStmt`
+struct DefaultStmt : public Stmt {
+  DefaultStmt() : Stmt(DEFAULT_STMT) {}
+
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == DEFAULT_STMT;
+  }
+};
+
+/// leaves the innermost loop or `switch`
+struct BreakStmt : public Stmt {
+  BreakStmt() : Stmt(BREAK_STMT) {}
 
-  auto Accept(ASTVisitor &visitor) -> llvm::Value * override;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+  static auto classof(const Stmt *stmt) -> bool {
+    return stmt->GetNodeKind() == BREAK_STMT;
+  }
 };
 
 /* ================================== Decl ================================== */
 
 struct Decl {
+  const NodeKind node_kind_;
+  SourceLoc loc_;
+
+  explicit Decl(NodeKind _kind) : node_kind_(_kind) {}
   virtual ~Decl() = default;
+
+  auto GetNodeKind() const -> NodeKind { return node_kind_; }
+
   virtual auto GetName() const -> std::string = 0;
   virtual auto GetType() const -> std::string = 0;
-  virtual void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-                    const std::string &_p = "") = 0;
+  /// dump as a colored tree, see `ASTDumper` for other formats
+  void Dump(std::ostream &os = std::cerr) const;
 };
 
 enum VarScope {
@@ -303,37 +531,65 @@ enum VarScope {
   GLOBAL,
 };
 
+/// specifiers of a function or global variable, or-ed together
+enum DeclSpec : uint32_t {
+  NO_SPEC = 0,
+  STATIC_SPEC = 1U << 0, // internal to the translation unit
+  INLINE_SPEC = 1U << 1, // worth inlining, functions only
+  CONST_SPEC = 1U << 2,  // read-only after initialization, variables only
+};
+
 struct VarDecl : public Decl {
   std::string name_;
   std::string type_;
   std::unique_ptr<Expr> init_;
   VarScope scope_;
+  /// `DeclSpec` flags
+  uint32_t specs_;
 
   VarDecl(std::string _name, std::string _type,
-          std::unique_ptr<Expr> _init = nullptr, VarScope _scope = LOCAL)
-      : name_(std::move(_name)), type_(std::move(_type)),
-        init_(std::move(_init)), scope_(_scope) {}
+          std::unique_ptr<Expr> _init = nullptr, VarScope _scope = LOCAL,
+          uint32_t _specs = NO_SPEC)
+      : VarDecl(VAR_DECL, std::move(_name), std::move(_type),
+                std::move(_init), _scope, _specs) {}
 
   explicit VarDecl(VarDecl *decl)
-      : name_(decl->name_), type_(decl->type_), init_(std::move(decl->init_)),
-        scope_(decl->scope_) {}
+      : Decl(VAR_DECL), name_(decl->name_), type_(decl->type_),
+        init_(std::move(decl->init_)), scope_(decl->scope_),
+        specs_(decl->specs_) {
+    loc_ = decl->loc_;
+  }
+
+  auto IsStatic() const -> bool { return (specs_ & STATIC_SPEC) != 0; }
+  auto IsConst() const -> bool { return (specs_ & CONST_SPEC) != 0; }
 
   auto GetName() const -> std::string override { return name_; }
   auto GetType() const -> std::string override { return type_; }
-  auto Accept(ASTVisitor &visitor) -> llvm::Value *;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+
+  static auto classof(const Decl *decl) -> bool {
+    return decl->GetNodeKind() == VAR_DECL ||
+           decl->GetNodeKind() == PARM_VAR_DECL;
+  }
+
+protected:
+  VarDecl(NodeKind _kind, std::string _name, std::string _type,
+          std::unique_ptr<Expr> _init, VarScope _scope,
+          uint32_t _specs = NO_SPEC)
+      : Decl(_kind), name_(std::move(_name)), type_(std::move(_type)),
+        init_(std::move(_init)), scope_(_scope), specs_(_specs) {}
 };
 
 struct ParmVarDecl : public VarDecl {
   ParmVarDecl(std::string _name, std::string _type)
-      : VarDecl(std::move(_name), std::move(_type), nullptr, LOCAL) {}
+      : VarDecl(PARM_VAR_DECL, std::move(_name), std::move(_type), nullptr,
+                LOCAL) {}
 
   auto GetName() const -> std::string override { return name_; }
   auto GetType() const -> std::string override { return type_; }
-  auto Accept(ASTVisitor &visitor) -> llvm::Type *;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+
+  static auto classof(const Decl *decl) -> bool {
+    return decl->GetNodeKind() == PARM_VAR_DECL;
+  }
 };
 
 enum FuncKind {
@@ -359,19 +615,25 @@ struct FunctionDecl : public Decl {
   std::unique_ptr<FunctionProto> proto_;
   std::unique_ptr<Stmt> body_;
   FuncKind kind_;
+  /// `DeclSpec` flags
+  uint32_t specs_;
 
   explicit FunctionDecl(std::unique_ptr<FunctionProto> _proto,
                         std::unique_ptr<Stmt> _body = nullptr,
-                        FuncKind _kind = DEFINITION)
-      : proto_(std::move(_proto)), body_(std::move(_body)), kind_(_kind) {}
+                        FuncKind _kind = DEFINITION, uint32_t _specs = NO_SPEC)
+      : Decl(FUNCTION_DECL), proto_(std::move(_proto)), body_(std::move(_body)),
+        kind_(_kind), specs_(_specs) {}
 
   auto GetKind() -> FuncKind { return kind_; }
+  auto IsStatic() const -> bool { return (specs_ & STATIC_SPEC) != 0; }
+  auto IsInline() const -> bool { return (specs_ & INLINE_SPEC) != 0; }
 
   auto GetName() const -> std::string override { return proto_->name_; }
   auto GetType() const -> std::string override { return proto_->type_; }
-  auto Accept(ASTVisitor &visitor) -> llvm::Function *;
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "") override;
+
+  static auto classof(const Decl *decl) -> bool {
+    return decl->GetNodeKind() == FUNCTION_DECL;
+  }
 };
 
 /* ========================== TranslationUnitDecl =========================== */
@@ -383,9 +645,8 @@ struct TranslationUnitDecl {
                                    std::vector<std::unique_ptr<Decl>>{})
       : decls_(std::move(_decls)) {}
 
-  void Accept(ASTVisitor &visitor);
-  void Dump(std::ostream &os = std::cerr, size_t _d = 0, Side _s = LEAF,
-            const std::string &_p = "");
+  /// dump as a colored tree, see `ASTDumper` for other formats
+  void Dump(std::ostream &os = std::cerr) const;
 };
 
 } // namespace toyc
@@ -8,7 +8,12 @@
 #include <AST/AST.h>
 #include <Util.h>
 
-#include <string>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstddef>
+#include <cstdint>
 
 namespace toyc {
 
@@ -32,17 +37,74 @@ namespace toyc {
 #define _BOLD_CYAN "\033[1;36m"
 #define _BOLD_WHITE "\033[1;37m"
 
-#define AST_LEADER(__fmt__, ...) fmt::format(_BLUE __fmt__ _RST, ##__VA_ARGS__)
-#define AST_STMT(__fmt__, ...)                                                 \
-  fmt::format(_BOLD_MAGENTA __fmt__ _RST, ##__VA_ARGS__)
-#define AST_TYPE(__fmt__, ...) fmt::format(_GREEN __fmt__ _RST, ##__VA_ARGS__)
-#define AST_LITERAL(__fmt__, ...)                                              \
-  fmt::format(_BOLD_CYAN __fmt__ _RST, ##__VA_ARGS__)
-#define AST_DECL(__fmt__, ...)                                                 \
-  fmt::format(_BOLD_GREEN __fmt__ _RST, ##__VA_ARGS__)
-
-void PrintASTLeader(size_t _d, Side _s, std::string _p);
-auto AttachLeafLeader(Side _s, const std::string &_p) -> std::string;
+#define AST_LEADER_COLOR _BLUE
+#define AST_STMT_COLOR _BOLD_MAGENTA
+#define AST_TYPE_COLOR _GREEN
+#define AST_LITERAL_COLOR _BOLD_CYAN
+#define AST_DECL_COLOR _BOLD_GREEN
+
+enum DumpFormat {
+  TEXT_DUMP,   // indented tree
+  JSON_DUMP,   // nested objects, children under "inner"
+  BINARY_DUMP, // compact pre-order encoding
+};
+
+/**
+ * @brief Streaming AST dumper
+ *
+ * Writes straight into a buffered `llvm::raw_ostream`: no per-node strings
+ * are built, and the tree leader of the current depth lives in one buffer
+ * which grows and shrinks as the walk goes down and up.
+ *
+ * The binary format is the magic "TOYCDUMP", a ULEB128 version and a ULEB128
+ * count of root nodes, each node being its ULEB128 `NodeKind`, its fields in
+ * the order of the text dump (strings as a ULEB128 length and bytes, integers
+ * as SLEB128, floating numbers as 8 little-endian bytes, flags as one byte),
+ * a ULEB128 child count and the children.
+ */
+class ASTDumper {
+private:
+  llvm::raw_ostream &os_;
+  DumpFormat format_;
+  bool color_;
+
+  /// depth of the node being dumped
+  size_t depth_{0};
+  /// leader of the children of the node being dumped, text only
+  llvm::SmallString<128> prefix_;
+
+private:
+  void Header(size_t roots);
+
+  void Visit(const Expr &expr, Side side);
+  void Visit(const Stmt &stmt, Side side);
+  void Visit(const Decl &decl, Side side);
+  template <typename T> void Child(const T &node, size_t index, size_t count);
+
+  void Open(NodeKind kind, llvm::StringRef name, const char *color, Side side);
+  void Field(llvm::StringRef key, llvm::StringRef value, const char *color,
+             char quote);
+  void Field(llvm::StringRef key, int64_t value, const char *color);
+  void Field(llvm::StringRef key, double value, const char *color);
+  void Flag(llvm::StringRef key, bool value);
+  /// @return mark to restore the leader to in `Close`
+  auto Children(size_t count, llvm::StringRef indent) -> size_t;
+  void Close(size_t count, size_t mark);
+  void CloseLeaf();
+
+  void Colored(llvm::StringRef text, const char *color);
+  void Escaped(llvm::StringRef text);
+
+public:
+  explicit ASTDumper(llvm::raw_ostream &_os, DumpFormat _format = TEXT_DUMP,
+                     bool _color = false)
+      : os_(_os), format_(_format), color_(_color) {}
+
+  void Dump(const TranslationUnitDecl &unit);
+  void Dump(const Expr &expr);
+  void Dump(const Stmt &stmt);
+  void Dump(const Decl &decl);
+};
 
 } // namespace toyc
 
@@ -8,31 +8,80 @@
 #include <AST/AST.h>
 
 #include <llvm/IR/Value.h>
+#include <llvm/Support/Casting.h>
+#include <llvm/Support/ErrorHandling.h>
 
 namespace toyc {
 
-class ASTVisitor {
+/**
+ * @brief Dispatch on the kind tags of the nodes to the `Codegen` overloads of
+ * `Derived` (CRTP), which are called directly and can be inlined
+ *
+ * `Derived` provides one `Codegen` overload per expression and statement.
+ */
+template <typename Derived> class ASTVisitor {
+private:
+  auto GetDerived() -> Derived & { return static_cast<Derived &>(*this); }
+
 public:
-  virtual auto Codegen(const IntegerLiteral &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const FloatingLiteral &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const DeclRefExpr &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const ImplicitCastExpr &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const ParenExpr &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const CallExpr &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const UnaryOperator &expr) -> llvm::Value * = 0;
-  virtual auto Codegen(const BinaryOperator &expr) -> llvm::Value * = 0;
-
-  virtual auto Codegen(const CompoundStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const ExprStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const DeclStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const IfStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const WhileStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const ForStmt &stmt) -> llvm::Value * = 0;
-  virtual auto Codegen(const ReturnStmt &stmt) -> llvm::Value * = 0;
-
-  virtual auto Codegen(const VarDecl &decl) -> llvm::Value * = 0;
-  virtual auto Codegen(const ParmVarDecl &decl) -> llvm::Type * = 0;
-  virtual auto Codegen(const FunctionDecl &decl) -> llvm::Function * = 0;
+  /**
+   * @brief Dispatch `expr` to its `Codegen` overload by its kind tag
+   */
+  auto Visit(const Expr &expr) -> llvm::Value * {
+    switch (expr.GetNodeKind()) {
+    case INTEGER_LITERAL:
+      return GetDerived().Codegen(llvm::cast<IntegerLiteral>(expr));
+    case FLOATING_LITERAL:
+      return GetDerived().Codegen(llvm::cast<FloatingLiteral>(expr));
+    case STRING_LITERAL:
+      return nullptr;
+    case DECL_REF_EXPR:
+      return GetDerived().Codegen(llvm::cast<DeclRefExpr>(expr));
+    case IMPLICIT_CAST_EXPR:
+      return GetDerived().Codegen(llvm::cast<ImplicitCastExpr>(expr));
+    case PAREN_EXPR:
+      return GetDerived().Codegen(llvm::cast<ParenExpr>(expr));
+    case CALL_EXPR:
+      return GetDerived().Codegen(llvm::cast<CallExpr>(expr));
+    case UNARY_OPERATOR:
+      return GetDerived().Codegen(llvm::cast<UnaryOperator>(expr));
+    case BINARY_OPERATOR:
+      return GetDerived().Codegen(llvm::cast<BinaryOperator>(expr));
+    case CONDITIONAL_OPERATOR:
+      return GetDerived().Codegen(llvm::cast<ConditionalOperator>(expr));
+    default:
+      llvm_unreachable("invalid expression kind");
+    }
+  }
+
+  /**
+   * @brief Dispatch `stmt` to its `Codegen` overload by its kind tag
+   */
+  auto Visit(const Stmt &stmt) -> llvm::Value * {
+    switch (stmt.GetNodeKind()) {
+    case COMPOUND_STMT:
+      return GetDerived().Codegen(llvm::cast<CompoundStmt>(stmt));
+    case EXPR_STMT:
+      return GetDerived().Codegen(llvm::cast<ExprStmt>(stmt));
+    case DECL_STMT:
+      return GetDerived().Codegen(llvm::cast<DeclStmt>(stmt));
+    case IF_STMT:
+      return GetDerived().Codegen(llvm::cast<IfStmt>(stmt));
+    case WHILE_STMT:
+      return GetDerived().Codegen(llvm::cast<WhileStmt>(stmt));
+    case FOR_STMT:
+      return GetDerived().Codegen(llvm::cast<ForStmt>(stmt));
+    case RETURN_STMT:
+      return GetDerived().Codegen(llvm::cast<ReturnStmt>(stmt));
+    case SWITCH_STMT:
+      return GetDerived().Codegen(llvm::cast<SwitchStmt>(stmt));
+    case BREAK_STMT:
+      return GetDerived().Codegen(llvm::cast<BreakStmt>(stmt));
+    /// labels are lowered by their `SwitchStmt`
+    default:
+      llvm_unreachable("invalid statement kind");
+    }
+  }
 };
 
 } // namespace toyc
@@ -0,0 +1,483 @@
+//! flat index-based AST
+
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#pragma once
+
+#include <AST/AST.h>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace toyc {
+
+/**
+ * @brief 32-bit handle of a node in a `FlatAST`
+ *
+ * The kind tag is kept in the high 5 bits and the index into the vector of
+ * that kind in the low 27 bits, all bits set is the null handle.
+ */
+struct NodeId {
+  static constexpr uint32_t INDEX_BITS = 27;
+  static constexpr uint32_t MAX_INDEX = (1U << INDEX_BITS) - 1;
+  static constexpr uint32_t NULL_ID = UINT32_MAX;
+
+  uint32_t raw_{NULL_ID};
+
+  NodeId() = default;
+  NodeId(NodeKind _kind, uint32_t _index)
+      : raw_(static_cast<uint32_t>(_kind) << INDEX_BITS | _index) {}
+
+  auto IsNull() const -> bool { return raw_ == NULL_ID; }
+  auto GetKind() const -> NodeKind {
+    return static_cast<NodeKind>(raw_ >> INDEX_BITS);
+  }
+  auto GetIndex() const -> uint32_t { return raw_ & MAX_INDEX; }
+
+  auto operator==(const NodeId &other) const -> bool = default;
+};
+
+/// index into the string table of a `FlatAST`
+using StringId = uint32_t;
+
+/// contiguous range of `FlatAST::lists_`
+struct NodeList {
+  uint32_t begin_;
+  uint32_t size_;
+};
+
+/* ================================== Expr ================================== */
+
+struct FlatIntegerLiteral {
+  static constexpr NodeKind KIND = INTEGER_LITERAL;
+  int64_t value_;
+  StringId type_;
+  SourceLoc loc_;
+};
+
+struct FlatFloatingLiteral {
+  static constexpr NodeKind KIND = FLOATING_LITERAL;
+  double value_;
+  StringId type_;
+  SourceLoc loc_;
+};
+
+struct FlatStringLiteral {
+  static constexpr NodeKind KIND = STRING_LITERAL;
+  StringId value_;
+  StringId type_;
+  SourceLoc loc_;
+};
+
+struct FlatDeclRefExpr {
+  static constexpr NodeKind KIND = DECL_REF_EXPR;
+  /// `VAR_DECL` or `FUNCTION_DECL`, shared by all references to it
+  NodeId decl_;
+  SourceLoc loc_;
+};
+
+struct FlatImplicitCastExpr {
+  static constexpr NodeKind KIND = IMPLICIT_CAST_EXPR;
+  StringId type_;
+  NodeId expr_;
+  SourceLoc loc_;
+};
+
+struct FlatParenExpr {
+  static constexpr NodeKind KIND = PAREN_EXPR;
+  NodeId expr_;
+  SourceLoc loc_;
+};
+
+struct FlatCallExpr {
+  static constexpr NodeKind KIND = CALL_EXPR;
+  /// `DECL_REF_EXPR`
+  NodeId callee_;
+  NodeList args_;
+  SourceLoc loc_;
+};
+
+struct FlatUnaryOperator {
+  static constexpr NodeKind KIND = UNARY_OPERATOR;
+  NodeId expr_;
+  StringId type_;
+  StringId op_value_;
+  uint16_t op_type_;
+  uint16_t side_;
+  SourceLoc loc_;
+};
+
+struct FlatBinaryOperator {
+  static constexpr NodeKind KIND = BINARY_OPERATOR;
+  NodeId left_;
+  NodeId right_;
+  StringId type_;
+  StringId op_value_;
+  uint32_t op_type_;
+  SourceLoc loc_;
+};
+
+struct FlatConditionalOperator {
+  static constexpr NodeKind KIND = CONDITIONAL_OPERATOR;
+  NodeId cond_;
+  NodeId true_expr_;
+  NodeId false_expr_;
+  StringId type_;
+  SourceLoc loc_;
+};
+
+/* ================================== Stmt ================================== */
+
+struct FlatCompoundStmt {
+  static constexpr NodeKind KIND = COMPOUND_STMT;
+  NodeList stmts_;
+  SourceLoc loc_;
+};
+
+struct FlatExprStmt {
+  static constexpr NodeKind KIND = EXPR_STMT;
+  NodeId expr_;
+  SourceLoc loc_;
+};
+
+struct FlatDeclStmt {
+  static constexpr NodeKind KIND = DECL_STMT;
+  NodeId decl_;
+  SourceLoc loc_;
+};
+
+struct FlatIfStmt {
+  static constexpr NodeKind KIND = IF_STMT;
+  NodeId cond_;
+  NodeId then_stmt_;
+  NodeId else_stmt_;
+  SourceLoc loc_;
+};
+
+struct FlatWhileStmt {
+  static constexpr NodeKind KIND = WHILE_STMT;
+  NodeId cond_;
+  NodeId stmt_;
+  SourceLoc loc_;
+};
+
+struct FlatForStmt {
+  static constexpr NodeKind KIND = FOR_STMT;
+  /// `DECL_STMT`
+  NodeId init_;
+  NodeId cond_;
+  NodeId update_;
+  NodeId body_;
+  SourceLoc loc_;
+};
+
+struct FlatReturnStmt {
+  static constexpr NodeKind KIND = RETURN_STMT;
+  NodeId expr_;
+  SourceLoc loc_;
+};
+
+struct FlatSwitchStmt {
+  static constexpr NodeKind KIND = SWITCH_STMT;
+  NodeId cond_;
+  /// `COMPOUND_STMT`
+  NodeId body_;
+  SourceLoc loc_;
+};
+
+struct FlatCaseStmt {
+  static constexpr NodeKind KIND = CASE_STMT;
+  NodeId value_;
+  SourceLoc loc_;
+};
+
+struct FlatDefaultStmt {
+  static constexpr NodeKind KIND = DEFAULT_STMT;
+  SourceLoc loc_;
+};
+
+struct FlatBreakStmt {
+  static constexpr NodeKind KIND = BREAK_STMT;
+  SourceLoc loc_;
+};
+
+/* ================================== Decl ================================== */
+
+struct FlatVarDecl {
+  static constexpr NodeKind KIND = VAR_DECL;
+  StringId name_;
+  StringId type_;
+  NodeId init_;
+  uint32_t scope_;
+  uint32_t specs_;
+  SourceLoc loc_;
+};
+
+struct FlatParmVarDecl {
+  static constexpr NodeKind KIND = PARM_VAR_DECL;
+  StringId name_;
+  StringId type_;
+  SourceLoc loc_;
+};
+
+struct FlatFunctionDecl {
+  static constexpr NodeKind KIND = FUNCTION_DECL;
+  StringId name_;
+  StringId type_;
+  /// `PARM_VAR_DECL`
+  NodeList params_;
+  NodeId body_;
+  uint32_t refered_;
+  uint32_t kind_;
+  uint32_t specs_;
+  SourceLoc loc_;
+};
+
+/* ================================ FlatAST ================================= */
+
+/// location of a string in the string data of a `FlatAST`
+struct StringEntry {
+  uint32_t offset_;
+  uint32_t size_;
+};
+
+/// one table per node kind, in `NodeKind` order
+template <template <typename> class Table>
+using NodeTables =
+    std::tuple<Table<FlatIntegerLiteral>, Table<FlatFloatingLiteral>,
+               Table<FlatStringLiteral>, Table<FlatDeclRefExpr>,
+               Table<FlatImplicitCastExpr>, Table<FlatParenExpr>,
+               Table<FlatCallExpr>, Table<FlatUnaryOperator>,
+               Table<FlatBinaryOperator>, Table<FlatConditionalOperator>,
+               Table<FlatCompoundStmt>,
+               Table<FlatExprStmt>, Table<FlatDeclStmt>, Table<FlatIfStmt>,
+               Table<FlatWhileStmt>, Table<FlatForStmt>, Table<FlatReturnStmt>,
+               Table<FlatSwitchStmt>, Table<FlatCaseStmt>,
+               Table<FlatDefaultStmt>, Table<FlatBreakStmt>, Table<FlatVarDecl>,
+               Table<FlatParmVarDecl>, Table<FlatFunctionDecl>>;
+
+template <typename T> using NodeVector = std::vector<T>;
+
+class Flattener;
+
+/**
+ * @brief Flat encoding of a `TranslationUnitDecl`
+ *
+ * Nodes live in one contiguous vector per kind and refer to their children by
+ * `NodeId`, variable length children (statements of a block, arguments,
+ * parameters) are ranges of one shared list, names, types and string literal
+ * values are interned in a string table. Declarations referenced by
+ * `DeclRefExpr` are stored once and shared by all references.
+ *
+ * Tables hold no pointers, so the encoding is written to a file as is and
+ * read back by mapping the file, see `Save` and `Load`.
+ *
+ * Existing visitors run over it through `ExpandDecl`, which rebuilds the
+ * pointer tree of one top-level declaration at a time. Every node keeps its
+ * `SourceLoc`, source positions of operator tokens are not kept, nothing after
+ * parsing uses them.
+ */
+class FlatAST {
+  friend class Flattener;
+
+public:
+  /// version of the file layout, bump on any change of it or of a node layout
+  static constexpr uint32_t FORMAT_VERSION = 5;
+
+private:
+  /// storage of an AST built in memory, empty if loaded from a file
+  NodeTables<NodeVector> nodes_;
+  /// children of all `NodeList`s
+  std::vector<NodeId> lists_;
+  std::vector<StringEntry> strings_;
+  std::vector<char> string_data_;
+  /// top-level declarations in source order
+  std::vector<NodeId> decls_;
+  /// mapped file of an AST loaded by `Load`
+  std::unique_ptr<llvm::MemoryBuffer> buffer_;
+
+  /// views all accessors read through, over the storage above or `buffer_`
+  NodeTables<llvm::ArrayRef> node_views_;
+  llvm::ArrayRef<NodeId> lists_view_;
+  llvm::ArrayRef<StringEntry> strings_view_;
+  llvm::StringRef string_data_view_;
+  llvm::ArrayRef<NodeId> decls_view_;
+
+private:
+  template <typename T> auto Add(const T &node) -> NodeId;
+  void UpdateViews();
+
+public:
+  FlatAST() = default;
+  FlatAST(const FlatAST &) = delete;
+  FlatAST(FlatAST &&) = default;
+  auto operator=(const FlatAST &) -> FlatAST & = delete;
+  auto operator=(FlatAST &&) -> FlatAST & = default;
+
+  /**
+   * @brief Encode a translation unit, the tree itself is left untouched
+   */
+  static auto Flatten(const TranslationUnitDecl &unit) -> FlatAST;
+
+  /**
+   * @brief Map an AST written by `Save`, nodes are used in place
+   *
+   * @return nothing if the file can not be read or was written by another
+   * format version or on a machine of another byte order
+   */
+  static auto Load(const std::string &path) -> std::optional<FlatAST>;
+
+  /**
+   * @brief Write the encoding into `path`, replacing it atomically
+   *
+   * @return false if the file can not be written
+   */
+  auto Save(const std::string &path) const -> bool;
+
+public:
+  template <typename T> auto Get(NodeId id) const -> const T & {
+    return std::get<llvm::ArrayRef<T>>(node_views_)[id.GetIndex()];
+  }
+  template <typename T> auto GetAll() const -> llvm::ArrayRef<T> {
+    return std::get<llvm::ArrayRef<T>>(node_views_);
+  }
+  auto GetList(NodeList list) const -> const NodeId * {
+    return lists_view_.data() + list.begin_;
+  }
+  auto GetString(StringId id) const -> llvm::StringRef {
+    const StringEntry &entry = strings_view_[id];
+    return string_data_view_.substr(entry.offset_, entry.size_);
+  }
+  auto GetDecls() const -> llvm::ArrayRef<NodeId> { return decls_view_; }
+
+  /// number of nodes, shared reference declarations counted once
+  auto GetNodeCount() const -> size_t;
+  /// bytes held by node tables, lists and the string table
+  auto GetMemoryUsage() const -> size_t;
+
+  /**
+   * @brief Call `fn` on every child of `id` in source order, references of
+   * `DeclRefExpr` and the callee of `CallExpr` are not children
+   */
+  template <typename Fn> void ForEachChild(NodeId id, Fn &&fn) const;
+
+public:
+  /**
+   * @brief Rebuild the pointer tree of a node, so existing visitors and
+   * passes can run over it
+   */
+  auto ExpandExpr(NodeId id) const -> std::unique_ptr<Expr>;
+  auto ExpandStmt(NodeId id) const -> std::unique_ptr<Stmt>;
+  auto ExpandDecl(NodeId id) const -> std::unique_ptr<Decl>;
+  /// the name, type and parameters of a `FUNCTION_DECL`, without its body
+  auto ExpandPrototype(NodeId id) const -> std::unique_ptr<FunctionDecl>;
+  auto Expand() const -> std::unique_ptr<TranslationUnitDecl>;
+};
+
+template <typename Fn> void FlatAST::ForEachChild(NodeId id, Fn &&fn) const {
+  auto each = [&](NodeList list) {
+    const NodeId *children = GetList(list);
+    for (uint32_t i = 0; i < list.size_; i++) {
+      fn(children[i]);
+    }
+  };
+  auto child = [&](NodeId child) {
+    if (!child.IsNull()) {
+      fn(child);
+    }
+  };
+  switch (id.GetKind()) {
+  case IMPLICIT_CAST_EXPR:
+    child(Get<FlatImplicitCastExpr>(id).expr_);
+    break;
+  case PAREN_EXPR:
+    child(Get<FlatParenExpr>(id).expr_);
+    break;
+  case CALL_EXPR:
+    each(Get<FlatCallExpr>(id).args_);
+    break;
+  case UNARY_OPERATOR:
+    child(Get<FlatUnaryOperator>(id).expr_);
+    break;
+  case BINARY_OPERATOR: {
+    const auto &e = Get<FlatBinaryOperator>(id);
+    child(e.left_);
+    child(e.right_);
+    break;
+  }
+  case CONDITIONAL_OPERATOR: {
+    const auto &e = Get<FlatConditionalOperator>(id);
+    child(e.cond_);
+    child(e.true_expr_);
+    child(e.false_expr_);
+    break;
+  }
+  case COMPOUND_STMT:
+    each(Get<FlatCompoundStmt>(id).stmts_);
+    break;
+  case EXPR_STMT:
+    child(Get<FlatExprStmt>(id).expr_);
+    break;
+  case DECL_STMT:
+    child(Get<FlatDeclStmt>(id).decl_);
+    break;
+  case IF_STMT: {
+    const auto &s = Get<FlatIfStmt>(id);
+    child(s.cond_);
+    child(s.then_stmt_);
+    child(s.else_stmt_);
+    break;
+  }
+  case WHILE_STMT: {
+    const auto &s = Get<FlatWhileStmt>(id);
+    child(s.cond_);
+    child(s.stmt_);
+    break;
+  }
+  case FOR_STMT: {
+    const auto &s = Get<FlatForStmt>(id);
+    child(s.init_);
+    child(s.cond_);
+    child(s.update_);
+    child(s.body_);
+    break;
+  }
+  case RETURN_STMT:
+    child(Get<FlatReturnStmt>(id).expr_);
+    break;
+  case SWITCH_STMT: {
+    const auto &s = Get<FlatSwitchStmt>(id);
+    child(s.cond_);
+    child(s.body_);
+    break;
+  }
+  case CASE_STMT:
+    child(Get<FlatCaseStmt>(id).value_);
+    break;
+  case VAR_DECL:
+    child(Get<FlatVarDecl>(id).init_);
+    break;
+  case FUNCTION_DECL: {
+    const auto &d = Get<FlatFunctionDecl>(id);
+    each(d.params_);
+    child(d.body_);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+} // namespace toyc
+
+#endif
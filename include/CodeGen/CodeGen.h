@@ -7,12 +7,26 @@
 
 #include <AST/AST.h>
 #include <AST/ASTVisitor.h>
+#include <AST/FlatAST.h>
+#include <Sema/FunctionAttrInference.h>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 
 #include <map>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
 
 namespace toyc {
 
@@ -32,9 +46,12 @@ public:
 
 /**
  * Base IR visitor
+ *
+ * `Visit` calls the `Codegen` overloads shared by both tools directly, only
+ * the ones differing between the compiler and the interpreter are virtual.
  */
 
-class BaseIRVisitor : public ASTVisitor {
+class BaseIRVisitor : public ASTVisitor<BaseIRVisitor> {
 protected:
   std::unique_ptr<llvm::LLVMContext> context_;
   std::unique_ptr<llvm::Module> module_;
@@ -44,13 +61,176 @@ protected:
   /// local variable table
   std::map<std::string, llvm::AllocaInst *> var_env_;
 
+  /// keep local variables in SSA values instead of stack slots
+  bool direct_ssa_{false};
+  /// direct SSA: types of the local variables in scope
+  std::map<std::string, llvm::Type *> var_types_;
+  /// direct SSA: definition of each variable at the end of each block
+  std::map<std::string, std::map<llvm::BasicBlock *, llvm::Value *>>
+      current_defs_;
+  /// direct SSA: operand-less phis of blocks with unknown predecessors
+  std::map<llvm::BasicBlock *, std::map<std::string, llvm::PHINode *>>
+      incomplete_phis_;
+  /// direct SSA: blocks whose predecessors are all known
+  std::set<llvm::BasicBlock *> sealed_blocks_;
+  /// inferred function attributes: <name, attrs>
+  std::map<std::string, FunctionAttrs> func_attrs_;
+  /// bitcode of libtoyc, null if it is not installed
+  std::unique_ptr<llvm::MemoryBuffer> runtime_;
+  /// lower libtoyc math functions to LLVM intrinsics
+  bool builtins_{true};
+  /// exit blocks of the enclosing loops and `switch`es, innermost last
+  std::vector<llvm::BasicBlock *> break_targets_;
+
+  /// emit DWARF debug info, see `SetDebugInfo`
+  bool debug_info_{false};
+  /// debug info of the module, created with its first function
+  std::unique_ptr<llvm::DIBuilder> di_builder_;
+  llvm::DICompileUnit *di_unit_{nullptr};
+  /// subprogram of the function being generated, null outside functions
+  llvm::DISubprogram *di_scope_{nullptr};
+
+  /// `target-cpu` and `target-features` of the functions defined, empty for
+  /// the baseline CPU of the target
+  std::string target_cpu_;
+  std::string target_features_;
+
 protected:
   void PrintVarEnv();
-  void ClearVarEnv() { var_env_.clear(); }
+  void ClearVarEnv();
+
+  /// stack slot at the top of the entry block of the current function, so
+  /// that loops do not grow the stack and mem2reg can promote it
+  auto CreateEntryAlloca(llvm::Type *type) -> llvm::AllocaInst *;
+
+  /**
+   * @brief Local variable access, through stack slots or, in direct SSA mode,
+   * by building SSA values on the fly (Braun et al., "Simple and Efficient
+   * Construction of Static Single Assignment Form")
+   *
+   * In direct SSA mode the control flow code must `SealBlock` each block once
+   * all of its predecessors are branched from.
+   */
+  void DeclareVariable(const std::string &name, llvm::Type *type,
+                       llvm::Value *init);
+  auto IsLocalVariable(const std::string &name) -> bool;
+  auto ReadVariable(const std::string &name) -> llvm::Value *;
+  /// @return the store, or null in direct SSA mode
+  auto WriteVariable(const std::string &name, llvm::Value *value)
+      -> llvm::Value *;
+  /// drop a variable going out of scope
+  void ForgetVariable(const std::string &name);
+  void SealBlock(llvm::BasicBlock *block);
+
+  /// @return true if the block being generated already ends with a `ret` or
+  /// a branch, code following it in the same block can never run
+  auto IsTerminated() -> bool;
+
+  void AddFunctionAttrs(llvm::Function *func);
+  void AddCallAttrs(llvm::CallInst *call);
+
+  /**
+   * @brief Give a `static` function or global variable internal linkage, and
+   * `static` functions the fast calling convention, which callers pick up
+   * from the callee
+   */
+  virtual void SetStatic(llvm::GlobalObject *object);
+
+  /**
+   * @brief Lower a call of a libtoyc math function (`_sqrt`, `_fma`,
+   * `_absf`...) to the LLVM intrinsic of the same semantics, which the
+   * optimizer can fold, hoist and vectorize
+   *
+   * @return the intrinsic call, or null to call the runtime function
+   */
+  auto CodegenBuiltin(llvm::Function *callee,
+                      llvm::ArrayRef<llvm::Value *> args) -> llvm::Value *;
+
+  /// `value != 0` as an `i1`, booleans are returned as is
+  auto CodegenBool(llvm::Value *value) -> llvm::Value *;
+  /// `i1` booleans as 0 or 1 of `type`, other values are returned as is
+  auto CodegenNumber(llvm::Value *value, llvm::Type *type) -> llvm::Value *;
+  /// mark a call returned as is `tail`, and `musttail` when the signatures of
+  /// caller and callee agree
+  void MarkTailCall(llvm::Value *ret_val);
+  /**
+   * @brief `&&` and `||` with C semantics: the right operand runs only if the
+   * left one does not decide, behind a branch and merged by a phi, or both
+   * are evaluated and merged by a `select` when they are small and free of
+   * side effects
+   */
+  auto CodegenLogical(const BinaryOperator &expr) -> llvm::Value *;
+
+  /**
+   * @brief Debug info, all of them do nothing unless it is enabled
+   *
+   * The compile unit is named after the source file name of the module, and
+   * must be finalized by `FinalizeDebugInfo` before the module is verified,
+   * optimized or handed to the JIT.
+   */
+  void FinalizeDebugInfo();
+  /// attach `loc` to the instructions built from now on
+  void EmitLocation(SourceLoc loc);
+  /// describe the stack slot of a local variable or parameter (`arg_no` from
+  /// 1) to debuggers, variables in SSA values are not described
+  void DeclareDebugVariable(const std::string &name, SourceLoc loc,
+                            unsigned arg_no = 0);
+
+private:
+  auto ReadVariable(const std::string &name, llvm::BasicBlock *block)
+      -> llvm::Value *;
+  auto ReadVariableRecursive(const std::string &name, llvm::BasicBlock *block)
+      -> llvm::Value *;
+  auto CreatePhi(const std::string &name, llvm::BasicBlock *block)
+      -> llvm::PHINode *;
+  auto AddPhiOperands(const std::string &name, llvm::PHINode *phi)
+      -> llvm::Value *;
+  auto TryRemoveTrivialPhi(llvm::PHINode *phi) -> llvm::Value *;
+
+  void CreateCompileUnit();
+  auto GetDebugType(llvm::Type *type) -> llvm::DIType *;
 
 public:
   BaseIRVisitor() = default;
 
+public:
+  void SetDirectSSA(bool _direct) { direct_ssa_ = _direct; }
+  void SetBuiltins(bool _builtins) { builtins_ = _builtins; }
+  /// compile units, subprograms, line tables and variables for debuggers
+  /// and profilers
+  void SetDebugInfo(bool _debug) { debug_info_ = _debug; }
+  void SetFunctionAttrs(const std::map<std::string, FunctionAttrs> &attrs) {
+    func_attrs_ = attrs;
+  }
+  /**
+   * @brief Generate code for `_cpu` (`skylake`, `znver3`...), `native` is the
+   * CPU of the host with the features it reports
+   */
+  virtual void SetTargetCPU(const std::string &_cpu);
+  /// @return CPU and features `SetTargetCPU` uses for `cpu`
+  static auto ResolveTargetCPU(const std::string &cpu)
+      -> std::pair<std::string, std::string>;
+  /// `-mcpu` takes precedence over `-march`, in `toycc` and `toyci` alike
+  static auto SelectTargetCPU(const std::string &march,
+                              const std::string &mcpu) -> const std::string &;
+  /// whether the target of the host knows `cpu`, or it is `native`
+  static auto IsTargetCPUValid(const std::string &cpu) -> bool;
+
+public:
+  /**
+   * @brief Load the bitcode of libtoyc installed next to the executable, in
+   * `../lib/libtoyc.bc`
+   *
+   * @return false if there is none, calls then go to the shared library
+   */
+  auto LoadRuntime() -> bool;
+
+  /**
+   * @brief Link the runtime functions the module refers to into it, as
+   * internal definitions which the optimizer can inline and drop
+   */
+  void LinkRuntime();
+
 public:
   virtual void Dump(llvm::raw_ostream &os = llvm::errs());
   virtual auto VerifyModule(llvm::raw_ostream &os = llvm::errs()) -> bool;
@@ -59,32 +239,64 @@ public:
   virtual auto GetFunction(const FunctionDecl &decl) -> llvm::Function *;
 
 public:
-  auto Codegen(const IntegerLiteral &expr) -> llvm::Value * override;
-  auto Codegen(const FloatingLiteral &expr) -> llvm::Value * override;
-  auto Codegen(const ImplicitCastExpr &expr) -> llvm::Value * override;
-  auto Codegen(const ParenExpr &expr) -> llvm::Value * override;
+  auto Codegen(const IntegerLiteral &expr) -> llvm::Value *;
+  auto Codegen(const FloatingLiteral &expr) -> llvm::Value *;
+  auto Codegen(const ImplicitCastExpr &expr) -> llvm::Value *;
+  auto Codegen(const ParenExpr &expr) -> llvm::Value *;
+  /**
+   * @brief `?:` as a `select` of both arms when they are small and free of
+   * side effects, so min/max/clamp idioms do not branch, or as branches
+   * merged by a phi otherwise
+   */
+  auto Codegen(const ConditionalOperator &expr) -> llvm::Value *;
+
+public:
+  auto Codegen(const CompoundStmt &stmt) -> llvm::Value *;
+  auto Codegen(const ExprStmt &stmt) -> llvm::Value *;
+  auto Codegen(const DeclStmt &stmt) -> llvm::Value *;
+  auto Codegen(const IfStmt &stmt) -> llvm::Value *;
+  auto Codegen(const WhileStmt &stmt) -> llvm::Value *;
+  auto Codegen(const ForStmt &stmt) -> llvm::Value *;
+  auto Codegen(const ReturnStmt &stmt) -> llvm::Value *;
+  auto Codegen(const SwitchStmt &stmt) -> llvm::Value *;
+  auto Codegen(const BreakStmt &stmt) -> llvm::Value *;
 
 public:
-  auto Codegen(const CompoundStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const ExprStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const DeclStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const IfStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const WhileStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const ForStmt &stmt) -> llvm::Value * override;
-  auto Codegen(const ReturnStmt &stmt) -> llvm::Value * override;
+  virtual auto Codegen(const DeclRefExpr &expr) -> llvm::Value * = 0;
+  virtual auto Codegen(const CallExpr &expr) -> llvm::Value * = 0;
+  virtual auto Codegen(const UnaryOperator &expr) -> llvm::Value * = 0;
+  virtual auto Codegen(const BinaryOperator &expr) -> llvm::Value * = 0;
 
 public:
-  auto Codegen(const ParmVarDecl &decl) -> llvm::Type * override;
-  auto Codegen(const FunctionDecl &decl) -> llvm::Function * override;
+  virtual auto Codegen(const VarDecl &decl) -> llvm::Value * = 0;
+  auto Codegen(const ParmVarDecl &decl) -> llvm::Type *;
+  auto Codegen(const FunctionDecl &decl) -> llvm::Function *;
 };
 
-class CompilerIRVisitor : public BaseIRVisitor {
+class CompilerIRVisitor final : public BaseIRVisitor {
 private:
   /// global variable table
   std::map<std::string, llvm::GlobalVariable *> global_var_env_;
+  /// native target, only created when emitting object code
+  std::unique_ptr<llvm::TargetMachine> target_machine_;
+  /// profile guided optimization: instrumentation to insert or profile to
+  /// optimize with
+  std::optional<llvm::PGOOptions> pgo_;
+
+  /// lower every `shards_`-th function definition, from the `shard_`-th
+  size_t shard_{0};
+  size_t shards_{1};
+  /// function definitions met so far
+  size_t definitions_{0};
 
 private:
   void PrintGlobalVarEnv();
+  void CodegenTopLevel(const Decl &decl);
+  /// remove not used extern functions
+  void RemoveUnusedExternFunctions();
+
+protected:
+  void SetStatic(llvm::GlobalObject *object) override;
 
 public:
   CompilerIRVisitor();
@@ -92,7 +304,87 @@ public:
 public:
   void SetModuleID(std::string &name);
 
+  /**
+   * @brief Lower only a shard of the unit, so that shards can be lowered and
+   * optimized in parallel, each visitor having its own context
+   *
+   * The function definitions of other shards become declarations, global
+   * variables are defined by shard 0 and declared by the others. `static`
+   * names are hidden instead of internal, so the shards can refer to them.
+   *
+   * @param _shard index of the shard
+   * @param _shards number of shards
+   */
+  void SetShard(size_t _shard, size_t _shards) {
+    shard_ = _shard;
+    shards_ = _shards;
+  }
+
+  /**
+   * @brief Write the module as bitcode, to move it to another context
+   *
+   * @param os output stream
+   */
+  void WriteBitcode(llvm::raw_ostream &os);
+
+  /**
+   * @brief Link a module written by `WriteBitcode` into this one
+   *
+   * @param bitcode bitcode of the module
+   */
+  void LinkBitcode(llvm::MemoryBufferRef bitcode);
+
+  /**
+   * @brief Give the `static` names hidden by `SetShard` internal linkage
+   * again, once the modules of all shards are linked into this one
+   */
+  void InternalizeShards();
+
+  /**
+   * @brief Instrument the module to count the blocks and calls executed, the
+   * program writes the counts to `_file` when it exits
+   *
+   * @param _file raw profile, `default.profraw` when empty
+   */
+  void SetProfileGenerate(const std::string &_file) {
+    pgo_ = llvm::PGOOptions(_file, "", "", llvm::PGOOptions::IRInstr);
+  }
+
+  /**
+   * @brief Optimize with the counts of a profile: branch weights for block
+   * placement, hot call sites for inlining and cold code split out of hot
+   * functions
+   *
+   * @param _file profile indexed by `llvm-profdata merge`
+   */
+  void SetProfileUse(const std::string &_file) {
+    pgo_ = llvm::PGOOptions(_file, "", "", llvm::PGOOptions::IRUse);
+  }
+
+  /**
+   * @brief Run the standard per-module pipeline of the new pass manager,
+   * `O0` leaves the module untouched unless it is instrumented
+   *
+   * @param level optimization level
+   */
+  void Optimize(llvm::OptimizationLevel level);
+
+  /**
+   * @brief Create the machine of the host target, for the CPU given to
+   * `SetTargetCPU`, and give its data layout to the module, call it before
+   * `Optimize` so passes see the target
+   */
+  void InitializeTarget();
+
+  /**
+   * @brief Emit the module as a native object file
+   *
+   * @param os output stream
+   */
+  void EmitObject(llvm::raw_pwrite_stream &os);
+
 public:
+  using BaseIRVisitor::Codegen;
   auto Codegen(const DeclRefExpr &expr) -> llvm::Value * override;
   auto Codegen(const CallExpr &expr) -> llvm::Value * override;
   auto Codegen(const UnaryOperator &expr) -> llvm::Value * override;
@@ -103,6 +395,7 @@ public:
 
 public:
   void Codegen(const TranslationUnitDecl &decl);
+  void Codegen(const FlatAST &ast);
 };
 
 } // namespace toyc
@@ -9,6 +9,7 @@
 #include <AST/ASTVisitor.h>
 #include <CodeGen/CodeGen.h>
 #include <Interpreter/JIT.h>
+#include <Sema/ConstantFolder.h>
 
 #include <llvm/ADT/APFloat.h>
 #include <llvm/ADT/APInt.h>
@@ -24,11 +25,12 @@
 #include <llvm/Support/Error.h>
 
 #include <memory>
+#include <optional>
 #include <utility>
 
 namespace toyc {
 
-class InterpreterIRVisitor : public BaseIRVisitor {
+class InterpreterIRVisitor final : public BaseIRVisitor {
 private:
   std::unique_ptr<ToycJIT> jit_;
   std::unique_ptr<llvm::legacy::FunctionPassManager> fpm_;
@@ -45,6 +47,9 @@ private:
     std::string name_;
     std::string type_;
     size_t refered_;
+    /// value of a `const` variable with a constant initializer, which reads
+    /// fold to, modules do not share their contexts so no `llvm::Constant`
+    std::optional<ConstantValue> value_;
     GlobalVar(std::string _name, std::string _type, size_t _refered)
         : name_(std::move(_name)), type_(std::move(_type)), refered_(_refered) {
     }
@@ -53,8 +58,13 @@ private:
   std::map<std::string, std::unique_ptr<GlobalVar>> global_var_env_;
   std::map<std::string, std::unique_ptr<FunctionProto>> function_env_;
 
+  /// source file name of every module, for debug info
+  std::string source_name_;
+
 private:
   void Initialize();
+  /// hand the module over to the JIT, `Initialize` must follow
+  auto TakeModule() -> llvm::orc::ThreadSafeModule;
   void ResetReferGlobalVar();
   void ResetReferFunctionProto();
 
@@ -65,7 +75,20 @@ public:
   auto GetGlobalVar(const std::string &name) -> llvm::GlobalVariable *;
   auto GetFunction(const FunctionDecl &decl) -> llvm::Function * override;
 
+  /**
+   * @brief Emit debug info for the code of `source` and make it visible to gdb
+   * and perf once JIT compiled
+   */
+  void EnableDebugInfo(const std::string &source);
+
+  /**
+   * @brief Generate code for `_cpu`, in the functions and in the JIT, which is
+   * created anew for it: call it before anything else
+   */
+  void SetTargetCPU(const std::string &_cpu) override;
+
 public:
+  using BaseIRVisitor::Codegen;
   auto Codegen(const DeclRefExpr &expr) -> llvm::Value * override;
   auto Codegen(const CallExpr &expr) -> llvm::Value * override;
   auto Codegen(const UnaryOperator &expr) -> llvm::Value * override;
@@ -0,0 +1,85 @@
+//! content-addressed cache of compiler outputs
+
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <string>
+
+namespace toyc {
+
+/// counters of a cache directory, kept in its `stats` file
+struct CacheStats {
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+  /// bytes of all entries
+  uint64_t size_{0};
+};
+
+/**
+ * @brief Outputs of `toycc` in a local directory, keyed by a hash of all
+ * that determines them, like ccache
+ *
+ * Entries live in `<dir>/<first 2 hex digits>/<key>`. They are written to a
+ * temporary file renamed into place, so concurrent compilers never read a
+ * partial entry. A hit refreshes the modification time of its entry, and a
+ * store beyond the size limit evicts the least recently used entries.
+ */
+class CompileCache {
+private:
+  std::string dir_;
+  /// bytes the entries may take
+  uint64_t max_size_;
+
+private:
+  auto GetEntryPath(llvm::StringRef key) -> std::string;
+  auto GetStatsPath() -> std::string;
+
+  /// lock the stats file, let `update` change the counters and write them
+  /// back, so compilers running at once do not lose counts
+  void UpdateStats(llvm::function_ref<void(CacheStats &)> update);
+
+  /**
+   * @brief Remove the least recently used entries until at most `target`
+   * bytes are left
+   *
+   * @return bytes of the entries left
+   */
+  auto Evict(uint64_t target) -> uint64_t;
+
+public:
+  CompileCache(std::string _dir, uint64_t _max_size);
+
+  /**
+   * @brief Hash the parts of a key, so that no two lists of parts collide by
+   * moving text from one part to the next
+   *
+   * @return SHA-256 digest in hex
+   */
+  static auto HashKey(llvm::ArrayRef<std::string> parts) -> std::string;
+
+  /**
+   * @brief Write the entry of `key` to `os`
+   *
+   * @return false on a miss
+   */
+  auto Fetch(llvm::StringRef key, llvm::raw_ostream &os) -> bool;
+
+  /// a cache which can not be written to is only skipped
+  void Store(llvm::StringRef key, llvm::StringRef content);
+
+  auto GetStats() -> CacheStats;
+  auto GetDir() const -> const std::string & { return dir_; }
+  auto GetMaxSize() const -> uint64_t { return max_size_; }
+};
+
+} // namespace toyc
+
+#endif
@@ -5,12 +5,30 @@
 
 #pragma once
 
+#include <AST/ASTPrint.h>
+#include <AST/FlatAST.h>
 #include <CodeGen/CodeGen.h>
+#include <Compiler/CompileCache.h>
 #include <Parser/Parser.h>
 #include <Preprocessor/Preprocessor.h>
 
+#include <llvm/Passes/OptimizationLevel.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace toyc {
 
+enum OutputKind {
+  IR_FILE,     // textual LLVM IR
+  OBJECT_FILE, // native object code
+};
+
 /**
  * @brief compiler frontend
  *
@@ -22,16 +40,156 @@ private:
   Parser parser_;
   CompilerIRVisitor visitor_;
 
+  /// load `#include` files from binary ASTs cached next to them
+  bool precompiled_includes_{false};
+  /// dump the checked AST in this format instead of emitting IR
+  std::optional<DumpFormat> ast_dump_;
+  /// level of the IR optimization pipeline
+  llvm::OptimizationLevel opt_level_{llvm::OptimizationLevel::O0};
+  OutputKind output_kind_{IR_FILE};
+  /// link the bitcode of libtoyc into the module when optimizing
+  bool link_runtime_{true};
+  bool direct_ssa_{false};
+  /// lower libtoyc math functions to LLVM intrinsics
+  bool builtins_{true};
+  /// emit DWARF debug info
+  bool debug_info_{false};
+  /// number of shards the functions are lowered in, in parallel
+  size_t jobs_{1};
+  /// CPU to generate code for, empty for the baseline of the target
+  std::string target_cpu_;
+  /// raw profile the instrumented program writes, see `SetProfileGenerate`
+  std::optional<std::string> profile_generate_;
+  /// indexed profile to optimize with
+  std::optional<std::string> profile_use_;
+  /// time the phases of `Compile`, see `SetTimeReport`
+  bool time_report_{false};
+  bool print_time_report_{false};
+  std::string time_report_json_;
+  /// outputs of earlier compiles, null when not caching
+  std::unique_ptr<CompileCache> cache_;
+
+private:
+  /**
+   * @brief Load the AST of an `#include` file from its cache, the cache is
+   * (re)built from the file if missing or older than it
+   *
+   * @param path path of the included file
+   */
+  static auto LoadInclude(const std::string &path) -> FlatAST;
+
+  /**
+   * @brief Key of the output in the cache: a hash of the preprocessed input,
+   * the precompiled includes, the compiler, the runtime and the options
+   *
+   * @param src source code filepath
+   * @param input preprocessed source code
+   */
+  auto GetCacheKey(const std::string &src, const std::string &input)
+      -> std::string;
+
+  /// parse and compile the preprocessed `input`, for `Compile`
+  void CompilePreprocessed(std::string &src, std::string &input,
+                           llvm::raw_pwrite_stream &os);
+
+  /// link the runtime into the module and optimize it, for `Compile`
+  void Lower(CompilerIRVisitor &visitor);
+
+  /**
+   * @brief Lower the unit in `jobs_` shards on a thread pool, each in a
+   * context of its own, then link the modules (IR) or the objects
+   *
+   * @param ast checked unit
+   * @param attrs inferred function attributes
+   * @param src source code filepath
+   * @param os output stream
+   */
+  void CompileShards(const FlatAST &ast,
+                     const std::map<std::string, FunctionAttrs> &attrs,
+                     std::string &src, llvm::raw_pwrite_stream &os);
+
+  /**
+   * @brief run a system compiler driver
+   *
+   * @param args arguments after the driver
+   * @param output file it produces, for error messages
+   * @param driver name of the driver
+   * @return true if the driver succeeded
+   */
+  static auto RunDriver(const std::vector<std::string> &args,
+                        const std::string &output,
+                        const std::string &driver = "cc") -> bool;
+
 public:
   Compiler() = default;
 
+public:
+  void SetPrecompiledIncludes(bool _precompiled) {
+    precompiled_includes_ = _precompiled;
+  }
+  void SetASTDump(DumpFormat _format) { ast_dump_ = _format; }
+  void SetOptLevel(llvm::OptimizationLevel _level) { opt_level_ = _level; }
+  void SetOutputKind(OutputKind _kind) { output_kind_ = _kind; }
+  void SetLinkRuntime(bool _link) { link_runtime_ = _link; }
+  /// build SSA values for local variables instead of stack slots
+  void SetDirectSSA(bool _direct) { direct_ssa_ = _direct; }
+  void SetBuiltins(bool _builtins) { builtins_ = _builtins; }
+  void SetDebugInfo(bool _debug) { debug_info_ = _debug; }
+  void SetJobs(size_t _jobs) { jobs_ = _jobs == 0 ? 1 : _jobs; }
+  /// `native` stands for the CPU of the host
+  void SetTargetCPU(const std::string &_cpu) { target_cpu_ = _cpu; }
+  /// instrument the program, `_file` empty for `default.profraw`
+  void SetProfileGenerate(const std::string &_file) {
+    profile_generate_ = _file;
+  }
+  void SetProfileUse(const std::string &_file) { profile_use_ = _file; }
+
   /**
-   * @brief compile source code to byte code (IR)
+   * @brief Time the phases of `Compile` (preprocess, lex and parse, sema
+   * with each AST pass, codegen, verify, opt and emit) and, without shards,
+   * the LLVM passes run by the optimizer and the backend
+   *
+   * The timers are reported by `ReportTimes`.
+   *
+   * @param _print print the wall, user and system time of each to stderr
+   * @param _json also write them as JSON into this file, unless empty
+   */
+  void SetTimeReport(bool _print, const std::string &_json);
+  void ReportTimes();
+
+  /**
+   * @brief Fetch outputs from a cache in `_dir` instead of compiling again,
+   * and store them there
+   *
+   * @param _dir cache directory, created if missing
+   * @param _max_size bytes the cached outputs may take
+   */
+  void SetCache(const std::string &_dir, uint64_t _max_size) {
+    cache_ = std::make_unique<CompileCache>(_dir, _max_size);
+  }
+  /// @return null when not caching
+  auto GetCache() -> CompileCache * { return cache_.get(); }
+
+  /**
+   * @brief compile source code to byte code (IR) or object code
    *
    * @param src source code filepath
    * @param os output stream
    */
-  void Compile(std::string &src, llvm::raw_ostream &os);
+  void Compile(std::string &src, llvm::raw_pwrite_stream &os);
+
+  /**
+   * @brief link an object file against `libtoyc` with the system compiler
+   * driver
+   *
+   * @param object object file path
+   * @param exe executable file path
+   * @param profile the object is instrumented, link the profile runtime of
+   * LLVM, which only `clang` ships
+   * @return true if linked successfully
+   */
+  static auto Link(const std::string &object, const std::string &exe,
+                   bool profile = false) -> bool;
 };
 
 } // namespace toyc
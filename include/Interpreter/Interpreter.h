@@ -7,6 +7,8 @@
 
 #include <CodeGen/InterpreterCodeGen.h>
 #include <Parser/InterpreterParser.h>
+#include <Sema/DeadCodeEliminator.h>
+#include <Sema/FunctionAttrInference.h>
 
 #include <string>
 
@@ -20,6 +22,10 @@ class Interpreter {
 private:
   InterpreterParser parser_;
   InterpreterIRVisitor visitor_;
+  /// keeps the globals defined so far
+  DeadCodeEliminator eliminator_;
+  /// attributes of all functions defined so far
+  FunctionAttrInference attr_inference_;
 
 private:
   /**
@@ -33,6 +39,14 @@ public:
   Interpreter() = default;
 
 public:
+  /// emit debug info for `src`, for gdb and perf to see the JIT code
+  void EnableDebugInfo(const std::string &src) {
+    visitor_.EnableDebugInfo(src);
+  }
+
+  /// generate code for `cpu`, `native` for the host, before any input
+  void SetTargetCPU(const std::string &cpu) { visitor_.SetTargetCPU(cpu); }
+
   /**
    * @brief Parse `input` and execute using JIT
    *
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/ExecutionEngine/JITSymbol.h>
 #include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
@@ -18,8 +19,10 @@
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/IR/DataLayout.h>
+#include <llvm/MC/SubtargetFeature.h>
 
 #include <memory>
+#include <string>
 
 namespace toyc {
 
@@ -60,7 +63,17 @@ public:
     }
   }
 
-  static auto Create() -> llvm::Expected<std::unique_ptr<ToycJIT>> {
+  /**
+   * @brief Create a JIT for the host
+   *
+   * @param cpu CPU to generate code for, empty for the baseline of the host
+   * triple
+   * @param features target features on top of those of `cpu`, as
+   * `+avx2,-fma,...`
+   */
+  static auto Create(const std::string &cpu = "",
+                     const std::string &features = "")
+      -> llvm::Expected<std::unique_ptr<ToycJIT>> {
     auto epc = llvm::orc::SelfExecutorProcessControl::Create();
     if (!epc) {
       return epc.takeError();
@@ -69,6 +82,10 @@ public:
     auto es = std::make_unique<llvm::orc::ExecutionSession>(std::move(*epc));
     llvm::orc::JITTargetMachineBuilder jtmb(
         es->getExecutorProcessControl().getTargetTriple());
+    jtmb.setCPU(cpu);
+    if (!features.empty()) {
+      jtmb.getFeatures() = llvm::SubtargetFeatures(features);
+    }
 
     llvm::Expected<llvm::DataLayout> dl = jtmb.getDefaultDataLayoutForTarget();
     if (!dl) {
@@ -85,6 +102,18 @@ public:
 
   auto GetMainJITDylib() -> llvm::orc::JITDylib & { return mainlib_; }
 
+  /**
+   * @brief Announce the code of modules added from now on to gdb, and to perf
+   * when LLVM is built with perf support (see `perf inject --jit`)
+   */
+  void RegisterDebuggerListeners() {
+    object_layer_.registerJITEventListener(
+        *llvm::JITEventListener::createGDBRegistrationListener());
+    if (auto *perf = llvm::JITEventListener::createPerfJITEventListener()) {
+      object_layer_.registerJITEventListener(*perf);
+    }
+  }
+
   auto AddModule(llvm::orc::ThreadSafeModule tsm,
                  llvm::orc::ResourceTrackerSP rt = nullptr) -> llvm::Error {
     if (!rt) {
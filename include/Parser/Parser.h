@@ -12,6 +12,7 @@
 #include <cstddef>
 #include <exception>
 #include <initializer_list>
+#include <set>
 #include <tuple>
 #include <vector>
 
@@ -58,6 +59,14 @@ struct FunctionParams {
         params_(_params) {}
 };
 
+/// specifiers in front of a declarator
+struct DeclSpecifiers {
+  std::string type_;
+  bool is_extern_{false};
+  /// `DeclSpec` flags
+  uint32_t specs_{NO_SPEC};
+};
+
 class BaseParser {
 protected:
   Token current_;
@@ -71,11 +80,17 @@ protected:
   std::map<std::string, std::string> global_var_table_;
   /// local variable: <name, type>
   std::map<std::string, std::string> var_table_;
+  /// `const` variables, never written after their initialization
+  std::set<std::string> const_global_vars_;
+  std::set<std::string> const_vars_;
   /// function declaration: <name, pair<retType, [type]...>>
   std::map<std::string, FunctionParams> func_table_;
 
 protected:
-  void ClearVarTable() { var_table_.clear(); }
+  void ClearVarTable() {
+    var_table_.clear();
+    const_vars_.clear();
+  }
 
 public:
   auto Peek() -> Token { return current_; }
@@ -83,6 +98,10 @@ public:
   auto Advance() -> Token;
   auto Consume(TokenTy type, std::string message) -> Token;
 
+protected:
+  /// location of the first character of `token`
+  static auto GetLoc(const Token &token) -> SourceLoc;
+
 protected:
   auto Check(std::initializer_list<TokenTy> types) -> bool;
   auto Check(TokenTy type) -> bool;
@@ -102,20 +121,27 @@ protected:
   auto ParseEqualityExpression() -> ExprPtr;
   auto ParseLogicalAndExpression() -> ExprPtr;
   auto ParseLogicalOrExpression() -> ExprPtr;
+  auto ParseConditionalExpression() -> ExprPtr;
   auto ParseAssignmentExpression() -> ExprPtr;
   auto ParseExpression() -> ExprPtr;
 
 public:
   auto ParseExpressionStatement() -> StmtPtr;
   auto ParseReturnStatement() -> StmtPtr;
+  auto ParseBreakStatement() -> StmtPtr;
   auto ParseIterationStatement() -> StmtPtr;
   auto ParseSelectionStatement() -> StmtPtr;
+  /// `{ ... }` of a `switch`, with `case` and `default` labels among the
+  /// statements
+  auto ParseSwitchBody() -> StmtPtr;
   auto ParseDeclarationStatement() -> StmtPtr;
   auto ParseCompoundStatement() -> StmtPtr;
   auto ParseStatement() -> StmtPtr;
 
 public:
-  auto ParseDeclarationSpecifiers() -> std::pair<std::string, bool>;
+  auto ParseDeclarationSpecifiers() -> DeclSpecifiers;
+  /// throw unless `expr` can be written by `=`, `++` or `--`
+  void CheckAssignable(const Expr &expr);
   auto ParseDeclarator() -> std::string;
   auto ParseFunctionParameters() -> std::vector<std::unique_ptr<ParmVarDecl>>;
   auto GenFuncType(std::string &&retTy,
@@ -135,6 +161,13 @@ public:
 
 public:
   void AddInput(std::string &_input) { lexer_.AddInput(_input); }
+
+  /**
+   * @brief Declare the symbols of a declaration which was not parsed from the
+   * input, e.g. one loaded from a precompiled include
+   */
+  void AddDeclaration(const Decl &decl);
+
   auto GetInput() -> std::string { return lexer_.GetInput(); }
 };
 
@@ -7,6 +7,9 @@
 
 #include <Util.h>
 
+#include <string>
+#include <vector>
+
 namespace toyc {
 
 class PreprocessorException : public std::exception {
@@ -31,7 +34,9 @@ public:
  * @brief Toyc Preprocessor
  *
  * 1. remove comments
- * 2. replace `#include` macros with its contents
+ * 2. replace `#include` macros with its contents, joined into one line so the
+ *    following lines keep their numbers, or only record them if precompiled
+ *    includes are enabled
  */
 class Preprocessor {
 private:
@@ -41,6 +46,11 @@ private:
   size_t line_{};
   size_t col_{};
 
+  /// leave `#include` files to be loaded from precompiled ASTs
+  bool precompiled_{false};
+  /// paths of `#include` files left out, in order of first appearance
+  std::vector<std::string> includes_;
+
 private:
   void ThrowPreprocessorException(std::string message) {
     throw PreprocessorException(line_, col_, std::move(message));
@@ -83,6 +93,18 @@ public:
    */
   void SetInput(std::string _input);
 
+  /**
+   * @brief Remove `#include` macros without inserting file contents, the
+   * included files are listed by `GetIncludes` instead
+   */
+  void SetPrecompiledIncludes(bool _precompiled) {
+    precompiled_ = _precompiled;
+  }
+
+  auto GetIncludes() const -> const std::vector<std::string> & {
+    return includes_;
+  }
+
   /**
    * @brief Preprocessor main method
    *
@@ -0,0 +1,50 @@
+//! AST rewriter
+
+#ifndef AST_REWRITER_H
+#define AST_REWRITER_H
+
+#pragma once
+
+#include <AST/AST.h>
+#include <Sema/Sema.h>
+
+namespace toyc {
+
+/**
+ * @brief Base class of AST-level passes which run between parsing and code
+ * generation
+ *
+ * The tree is walked bottom-up, children are always visited before their
+ * parent. Every node is handed to a `Rewrite` hook through the owning pointer,
+ * so a pass may replace it in place.
+ */
+class ASTRewriter {
+public:
+  ASTRewriter() = default;
+  virtual ~ASTRewriter() = default;
+
+public:
+  void Run(TranslationUnitDecl &unit);
+  void Run(DeclPtr &decl);
+  void Run(StmtPtr &stmt);
+  void Run(ExprPtr &expr);
+
+protected:
+  /**
+   * @brief Called after all children of `expr` have been visited
+   *
+   * @param expr owning pointer of current expression, never null
+   */
+  virtual void Rewrite(ExprPtr &expr) {}
+
+  /**
+   * @brief Called after all children of `stmt` have been visited
+   *
+   * @param stmt owning pointer of current statement, never null
+   */
+  virtual void Rewrite(StmtPtr &stmt) {}
+};
+
+} // namespace toyc
+
+#endif
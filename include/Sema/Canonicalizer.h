@@ -0,0 +1,40 @@
+//! AST canonicalization
+
+#ifndef CANONICALIZER_H
+#define CANONICALIZER_H
+
+#pragma once
+
+#include <AST/AST.h>
+#include <Sema/ASTRewriter.h>
+
+#include <cstddef>
+
+namespace toyc {
+
+/**
+ * @brief Bring the AST into canonical form right after parsing
+ *
+ * 1. remove identity `ImplicitCastExpr`, `Sema::CheckBinaryOperator` wraps
+ *    both operands even if their types already match
+ * 2. collapse nested casts, `(T)(T)x` becomes `(T)x`
+ * 3. flatten `ParenExpr`, grouping is already encoded in the tree shape
+ */
+class Canonicalizer : public ASTRewriter {
+private:
+  /// number of nodes removed from the tree
+  size_t removed_{};
+
+protected:
+  void Rewrite(ExprPtr &expr) override;
+
+public:
+  Canonicalizer() = default;
+
+public:
+  auto GetRemoved() const -> size_t { return removed_; }
+};
+
+} // namespace toyc
+
+#endif
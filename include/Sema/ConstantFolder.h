@@ -0,0 +1,65 @@
+//! constant folding
+
+#ifndef CONSTANT_FOLDER_H
+#define CONSTANT_FOLDER_H
+
+#pragma once
+
+#include <AST/AST.h>
+#include <Sema/ASTRewriter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <variant>
+
+namespace toyc {
+
+/// value of a compile-time constant expression, `i64` or `f64`
+using ConstantValue = std::variant<int64_t, double>;
+
+/**
+ * @brief Fold constant subtrees into literals before code generation
+ *
+ * Folding follows C semantics: an `i64` operation which overflows, divides by
+ * zero or shifts out of range is undefined, so it is left to the runtime
+ * instead of being folded. `f64` operations follow IEEE 754.
+ *
+ * Comparisons and logical operators lower to `i1` values in IR, so they are
+ * evaluated (see `Evaluate`) but never replaced by an `i64` literal.
+ *
+ * A `?:` with a constant condition is replaced by its selected arm.
+ */
+class ConstantFolder : public ASTRewriter {
+private:
+  /// number of nodes replaced by a literal or by the selected arm of `?:`
+  size_t folded_{};
+
+protected:
+  void Rewrite(ExprPtr &expr) override;
+
+public:
+  ConstantFolder() = default;
+
+public:
+  auto GetFolded() const -> size_t { return folded_; }
+
+  /**
+   * @brief Evaluate `expr` at compile time
+   *
+   * Comparisons yield `i64` 0 or 1.
+   *
+   * @return std::nullopt if `expr` is not a constant, or if its value is not
+   * defined at compile time
+   */
+  static auto Evaluate(const Expr &expr) -> std::optional<ConstantValue>;
+
+  /**
+   * @brief Check if `expr` produces a boolean (`i1`) value in IR
+   */
+  static auto IsBooleanValued(const Expr &expr) -> bool;
+};
+
+} // namespace toyc
+
+#endif
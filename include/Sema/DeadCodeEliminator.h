@@ -0,0 +1,65 @@
+//! dead code elimination
+
+#ifndef DEAD_CODE_ELIMINATOR_H
+#define DEAD_CODE_ELIMINATOR_H
+
+#pragma once
+
+#include <AST/AST.h>
+#include <Sema/ASTRewriter.h>
+
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <string>
+
+namespace toyc {
+
+/**
+ * @brief Prune statements which can never run or never matter before code
+ * generation
+ *
+ * 1. statements following a `return` or `break` in the same block, up to
+ *    the next label of a `switch` body
+ * 2. `if` and `while` with a constant condition, `if` is replaced by the taken
+ *    branch, a `while` which never runs is removed
+ * 3. local variables which are never read, together with the assignments to
+ *    them, side effects of their initializers and assigned values are kept
+ *
+ * Run after `ConstantFolder`, so conditions are literals where possible.
+ */
+class DeadCodeEliminator : public ASTRewriter {
+private:
+  /// number of statements removed from the tree
+  size_t removed_{};
+  /// names of global variables seen so far
+  std::set<std::string> globals_;
+  /// locals of the current function which are never read
+  std::set<std::string> dead_locals_;
+
+private:
+  void CollectDeadLocals(FunctionDecl &decl);
+  /// @return true if `stmt` should be dropped from its block, it may also be
+  /// replaced in place
+  auto Prune(StmtPtr &stmt) -> bool;
+
+  static auto IsTerminator(const Stmt &stmt) -> bool;
+  static auto ConstantCondition(const Expr &cond) -> std::optional<bool>;
+
+protected:
+  void Rewrite(StmtPtr &stmt) override;
+
+public:
+  DeadCodeEliminator() = default;
+
+public:
+  using ASTRewriter::Run;
+  void Run(TranslationUnitDecl &unit);
+  void Run(DeclPtr &decl);
+
+  auto GetRemoved() const -> size_t { return removed_; }
+};
+
+} // namespace toyc
+
+#endif
@@ -0,0 +1,85 @@
+//! function attribute inference
+
+#ifndef FUNCTION_ATTR_INFERENCE_H
+#define FUNCTION_ATTR_INFERENCE_H
+
+#pragma once
+
+#include <AST/AST.h>
+#include <Sema/Sema.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace toyc {
+
+/**
+ * @brief Attributes inferred for a toyc function, mapped to the LLVM function
+ * attributes of the same name
+ */
+struct FunctionAttrs {
+  /// does not access global memory
+  bool readnone_{false};
+  /// may read but does not write global memory
+  bool readonly_{false};
+  /// never unwinds, toyc itself has no exceptions
+  bool nounwind_{false};
+  /// never calls itself, directly or indirectly
+  bool norecurse_{false};
+  /// always returns to the caller
+  bool willreturn_{false};
+};
+
+/**
+ * @brief Infer purity, global memory effects and recursion of toyc functions
+ * from the call graph and global variable accesses
+ *
+ * Functions without a body in the translation unit (`extern` functions and
+ * bare declarations) are unknown and assumed to have every effect.
+ */
+class FunctionAttrInference {
+private:
+  /// effects of a function body, callees excluded
+  struct FunctionInfo {
+    std::set<std::string> callees_;
+    bool reads_global_{false};
+    bool writes_global_{false};
+    bool has_loop_{false};
+  };
+
+  /// names of global variables seen so far
+  std::set<std::string> globals_;
+  /// inferred attributes of functions, unknown functions are absent
+  std::map<std::string, FunctionAttrs> attrs_;
+
+private:
+  auto Collect(FunctionDecl &decl) -> FunctionInfo;
+  void InferSCC(const std::vector<std::string> &scc,
+                std::map<std::string, FunctionInfo> &infos);
+
+public:
+  FunctionAttrInference() = default;
+
+public:
+  /**
+   * @brief Analyse all function definitions of a translation unit
+   */
+  void Run(TranslationUnitDecl &unit);
+
+  /**
+   * @brief Analyse one more declaration, for incremental (REPL) input
+   *
+   * Callees must have been analysed before, otherwise they are unknown.
+   */
+  void Run(DeclPtr &decl);
+
+  auto GetAttrs() const -> const std::map<std::string, FunctionAttrs> & {
+    return attrs_;
+  }
+};
+
+} // namespace toyc
+
+#endif
@@ -30,6 +30,9 @@ public:
       -> std::string;
   auto CheckShiftOperator(ExprPtr &lhs, ExprPtr &rhs, TokenTy type)
       -> std::string;
+  /// arms of `?:`, an `i64` arm is cast to `f64` if the other one is `f64`,
+  /// empty if either is not a number
+  auto CheckConditionalOperator(ExprPtr &lhs, ExprPtr &rhs) -> std::string;
 };
 
 } // namespace toyc
@@ -1,10 +1,12 @@
 #!/bin/bash
 
-clang="clang-16"
-
 script_dir="$(cd "$(dirname "$0")" && pwd)"
 TOYCC="${script_dir}/../build/bin/toycc"
+TOYCI="${script_dir}/../build/bin/toyci"
 export toycc=$TOYCC
+export toyci=$TOYCI
+# llvm-profdata of the LLVM release toycc is built with
+LLVM_PROFDATA="${LLVM_PROFDATA:-$(command -v llvm-profdata-16 || command -v llvm-profdata)}"
 
 # create output dir for generated files
 mkdir -p build/output
@@ -38,8 +40,8 @@ for src_file in $(find "test/e2e/" -name '*.toyc'); do
     exit 1
   fi
 
-  # 2. Run clang to generate executable
-  $clang -o "$exe_file" "$ll_file" -ltoyc
+  # 2. Run toycc to generate executable
+  $toycc "$src_file" -o "$exe_file" 2> /dev/null
   # Run the executable
   result=$("./${exe_file}")
   expected_result=$(cat ${exe_expected})
@@ -49,6 +51,55 @@ for src_file in $(find "test/e2e/" -name '*.toyc'); do
     exit 1
   fi
 
+  # 3. Optimized variant: stack slots are promoted and the result is the same,
+  # the IR itself depends on the LLVM release so it is not compared
+  ll_opt_file="build/output/${filename}.O2.ll"
+  exe_opt_file="build/output/${filename}.O2.exe"
+  $toycc -O2 "$src_file" "$ll_opt_file" 2> /dev/null
+  if grep -q "alloca" "$ll_opt_file"; then
+    echo "Test $filename failed: optimized LLVM IR still allocates stack slots"
+    exit 1
+  fi
+  $toycc -O2 "$src_file" -o "$exe_opt_file" 2> /dev/null
+  result=$("./${exe_opt_file}")
+  if [ "$result" != "$expected_result" ]; then
+    echo "Test $filename failed: optimized execution result does not match expected result"
+    exit 1
+  fi
+
+  # 4. Direct SSA variant: no stack slots even without optimization
+  ll_ssa_file="build/output/${filename}.ssa.ll"
+  exe_ssa_file="build/output/${filename}.ssa.exe"
+  $toycc -direct-ssa "$src_file" "$ll_ssa_file" 2> /dev/null
+  if grep -q "alloca" "$ll_ssa_file"; then
+    echo "Test $filename failed: direct SSA LLVM IR still allocates stack slots"
+    exit 1
+  fi
+  $toycc -direct-ssa "$src_file" -o "$exe_ssa_file" 2> /dev/null
+  result=$("./${exe_ssa_file}")
+  if [ "$result" != "$expected_result" ]; then
+    echo "Test $filename failed: direct SSA execution result does not match expected result"
+    exit 1
+  fi
+
+  # 5. Sharded variant: functions lowered on parallel threads, objects merged
+  exe_jobs_file="build/output/${filename}.j2.exe"
+  $toycc -j2 "$src_file" -o "$exe_jobs_file" 2> /dev/null
+  result=$("./${exe_jobs_file}")
+  if [ "$result" != "$expected_result" ]; then
+    echo "Test $filename failed: sharded execution result does not match expected result"
+    exit 1
+  fi
+
+  # 6. Library calls instead of intrinsics for the math functions of libtoyc
+  exe_nobuiltin_file="build/output/${filename}.nobuiltin.exe"
+  $toycc -fno-builtin "$src_file" -o "$exe_nobuiltin_file" 2> /dev/null
+  result=$("./${exe_nobuiltin_file}")
+  if [ "$result" != "$expected_result" ]; then
+    echo "Test $filename failed: -fno-builtin execution result does not match expected result"
+    exit 1
+  fi
+
   end=$(date +%s.%N)
   duration=$(echo "$end-$start" | bc)
   total_time=$(echo "$total_time" + "$duration" | bc)
@@ -56,4 +107,80 @@ for src_file in $(find "test/e2e/" -name '*.toyc'); do
   printf "%d/%d Test #%d: %-30s Passed %.2f sec\n" "$idx" "$sum" "$idx" "$src_file" "$duration"
 done
 
+# Options of the tools, checked once on a single program
+echo "Run option tests"
+src_file="test/e2e/math_builtins.toyc"
+
+# 1. -march/-mcpu: a named CPU sets the CPU and the features it implies,
+# -mcpu wins over -march, and an unknown CPU is rejected by both tools
+if [ "$(uname -m)" = "x86_64" ]; then
+  ll_cpu_file="build/output/march.ll"
+  $toycc -march=x86-64 -mcpu=x86-64-v3 "$src_file" "$ll_cpu_file" 2> /dev/null
+  if ! grep -q '"target-cpu"="x86-64-v3"' "$ll_cpu_file" ||
+    ! grep -q '"target-features"="[^"]*+avx2' "$ll_cpu_file"; then
+    echo "Test march failed: -mcpu=x86-64-v3 does not set target-cpu and target-features"
+    exit 1
+  fi
+fi
+if ! $toycc -march=no-such-cpu "$src_file" build/output/march_invalid.ll 2>&1 |
+  grep -q "unknown target CPU" ||
+  ! $toyci -mcpu=no-such-cpu "$src_file" 2>&1 | grep -q "unknown target CPU"; then
+  echo "Test march failed: an unknown CPU is not rejected"
+  exit 1
+fi
+echo "    march Passed"
+
+# 2. Profile guided optimization: instrument, run, merge, then the rebuilt IR
+# carries the branch weights of the run and the program still works
+pgo_src="examples/branchy.toyc"
+pgo_dir="build/output/pgo"
+rm -rf "$pgo_dir"
+$toycc -O2 -fprofile-generate="$pgo_dir" "$pgo_src" -o build/output/branchy.gen.exe 2> /dev/null
+expected_result=$("./build/output/branchy.gen.exe")
+"$LLVM_PROFDATA" merge -o build/output/branchy.profdata "$pgo_dir"/*.profraw
+$toycc -O2 -fprofile-use=build/output/branchy.profdata "$pgo_src" build/output/branchy.use.ll 2> /dev/null
+if ! grep -q "branch_weights" build/output/branchy.use.ll ||
+  ! grep -q "function_entry_count" build/output/branchy.use.ll; then
+  echo "Test pgo failed: the profile is not applied to the IR"
+  exit 1
+fi
+$toycc -O2 -fprofile-use=build/output/branchy.profdata "$pgo_src" -o build/output/branchy.use.exe 2> /dev/null
+result=$("./build/output/branchy.use.exe")
+if [ -z "$result" ] || [ "$result" != "$expected_result" ]; then
+  echo "Test pgo failed: execution result changes with the profile"
+  exit 1
+fi
+echo "    pgo Passed"
+
+# 3. -ftime-report-json writes valid JSON with a timer for every phase
+json_file="build/output/times.json"
+$toycc -O2 -ftime-report-json="$json_file" "$src_file" build/output/times.ll 2> /dev/null
+if ! python3 -m json.tool "$json_file" > /dev/null; then
+  echo "Test time-report failed: $json_file is not valid JSON"
+  exit 1
+fi
+for phase in preprocess lex-parse sema codegen verify opt emit; do
+  if ! grep -q "\"time\.toycc\.${phase}\.wall\"" "$json_file"; then
+    echo "Test time-report failed: no time for phase $phase"
+    exit 1
+  fi
+done
+echo "    time-report Passed"
+
+# 4. Compile cache: the second compile of the same source is a hit and gives
+# a byte-identical object
+cache_dir="build/output/cache"
+rm -rf "$cache_dir"
+$toycc -O2 -c -cache-dir="$cache_dir" "$src_file" -o build/output/cache.miss.o 2> /dev/null
+stats=$($toycc -O2 -c -cache-dir="$cache_dir" -cache-stats "$src_file" -o build/output/cache.hit.o 2>&1)
+if ! echo "$stats" | grep -q "1 hits, 1 misses"; then
+  echo "Test cache failed: the second compile is not a hit ($stats)"
+  exit 1
+fi
+if ! cmp -s build/output/cache.miss.o build/output/cache.hit.o; then
+  echo "Test cache failed: the cached object differs from the compiled one"
+  exit 1
+fi
+echo "    cache Passed"
+
 printf "\n\033[0;32m100%% tests passed\033[0m\n\nTotal Test time (real) = %.2f sec" "$total_time"
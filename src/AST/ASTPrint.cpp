@@ -4,273 +4,622 @@
 #include <AST/ASTPrint.h>
 #include <Util.h>
 
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/raw_os_ostream.h>
+
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
+#include <string>
 
 namespace toyc {
 
-void PrintASTLeader(std::ostream &os, size_t _d, Side _s,
-                    const std::string &_p) {
-  std::string leader;
-  if (_d == 0) {
-    leader = "`";
-  } else {
-    if (_s == LEAF) {
-      leader = _p + "`";
-    } else {
-      leader = _p;
-    }
+namespace {
+
+constexpr char BINARY_MAGIC[] = "TOYCDUMP";
+constexpr uint64_t BINARY_VERSION = 5;
+
+/// indent of the leader of children, one column more below a leaf
+auto Indent(Side side) -> llvm::StringRef { return side == LEAF ? "  " : " "; }
+
+auto DeclName(const Decl &decl) -> const std::string & {
+  if (const auto *func = llvm::dyn_cast<FunctionDecl>(&decl)) {
+    return func->proto_->name_;
   }
-  os << AST_LEADER("{}-", leader);
+  return llvm::cast<VarDecl>(decl).name_;
 }
 
-auto AttachLeafLeader(Side _s, const std::string &_p) -> std::string {
-  std::string leader = _p + " ";
-  if (_s == LEAF) {
-    leader += " ";
+auto DeclType(const Decl &decl) -> const std::string & {
+  if (const auto *func = llvm::dyn_cast<FunctionDecl>(&decl)) {
+    return func->proto_->type_;
   }
-  return leader;
+  return llvm::cast<VarDecl>(decl).type_;
 }
 
+/// `Expr::GetType` without the copy
+auto ExprType(const Expr &expr) -> const std::string & {
+  switch (expr.GetNodeKind()) {
+  case INTEGER_LITERAL:
+    return llvm::cast<IntegerLiteral>(expr).type_;
+  case FLOATING_LITERAL:
+    return llvm::cast<FloatingLiteral>(expr).type_;
+  case STRING_LITERAL:
+    return llvm::cast<StringLiteral>(expr).type_;
+  case DECL_REF_EXPR:
+    return DeclType(*llvm::cast<DeclRefExpr>(expr).decl_);
+  case IMPLICIT_CAST_EXPR:
+    return llvm::cast<ImplicitCastExpr>(expr).type_;
+  case PAREN_EXPR:
+    return ExprType(*llvm::cast<ParenExpr>(expr).expr_);
+  case CALL_EXPR:
+    return ExprType(*llvm::cast<CallExpr>(expr).callee_);
+  case UNARY_OPERATOR:
+    return llvm::cast<UnaryOperator>(expr).type_;
+  case CONDITIONAL_OPERATOR:
+    return llvm::cast<ConditionalOperator>(expr).type_;
+  default:
+    return llvm::cast<BinaryOperator>(expr).type_;
+  }
+}
+
+} // namespace
+
 /**
- * Expr
+ * Output primitives
  */
 
-void IntegerLiteral::Dump(std::ostream &os, size_t _d, Side _s,
-                          const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}\n", AST_STMT("IntegerLiteral"),
-                   AST_TYPE("'{}'", type_), AST_LITERAL("{}", value_));
+void ASTDumper::Header(size_t roots) {
+  if (format_ == BINARY_DUMP) {
+    os_.write(BINARY_MAGIC, sizeof(BINARY_MAGIC) - 1);
+    llvm::encodeULEB128(BINARY_VERSION, os_);
+    llvm::encodeULEB128(roots, os_);
+  }
 }
 
-void FloatingLiteral::Dump(std::ostream &os, size_t _d, Side _s,
-                           const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}\n", AST_STMT("FloatingLiteral"),
-                   AST_TYPE("'{}'", type_), AST_LITERAL("{}", value_));
+void ASTDumper::Colored(llvm::StringRef text, const char *color) {
+  if (color_ && color != nullptr) {
+    os_ << color << text << _RST;
+  } else {
+    os_ << text;
+  }
 }
 
-void StringLiteral::Dump(std::ostream &os, size_t _d, Side _s,
-                         const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}\n", AST_STMT("StringLiteral"),
-                   AST_TYPE("'{}'", type_), AST_LITERAL("\"{}\"", value_));
+void ASTDumper::Escaped(llvm::StringRef text) {
+  size_t start = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    auto c = static_cast<unsigned char>(text[i]);
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    os_ << text.slice(start, i);
+    if (c == '"' || c == '\\') {
+      os_ << '\\' << static_cast<char>(c);
+    } else {
+      os_ << "\\u00" << llvm::hexdigit(c >> 4) << llvm::hexdigit(c & 0xf);
+    }
+    start = i + 1;
+  }
+  os_ << text.substr(start);
 }
 
-void DeclRefExpr::Dump(std::ostream &os, size_t _d, Side _s,
-                       const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  std::string decl_type = "(null)";
-  if (dynamic_cast<VarDecl *>(decl_.get()) != nullptr) {
-    decl_type = "Var";
-  } else if (dynamic_cast<FunctionDecl *>(decl_.get()) != nullptr) {
-    decl_type = "Function";
-  }
-  os << makeString("{} {} {} {}\n", AST_STMT("DeclRefExpr"),
-                   AST_TYPE("'{}'", decl_->GetType()),
-                   AST_DECL("{}", decl_type),
-                   AST_LITERAL("'{}'", decl_->GetName()));
+void ASTDumper::Open(NodeKind kind, llvm::StringRef name, const char *color,
+                     Side side) {
+  switch (format_) {
+  case TEXT_DUMP:
+    if (color_) {
+      os_ << AST_LEADER_COLOR;
+    }
+    if (depth_ == 0) {
+      os_ << '`';
+    } else {
+      os_ << prefix_;
+      if (side == LEAF) {
+        os_ << '`';
+      }
+    }
+    os_ << '-';
+    if (color_) {
+      os_ << _RST;
+    }
+    Colored(name, color);
+    break;
+  case JSON_DUMP:
+    os_ << "{\"kind\":\"" << name << '"';
+    break;
+  case BINARY_DUMP:
+    llvm::encodeULEB128(kind, os_);
+    break;
+  }
 }
 
-void ImplicitCastExpr::Dump(std::ostream &os, size_t _d, Side _s,
-                            const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {}\n", AST_STMT("ImplicitCastExpr"),
-                   AST_TYPE("'{}'", type_));
-  std::string leader = AttachLeafLeader(_s, _p);
-  expr_->Dump(os, _d + 1, LEAF, leader);
+void ASTDumper::Field(llvm::StringRef key, llvm::StringRef value,
+                      const char *color, char quote) {
+  switch (format_) {
+  case TEXT_DUMP:
+    os_ << ' ';
+    if (color_ && color != nullptr) {
+      os_ << color;
+    }
+    if (quote != 0) {
+      os_ << quote << value << quote;
+    } else {
+      os_ << value;
+    }
+    if (color_ && color != nullptr) {
+      os_ << _RST;
+    }
+    break;
+  case JSON_DUMP:
+    os_ << ",\"" << key << "\":\"";
+    Escaped(value);
+    os_ << '"';
+    break;
+  case BINARY_DUMP:
+    llvm::encodeULEB128(value.size(), os_);
+    os_ << value;
+    break;
+  }
 }
 
-void ParenExpr::Dump(std::ostream &os, size_t _d, Side _s,
-                     const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {}\n", AST_STMT("ParenExpr"),
-                   AST_TYPE("'{}'", GetType()));
-  std::string leader = AttachLeafLeader(_s, _p);
-  expr_->Dump(os, _d + 1, LEAF, leader);
+void ASTDumper::Field(llvm::StringRef key, int64_t value, const char *color) {
+  switch (format_) {
+  case TEXT_DUMP:
+    os_ << ' ';
+    if (color_) {
+      os_ << color << value << _RST;
+    } else {
+      os_ << value;
+    }
+    break;
+  case JSON_DUMP:
+    os_ << ",\"" << key << "\":" << value;
+    break;
+  case BINARY_DUMP:
+    llvm::encodeSLEB128(value, os_);
+    break;
+  }
 }
 
-void CallExpr::Dump(std::ostream &os, size_t _d, Side _s,
-                    const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {}\n", AST_STMT("CallExpr"),
-                   AST_TYPE("'{}'", GetType()));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (!args_.empty()) {
-    callee_->Dump(os, _d + 1, INTERNAL, leader + "|");
+void ASTDumper::Field(llvm::StringRef key, double value, const char *color) {
+  if (format_ == BINARY_DUMP) {
+    llvm::support::endian::write<uint64_t>(
+        os_, llvm::bit_cast<uint64_t>(value), llvm::support::little);
+    return;
+  }
+  /// the shortest representation, as `fmt` prints it
+  char buffer[32];
+  auto result = fmt::format_to_n(buffer, sizeof(buffer), "{}", value);
+  llvm::StringRef text(buffer, std::min(result.size, sizeof(buffer)));
+  if (format_ == TEXT_DUMP) {
+    os_ << ' ';
+    Colored(text, color);
   } else {
-    callee_->Dump(os, _d + 1, LEAF, leader);
+    /// JSON has no infinity or NaN
+    os_ << ",\"" << key << "\":" << (std::isfinite(value) ? text : "null");
   }
-  if (!args_.empty()) {
-    for (size_t i = 0; i < args_.size() - 1; i++) {
-      args_[i]->Dump(os, _d + 1, INTERNAL, leader + "|");
+}
+
+void ASTDumper::Flag(llvm::StringRef key, bool value) {
+  switch (format_) {
+  case TEXT_DUMP:
+    if (value) {
+      os_ << ' ' << key;
+    }
+    break;
+  case JSON_DUMP:
+    if (value) {
+      os_ << ",\"" << key << "\":true";
     }
-    args_[args_.size() - 1]->Dump(os, _d + 1, LEAF, leader);
+    break;
+  case BINARY_DUMP:
+    os_ << static_cast<char>(value);
+    break;
   }
 }
 
-void UnaryOperator::Dump(std::ostream &os, size_t _d, Side _s,
-                         const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {} '{}'\n", AST_STMT("UnaryOperator"),
-                   AST_TYPE("'{}'", type_),
-                   side_ == PREFIX ? "prefix" : "postfix", op_.value_);
-  std::string leader = AttachLeafLeader(_s, _p);
-  expr_->Dump(os, _d + 1, LEAF, leader);
+auto ASTDumper::Children(size_t count, llvm::StringRef indent) -> size_t {
+  switch (format_) {
+  case TEXT_DUMP: {
+    os_ << '\n';
+    size_t mark = prefix_.size();
+    prefix_ += indent;
+    return mark;
+  }
+  case JSON_DUMP:
+    if (count != 0) {
+      os_ << ",\"inner\":[";
+    }
+    break;
+  case BINARY_DUMP:
+    llvm::encodeULEB128(count, os_);
+    break;
+  }
+  return 0;
 }
 
-void BinaryOperator::Dump(std::ostream &os, size_t _d, Side _s,
-                          const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} '{}'\n", AST_STMT("BinaryOperator"),
-                   AST_TYPE("'{}'", type_), op_.value_);
-  left_->Dump(os, _d + 1, INTERNAL, _p + "  |");
-  right_->Dump(os, _d + 1, LEAF, _p + "  ");
+void ASTDumper::Close(size_t count, size_t mark) {
+  if (format_ == TEXT_DUMP) {
+    prefix_.resize(mark);
+  } else if (format_ == JSON_DUMP) {
+    os_ << (count != 0 ? "]}" : "}");
+  }
+}
+
+void ASTDumper::CloseLeaf() { Close(0, Children(0, "")); }
+
+template <typename T>
+void ASTDumper::Child(const T &node, size_t index, size_t count) {
+  Side side = index + 1 < count ? INTERNAL : LEAF;
+  if (side == INTERNAL) {
+    prefix_.push_back('|');
+  }
+  depth_++;
+  Visit(node, side);
+  depth_--;
+  if (side == INTERNAL) {
+    prefix_.pop_back();
+    if (format_ == JSON_DUMP) {
+      os_ << ',';
+    }
+  }
 }
 
 /**
- * Stmt
+ * Expr
  */
 
-void CompoundStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                        const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("CompoundStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (stmts_.size() == 1) {
-    stmts_[0]->Dump(os, _d + 1, LEAF, leader);
-  } else if (stmts_.size() >= 2) {
-    for (int i = 0; i < stmts_.size() - 1; i++) {
-      stmts_[i]->Dump(os, _d + 1, INTERNAL, leader + "|");
+void ASTDumper::Visit(const Expr &expr, Side side) {
+  switch (expr.GetNodeKind()) {
+  case INTEGER_LITERAL: {
+    const auto &e = llvm::cast<IntegerLiteral>(expr);
+    Open(INTEGER_LITERAL, "IntegerLiteral", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    Field("value", e.value_, AST_LITERAL_COLOR);
+    CloseLeaf();
+    break;
+  }
+  case FLOATING_LITERAL: {
+    const auto &e = llvm::cast<FloatingLiteral>(expr);
+    Open(FLOATING_LITERAL, "FloatingLiteral", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    Field("value", e.value_, AST_LITERAL_COLOR);
+    CloseLeaf();
+    break;
+  }
+  case STRING_LITERAL: {
+    const auto &e = llvm::cast<StringLiteral>(expr);
+    Open(STRING_LITERAL, "StringLiteral", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    Field("value", e.value_, AST_LITERAL_COLOR, '"');
+    CloseLeaf();
+    break;
+  }
+  case DECL_REF_EXPR: {
+    const auto &decl = *llvm::cast<DeclRefExpr>(expr).decl_;
+    Open(DECL_REF_EXPR, "DeclRefExpr", AST_STMT_COLOR, side);
+    Field("type", DeclType(decl), AST_TYPE_COLOR, '\'');
+    Field("declKind", llvm::isa<VarDecl>(decl) ? "Var" : "Function",
+          AST_DECL_COLOR, 0);
+    Field("name", DeclName(decl), AST_LITERAL_COLOR, '\'');
+    CloseLeaf();
+    break;
+  }
+  case IMPLICIT_CAST_EXPR: {
+    const auto &e = llvm::cast<ImplicitCastExpr>(expr);
+    Open(IMPLICIT_CAST_EXPR, "ImplicitCastExpr", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    size_t mark = Children(1, Indent(side));
+    Child(*e.expr_, 0, 1);
+    Close(1, mark);
+    break;
+  }
+  case PAREN_EXPR: {
+    const auto &e = llvm::cast<ParenExpr>(expr);
+    Open(PAREN_EXPR, "ParenExpr", AST_STMT_COLOR, side);
+    Field("type", ExprType(e), AST_TYPE_COLOR, '\'');
+    size_t mark = Children(1, Indent(side));
+    Child(*e.expr_, 0, 1);
+    Close(1, mark);
+    break;
+  }
+  case CALL_EXPR: {
+    const auto &e = llvm::cast<CallExpr>(expr);
+    Open(CALL_EXPR, "CallExpr", AST_STMT_COLOR, side);
+    Field("type", ExprType(e), AST_TYPE_COLOR, '\'');
+    size_t count = e.args_.size() + 1;
+    size_t mark = Children(count, Indent(side));
+    Child(*e.callee_, 0, count);
+    for (size_t i = 0; i < e.args_.size(); i++) {
+      Child(*e.args_[i], i + 1, count);
     }
-    stmts_[stmts_.size() - 1]->Dump(os, _d + 1, LEAF, leader);
+    Close(count, mark);
+    break;
+  }
+  case UNARY_OPERATOR: {
+    const auto &e = llvm::cast<UnaryOperator>(expr);
+    Open(UNARY_OPERATOR, "UnaryOperator", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    Field("side", e.side_ == PREFIX ? "prefix" : "postfix", nullptr, 0);
+    Field("opcode", e.op_.value_, nullptr, '\'');
+    size_t mark = Children(1, Indent(side));
+    Child(*e.expr_, 0, 1);
+    Close(1, mark);
+    break;
+  }
+  case BINARY_OPERATOR: {
+    const auto &e = llvm::cast<BinaryOperator>(expr);
+    Open(BINARY_OPERATOR, "BinaryOperator", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    Field("opcode", e.op_.value_, nullptr, '\'');
+    /// operands are indented as below a leaf either way
+    size_t mark = Children(2, Indent(LEAF));
+    Child(*e.left_, 0, 2);
+    Child(*e.right_, 1, 2);
+    Close(2, mark);
+    break;
+  }
+  case CONDITIONAL_OPERATOR: {
+    const auto &e = llvm::cast<ConditionalOperator>(expr);
+    Open(CONDITIONAL_OPERATOR, "ConditionalOperator", AST_STMT_COLOR, side);
+    Field("type", e.type_, AST_TYPE_COLOR, '\'');
+    size_t mark = Children(3, Indent(LEAF));
+    Child(*e.cond_, 0, 3);
+    Child(*e.true_expr_, 1, 3);
+    Child(*e.false_expr_, 2, 3);
+    Close(3, mark);
+    break;
+  }
+  default:
+    break;
   }
 }
 
-void ExprStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                    const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("ExprStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (expr_ != nullptr) {
-    expr_->Dump(os, _d + 1, LEAF, leader);
+/**
+ * Stmt
+ */
+
+void ASTDumper::Visit(const Stmt &stmt, Side side) {
+  switch (stmt.GetNodeKind()) {
+  case COMPOUND_STMT: {
+    const auto &s = llvm::cast<CompoundStmt>(stmt);
+    Open(COMPOUND_STMT, "CompoundStmt", AST_STMT_COLOR, side);
+    size_t count = s.stmts_.size();
+    size_t mark = Children(count, Indent(side));
+    for (size_t i = 0; i < count; i++) {
+      Child(*s.stmts_[i], i, count);
+    }
+    Close(count, mark);
+    break;
+  }
+  case EXPR_STMT: {
+    const auto &s = llvm::cast<ExprStmt>(stmt);
+    Open(EXPR_STMT, "ExprStmt", AST_STMT_COLOR, side);
+    size_t count = s.expr_ != nullptr ? 1 : 0;
+    size_t mark = Children(count, Indent(side));
+    if (s.expr_ != nullptr) {
+      Child(*s.expr_, 0, 1);
+    }
+    Close(count, mark);
+    break;
+  }
+  case DECL_STMT: {
+    const auto &s = llvm::cast<DeclStmt>(stmt);
+    Open(DECL_STMT, "DeclStmt", AST_STMT_COLOR, side);
+    size_t count = s.decl_ != nullptr ? 1 : 0;
+    size_t mark = Children(count, Indent(side));
+    if (s.decl_ != nullptr) {
+      Child(*s.decl_, 0, 1);
+    }
+    Close(count, mark);
+    break;
+  }
+  case IF_STMT: {
+    const auto &s = llvm::cast<IfStmt>(stmt);
+    Open(IF_STMT, "IfStmt", AST_STMT_COLOR, side);
+    size_t count = s.else_stmt_ != nullptr ? 3 : 2;
+    size_t mark = Children(count, Indent(side));
+    Child(*s.cond_, 0, count);
+    Child(*s.then_stmt_, 1, count);
+    if (s.else_stmt_ != nullptr) {
+      Child(*s.else_stmt_, 2, count);
+    }
+    Close(count, mark);
+    break;
+  }
+  case WHILE_STMT: {
+    const auto &s = llvm::cast<WhileStmt>(stmt);
+    Open(WHILE_STMT, "WhileStmt", AST_STMT_COLOR, side);
+    size_t count = s.stmt_ != nullptr ? 2 : 1;
+    size_t mark = Children(count, Indent(side));
+    Child(*s.cond_, 0, count);
+    if (s.stmt_ != nullptr) {
+      Child(*s.stmt_, 1, count);
+    }
+    Close(count, mark);
+    break;
+  }
+  case FOR_STMT: {
+    const auto &s = llvm::cast<ForStmt>(stmt);
+    Open(FOR_STMT, "ForStmt", AST_STMT_COLOR, side);
+    size_t mark = Children(4, Indent(side));
+    Child(*s.init_, 0, 4);
+    Child(*s.cond_, 1, 4);
+    Child(*s.update_, 2, 4);
+    Child(*s.body_, 3, 4);
+    Close(4, mark);
+    break;
+  }
+  case RETURN_STMT: {
+    const auto &s = llvm::cast<ReturnStmt>(stmt);
+    Open(RETURN_STMT, "ReturnStmt", AST_STMT_COLOR, side);
+    size_t count = s.expr_ != nullptr ? 1 : 0;
+    size_t mark = Children(count, Indent(side));
+    if (s.expr_ != nullptr) {
+      Child(*s.expr_, 0, 1);
+    }
+    Close(count, mark);
+    break;
+  }
+  case SWITCH_STMT: {
+    const auto &s = llvm::cast<SwitchStmt>(stmt);
+    Open(SWITCH_STMT, "SwitchStmt", AST_STMT_COLOR, side);
+    size_t mark = Children(2, Indent(side));
+    Child(*s.cond_, 0, 2);
+    Child(*s.body_, 1, 2);
+    Close(2, mark);
+    break;
+  }
+  case CASE_STMT: {
+    const auto &s = llvm::cast<CaseStmt>(stmt);
+    Open(CASE_STMT, "CaseStmt", AST_STMT_COLOR, side);
+    size_t mark = Children(1, Indent(side));
+    Child(*s.value_, 0, 1);
+    Close(1, mark);
+    break;
+  }
+  case DEFAULT_STMT:
+    Open(DEFAULT_STMT, "DefaultStmt", AST_STMT_COLOR, side);
+    CloseLeaf();
+    break;
+  case BREAK_STMT:
+    Open(BREAK_STMT, "BreakStmt", AST_STMT_COLOR, side);
+    CloseLeaf();
+    break;
+  default:
+    break;
   }
 }
 
-void DeclStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                    const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("DeclStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (decl_ != nullptr) {
-    decl_->Dump(os, _d + 1, LEAF, leader);
+/**
+ * Decl
+ */
+
+void ASTDumper::Visit(const Decl &decl, Side side) {
+  switch (decl.GetNodeKind()) {
+  case VAR_DECL: {
+    const auto &d = llvm::cast<VarDecl>(decl);
+    Open(VAR_DECL, "VarDecl", AST_DECL_COLOR, side);
+    Field("name", d.name_, AST_LITERAL_COLOR, 0);
+    Field("type", d.type_, AST_TYPE_COLOR, '\'');
+    Flag("static", d.IsStatic());
+    Flag("const", d.IsConst());
+    size_t count = d.init_ != nullptr ? 1 : 0;
+    size_t mark = Children(count, Indent(side));
+    if (d.init_ != nullptr) {
+      Child(*d.init_, 0, 1);
+    }
+    Close(count, mark);
+    break;
+  }
+  case PARM_VAR_DECL: {
+    const auto &d = llvm::cast<ParmVarDecl>(decl);
+    Open(PARM_VAR_DECL, "ParmVarDecl", AST_DECL_COLOR, side);
+    Field("name", d.name_, AST_LITERAL_COLOR, 0);
+    Field("type", d.type_, AST_TYPE_COLOR, '\'');
+    CloseLeaf();
+    break;
+  }
+  case FUNCTION_DECL: {
+    const auto &d = llvm::cast<FunctionDecl>(decl);
+    const auto &params = d.proto_->params_;
+    Open(FUNCTION_DECL, "FunctionDecl", AST_DECL_COLOR, side);
+    Field("name", d.proto_->name_, AST_LITERAL_COLOR, 0);
+    Field("type", d.proto_->type_, AST_TYPE_COLOR, '\'');
+    Flag("extern", d.kind_ == EXTERN_FUNC);
+    Flag("static", d.IsStatic());
+    Flag("inline", d.IsInline());
+    size_t count = params.size() + (d.body_ != nullptr ? 1 : 0);
+    size_t mark = Children(count, Indent(side));
+    for (size_t i = 0; i < params.size(); i++) {
+      Child(*params[i], i, count);
+    }
+    if (d.body_ != nullptr) {
+      Child(*d.body_, count - 1, count);
+    }
+    Close(count, mark);
+    break;
+  }
+  default:
+    break;
   }
 }
 
-void IfStmt::Dump(std::ostream &os, size_t _d, Side _s, const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("IfStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  cond_->Dump(os, _d + 1, INTERNAL, leader + "|");
-  if (else_stmt_ != nullptr) {
-    then_stmt_->Dump(os, _d + 1, INTERNAL, leader + "|");
+/**
+ * Entries
+ */
+
+void ASTDumper::Dump(const TranslationUnitDecl &unit) {
+  size_t count = unit.decls_.size();
+  if (format_ == BINARY_DUMP) {
+    /// the unit itself carries nothing but its declarations
+    Header(count);
+    for (const auto &decl : unit.decls_) {
+      Visit(*decl, LEAF);
+    }
+    return;
+  }
+  if (format_ == TEXT_DUMP) {
+    Colored("TranslationUnitDecl", AST_DECL_COLOR);
   } else {
-    then_stmt_->Dump(os, _d + 1, LEAF, leader);
+    os_ << "{\"kind\":\"TranslationUnitDecl\"";
   }
-  if (else_stmt_ != nullptr) {
-    else_stmt_->Dump(os, _d + 1, LEAF, leader);
+  size_t mark = Children(count, "");
+  for (size_t i = 0; i < count; i++) {
+    Child(*unit.decls_[i], i, count);
   }
-}
-
-void WhileStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                     const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("WhileStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  cond_->Dump(os, _d + 1, INTERNAL, leader + "|");
-  if (stmt_ != nullptr) {
-    stmt_->Dump(os, _d + 1, LEAF, leader);
+  Close(count, mark);
+  if (format_ == JSON_DUMP) {
+    os_ << '\n';
   }
 }
 
-void ForStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                   const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("ForStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  init_->Dump(os, _d + 1, INTERNAL, leader + "|");
-  cond_->Dump(os, _d + 1, INTERNAL, leader + "|");
-  update_->Dump(os, _d + 1, INTERNAL, leader + "|");
-  body_->Dump(os, _d + 1, LEAF, leader);
+void ASTDumper::Dump(const Expr &expr) {
+  Header(1);
+  Visit(expr, LEAF);
+  if (format_ == JSON_DUMP) {
+    os_ << '\n';
+  }
 }
 
-void ReturnStmt::Dump(std::ostream &os, size_t _d, Side _s,
-                      const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{}\n", AST_STMT("ReturnStmt"));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (expr_ != nullptr) {
-    expr_->Dump(os, _d + 1, LEAF, leader);
+void ASTDumper::Dump(const Stmt &stmt) {
+  Header(1);
+  Visit(stmt, LEAF);
+  if (format_ == JSON_DUMP) {
+    os_ << '\n';
   }
 }
 
-/**
- * Decl
- */
-
-void VarDecl::Dump(std::ostream &os, size_t _d, Side _s,
-                   const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}\n", AST_DECL("VarDecl"), AST_LITERAL("{}", name_),
-                   AST_TYPE("'{}'", GetType()));
-  std::string leader = AttachLeafLeader(_s, _p);
-  if (init_ != nullptr) {
-    init_->Dump(os, _d + 1, LEAF, leader);
+void ASTDumper::Dump(const Decl &decl) {
+  Header(1);
+  Visit(decl, LEAF);
+  if (format_ == JSON_DUMP) {
+    os_ << '\n';
   }
 }
 
-void ParmVarDecl::Dump(std::ostream &os, size_t _d, Side _s,
-                       const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}\n", AST_DECL("ParmVarDecl"),
-                   AST_LITERAL("{}", name_), AST_TYPE("'{}'", GetType()));
+void Expr::Dump(std::ostream &os) const {
+  llvm::raw_os_ostream ros(os);
+  ASTDumper(ros, TEXT_DUMP, true).Dump(*this);
 }
 
-void FunctionDecl::Dump(std::ostream &os, size_t _d, Side _s,
-                        const std::string &_p) {
-  PrintASTLeader(os, _d, _s, _p);
-  os << makeString("{} {} {}{}\n", AST_DECL("FunctionDecl"),
-                   AST_LITERAL("{}", proto_->name_),
-                   AST_TYPE("'{}'", proto_->type_),
-                   kind_ == EXTERN_FUNC ? " extern" : "");
-  std::string leader = AttachLeafLeader(_s, _p);
-  for (size_t i = 0; i < proto_->params_.size(); i++) {
-    if (i == proto_->params_.size() - 1 && body_ == nullptr) {
-      proto_->params_[i]->Dump(os, _d + 1, LEAF, leader);
-    } else {
-      proto_->params_[i]->Dump(os, _d + 1, INTERNAL, leader + "|");
-    }
-  }
-  if (body_ != nullptr) {
-    body_->Dump(os, _d + 1, LEAF, leader);
-  }
+void Stmt::Dump(std::ostream &os) const {
+  llvm::raw_os_ostream ros(os);
+  ASTDumper(ros, TEXT_DUMP, true).Dump(*this);
 }
 
-/**
- * TranslationUnitDecl
- */
+void Decl::Dump(std::ostream &os) const {
+  llvm::raw_os_ostream ros(os);
+  ASTDumper(ros, TEXT_DUMP, true).Dump(*this);
+}
 
-void TranslationUnitDecl::Dump(std::ostream &os, size_t _d, Side _s,
-                               const std::string &_p) {
-  os << AST_DECL("TranslationUnitDecl") << "\n";
-  if (decls_.size() == 1) {
-    decls_[0]->Dump(os, _d + 1, LEAF, _p);
-  } else if (decls_.size() >= 2) {
-    for (int i = 0; i < decls_.size() - 1; i++) {
-      decls_[i]->Dump(os, _d + 1, INTERNAL, _p + "|");
-    }
-    decls_[decls_.size() - 1]->Dump(os, _d + 1, LEAF, _p);
-  }
+void TranslationUnitDecl::Dump(std::ostream &os) const {
+  llvm::raw_os_ostream ros(os);
+  ASTDumper(ros, TEXT_DUMP, true).Dump(*this);
 }
 
 } // namespace toyc
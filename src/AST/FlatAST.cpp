@@ -0,0 +1,623 @@
+//! flat index-based AST implementation
+
+#include <AST/FlatAST.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Casting.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace toyc {
+
+namespace {
+
+constexpr char MAGIC[8] = {'T', 'O', 'Y', 'C', 'A', 'S', 'T', '\0'};
+/// reads back as another value on a machine of another byte order
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+/// node tables, then lists, string entries, string data and top-level
+/// declarations
+constexpr size_t SECTION_COUNT = std::tuple_size_v<NodeTables<NodeVector>> + 4;
+constexpr uint64_t SECTION_ALIGN = 8;
+
+/// location of a table in the file
+struct Section {
+  uint64_t offset_;
+  uint64_t count_;
+  uint64_t elem_size_;
+};
+
+struct FileHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+  Section sections_[SECTION_COUNT];
+};
+
+} // namespace
+
+/**
+ * @brief Encode a pointer tree into a `FlatAST`, interning strings and
+ * sharing referenced declarations on the way
+ */
+class Flattener {
+private:
+  FlatAST &ast_;
+  std::unordered_map<std::string, StringId> string_ids_;
+  /// declarations referenced by `DeclRefExpr`, keyed by their contents
+  std::unordered_map<std::string, NodeId> refs_;
+
+public:
+  explicit Flattener(FlatAST &_ast) : ast_(_ast) {}
+
+  auto Intern(const std::string &str) -> StringId {
+    auto [it, inserted] = string_ids_.try_emplace(str, ast_.strings_.size());
+    if (inserted) {
+      ast_.strings_.push_back(
+          {static_cast<uint32_t>(ast_.string_data_.size()),
+           static_cast<uint32_t>(str.size())});
+      ast_.string_data_.insert(ast_.string_data_.end(), str.begin(),
+                               str.end());
+    }
+    return it->second;
+  }
+
+  auto AddList(const std::vector<NodeId> &ids) -> NodeList {
+    NodeList list{static_cast<uint32_t>(ast_.lists_.size()),
+                  static_cast<uint32_t>(ids.size())};
+    ast_.lists_.insert(ast_.lists_.end(), ids.begin(), ids.end());
+    return list;
+  }
+
+  auto Flatten(const Expr *expr) -> NodeId;
+  auto Flatten(const Stmt *stmt) -> NodeId;
+  auto Flatten(const Decl *decl) -> NodeId;
+  auto FlattenRef(const Decl &decl) -> NodeId;
+};
+
+template <typename T> auto FlatAST::Add(const T &node) -> NodeId {
+  auto &nodes = std::get<std::vector<T>>(nodes_);
+  if (nodes.size() > NodeId::MAX_INDEX) {
+    llvm::report_fatal_error("too many AST nodes of one kind for FlatAST");
+  }
+  nodes.push_back(node);
+  return {T::KIND, static_cast<uint32_t>(nodes.size() - 1)};
+}
+
+auto Flattener::Flatten(const Expr *expr) -> NodeId {
+  if (expr == nullptr) {
+    return {};
+  }
+  switch (expr->GetNodeKind()) {
+  case INTEGER_LITERAL: {
+    const auto &e = llvm::cast<IntegerLiteral>(*expr);
+    return ast_.Add(FlatIntegerLiteral{e.value_, Intern(e.type_), e.loc_});
+  }
+  case FLOATING_LITERAL: {
+    const auto &e = llvm::cast<FloatingLiteral>(*expr);
+    return ast_.Add(FlatFloatingLiteral{e.value_, Intern(e.type_), e.loc_});
+  }
+  case STRING_LITERAL: {
+    const auto &e = llvm::cast<StringLiteral>(*expr);
+    return ast_.Add(
+        FlatStringLiteral{Intern(e.value_), Intern(e.type_), e.loc_});
+  }
+  case DECL_REF_EXPR: {
+    const auto &e = llvm::cast<DeclRefExpr>(*expr);
+    return ast_.Add(FlatDeclRefExpr{FlattenRef(*e.decl_), e.loc_});
+  }
+  case IMPLICIT_CAST_EXPR: {
+    const auto &e = llvm::cast<ImplicitCastExpr>(*expr);
+    NodeId child = Flatten(e.expr_.get());
+    return ast_.Add(FlatImplicitCastExpr{Intern(e.type_), child, e.loc_});
+  }
+  case PAREN_EXPR: {
+    NodeId child = Flatten(llvm::cast<ParenExpr>(*expr).expr_.get());
+    return ast_.Add(FlatParenExpr{child, expr->loc_});
+  }
+  case CALL_EXPR: {
+    const auto &e = llvm::cast<CallExpr>(*expr);
+    NodeId callee = Flatten(e.callee_.get());
+    std::vector<NodeId> args;
+    for (const auto &arg : e.args_) {
+      args.push_back(Flatten(arg.get()));
+    }
+    return ast_.Add(FlatCallExpr{callee, AddList(args), e.loc_});
+  }
+  case UNARY_OPERATOR: {
+    const auto &e = llvm::cast<UnaryOperator>(*expr);
+    NodeId child = Flatten(e.expr_.get());
+    return ast_.Add(FlatUnaryOperator{
+        child, Intern(e.type_), Intern(e.op_.value_),
+        static_cast<uint16_t>(e.op_.type_), static_cast<uint16_t>(e.side_),
+        e.loc_});
+  }
+  case BINARY_OPERATOR: {
+    const auto &e = llvm::cast<BinaryOperator>(*expr);
+    NodeId left = Flatten(e.left_.get());
+    NodeId right = Flatten(e.right_.get());
+    return ast_.Add(FlatBinaryOperator{left, right, Intern(e.type_),
+                                       Intern(e.op_.value_),
+                                       static_cast<uint32_t>(e.op_.type_),
+                                       e.loc_});
+  }
+  case CONDITIONAL_OPERATOR: {
+    const auto &e = llvm::cast<ConditionalOperator>(*expr);
+    NodeId cond = Flatten(e.cond_.get());
+    NodeId true_expr = Flatten(e.true_expr_.get());
+    NodeId false_expr = Flatten(e.false_expr_.get());
+    return ast_.Add(FlatConditionalOperator{cond, true_expr, false_expr,
+                                            Intern(e.type_), e.loc_});
+  }
+  default:
+    llvm_unreachable("invalid expression kind");
+  }
+}
+
+auto Flattener::Flatten(const Stmt *stmt) -> NodeId {
+  if (stmt == nullptr) {
+    return {};
+  }
+  switch (stmt->GetNodeKind()) {
+  case COMPOUND_STMT: {
+    std::vector<NodeId> stmts;
+    for (const auto &child : llvm::cast<CompoundStmt>(*stmt).stmts_) {
+      stmts.push_back(Flatten(child.get()));
+    }
+    return ast_.Add(FlatCompoundStmt{AddList(stmts), stmt->loc_});
+  }
+  case EXPR_STMT: {
+    NodeId expr = Flatten(llvm::cast<ExprStmt>(*stmt).expr_.get());
+    return ast_.Add(FlatExprStmt{expr, stmt->loc_});
+  }
+  case DECL_STMT: {
+    NodeId decl = Flatten(llvm::cast<DeclStmt>(*stmt).decl_.get());
+    return ast_.Add(FlatDeclStmt{decl, stmt->loc_});
+  }
+  case IF_STMT: {
+    const auto &s = llvm::cast<IfStmt>(*stmt);
+    NodeId cond = Flatten(s.cond_.get());
+    NodeId then_stmt = Flatten(s.then_stmt_.get());
+    NodeId else_stmt = Flatten(s.else_stmt_.get());
+    return ast_.Add(FlatIfStmt{cond, then_stmt, else_stmt, s.loc_});
+  }
+  case WHILE_STMT: {
+    const auto &s = llvm::cast<WhileStmt>(*stmt);
+    NodeId cond = Flatten(s.cond_.get());
+    NodeId body = Flatten(s.stmt_.get());
+    return ast_.Add(FlatWhileStmt{cond, body, s.loc_});
+  }
+  case FOR_STMT: {
+    const auto &s = llvm::cast<ForStmt>(*stmt);
+    NodeId init = Flatten(s.init_.get());
+    NodeId cond = Flatten(s.cond_.get());
+    NodeId update = Flatten(s.update_.get());
+    NodeId body = Flatten(s.body_.get());
+    return ast_.Add(FlatForStmt{init, cond, update, body, s.loc_});
+  }
+  case RETURN_STMT: {
+    NodeId expr = Flatten(llvm::cast<ReturnStmt>(*stmt).expr_.get());
+    return ast_.Add(FlatReturnStmt{expr, stmt->loc_});
+  }
+  case SWITCH_STMT: {
+    const auto &s = llvm::cast<SwitchStmt>(*stmt);
+    NodeId cond = Flatten(s.cond_.get());
+    NodeId body = Flatten(s.body_.get());
+    return ast_.Add(FlatSwitchStmt{cond, body, s.loc_});
+  }
+  case CASE_STMT: {
+    NodeId value = Flatten(llvm::cast<CaseStmt>(*stmt).value_.get());
+    return ast_.Add(FlatCaseStmt{value, stmt->loc_});
+  }
+  case DEFAULT_STMT:
+    return ast_.Add(FlatDefaultStmt{stmt->loc_});
+  case BREAK_STMT:
+    return ast_.Add(FlatBreakStmt{stmt->loc_});
+  default:
+    llvm_unreachable("invalid statement kind");
+  }
+}
+
+auto Flattener::Flatten(const Decl *decl) -> NodeId {
+  if (decl == nullptr) {
+    return {};
+  }
+  switch (decl->GetNodeKind()) {
+  case VAR_DECL: {
+    const auto &d = llvm::cast<VarDecl>(*decl);
+    NodeId init = Flatten(d.init_.get());
+    return ast_.Add(FlatVarDecl{Intern(d.name_), Intern(d.type_), init,
+                                static_cast<uint32_t>(d.scope_), d.specs_,
+                                d.loc_});
+  }
+  case PARM_VAR_DECL: {
+    const auto &d = llvm::cast<ParmVarDecl>(*decl);
+    return ast_.Add(
+        FlatParmVarDecl{Intern(d.name_), Intern(d.type_), d.loc_});
+  }
+  case FUNCTION_DECL: {
+    const auto &d = llvm::cast<FunctionDecl>(*decl);
+    std::vector<NodeId> params;
+    for (const auto &param : d.proto_->params_) {
+      params.push_back(Flatten(param.get()));
+    }
+    NodeList param_list = AddList(params);
+    NodeId body = Flatten(d.body_.get());
+    return ast_.Add(FlatFunctionDecl{
+        Intern(d.proto_->name_), Intern(d.proto_->type_), param_list, body,
+        static_cast<uint32_t>(d.proto_->refered_),
+        static_cast<uint32_t>(d.kind_), d.specs_, d.loc_});
+  }
+  default:
+    llvm_unreachable("invalid declaration kind");
+  }
+}
+
+auto Flattener::FlattenRef(const Decl &decl) -> NodeId {
+  /// the parser gives every reference its own copy of the declaration, without
+  /// initializer or body, identical copies are stored once
+  std::string key;
+  if (const auto *var = llvm::dyn_cast<VarDecl>(&decl)) {
+    if (var->init_ != nullptr) {
+      return Flatten(&decl);
+    }
+    key = makeString("{}:{}:{}:{}:{}", static_cast<int>(var->GetNodeKind()),
+                     var->name_, var->type_, static_cast<int>(var->scope_),
+                     var->specs_);
+  } else if (const auto *func = llvm::dyn_cast<FunctionDecl>(&decl)) {
+    if (func->body_ != nullptr) {
+      return Flatten(&decl);
+    }
+    key = makeString("{}:{}:{}:{}:{}:{}", static_cast<int>(FUNCTION_DECL),
+                     func->proto_->name_, func->proto_->type_,
+                     func->proto_->refered_, static_cast<int>(func->kind_),
+                     func->specs_);
+    for (const auto &param : func->proto_->params_) {
+      key += makeString(":{}={}", param->name_, param->type_);
+    }
+  } else {
+    return Flatten(&decl);
+  }
+  auto it = refs_.find(key);
+  if (it != refs_.end()) {
+    return it->second;
+  }
+  NodeId id = Flatten(&decl);
+  refs_.emplace(std::move(key), id);
+  return id;
+}
+
+auto FlatAST::Flatten(const TranslationUnitDecl &unit) -> FlatAST {
+  FlatAST ast;
+  Flattener flattener(ast);
+  for (const auto &decl : unit.decls_) {
+    ast.decls_.push_back(flattener.Flatten(decl.get()));
+  }
+  ast.UpdateViews();
+  return ast;
+}
+
+void FlatAST::UpdateViews() {
+  node_views_ = std::apply(
+      [](const auto &...nodes) {
+        return NodeTables<llvm::ArrayRef>(llvm::ArrayRef(nodes)...);
+      },
+      nodes_);
+  lists_view_ = lists_;
+  strings_view_ = strings_;
+  string_data_view_ = llvm::StringRef(string_data_.data(), string_data_.size());
+  decls_view_ = decls_;
+}
+
+auto FlatAST::Load(const std::string &path) -> std::optional<FlatAST> {
+  /// large files are mapped, small ones are cheaper to read
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    return std::nullopt;
+  }
+  llvm::StringRef bytes = (*buffer)->getBuffer();
+  if (bytes.size() < sizeof(FileHeader) ||
+      reinterpret_cast<uintptr_t>(bytes.data()) % SECTION_ALIGN != 0) {
+    return std::nullopt;
+  }
+  FileHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic_, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version_ != FORMAT_VERSION ||
+      header.byte_order_ != BYTE_ORDER_MARK) {
+    return std::nullopt;
+  }
+
+  /// point a view at its section, the tables themselves are not checked, the
+  /// file is one written by `Save`
+  size_t idx = 0;
+  bool valid = true;
+  auto view = [&](auto &ref) {
+    using T = typename std::remove_reference_t<decltype(ref)>::value_type;
+    const Section &section = header.sections_[idx++];
+    if (section.elem_size_ != sizeof(T) || section.offset_ > bytes.size() ||
+        section.offset_ % alignof(T) != 0 ||
+        section.count_ > (bytes.size() - section.offset_) / sizeof(T)) {
+      valid = false;
+      return;
+    }
+    ref = llvm::ArrayRef<T>(
+        reinterpret_cast<const T *>(bytes.data() + section.offset_),
+        section.count_);
+  };
+
+  FlatAST ast;
+  std::apply([&](auto &...nodes) { (view(nodes), ...); }, ast.node_views_);
+  view(ast.lists_view_);
+  view(ast.strings_view_);
+  llvm::ArrayRef<char> string_data;
+  view(string_data);
+  view(ast.decls_view_);
+  if (!valid) {
+    return std::nullopt;
+  }
+  ast.string_data_view_ =
+      llvm::StringRef(string_data.data(), string_data.size());
+  ast.buffer_ = std::move(*buffer);
+  return ast;
+}
+
+auto FlatAST::Save(const std::string &path) const -> bool {
+  FileHeader header{};
+  std::memcpy(header.magic_, MAGIC, sizeof(MAGIC));
+  header.version_ = FORMAT_VERSION;
+  header.byte_order_ = BYTE_ORDER_MARK;
+
+  /// lay the tables out one after another behind the header
+  std::vector<llvm::ArrayRef<char>> data;
+  uint64_t offset = sizeof(FileHeader);
+  auto add = [&](const auto &ref) {
+    uint64_t size = ref.size() * sizeof(ref[0]);
+    offset = llvm::alignTo(offset, SECTION_ALIGN);
+    header.sections_[data.size()] = {offset, ref.size(), sizeof(ref[0])};
+    data.emplace_back(reinterpret_cast<const char *>(ref.data()), size);
+    offset += size;
+  };
+  std::apply([&](const auto &...nodes) { (add(nodes), ...); }, node_views_);
+  add(lists_view_);
+  add(strings_view_);
+  add(llvm::ArrayRef<char>(string_data_view_.data(), string_data_view_.size()));
+  add(decls_view_);
+
+  /// write into a temporary file first, so a concurrent `Load` never sees a
+  /// partial one
+  int fd;
+  llvm::SmallString<128> tmp_path;
+  if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tmp_path)) {
+    return false;
+  }
+  llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  uint64_t pos = sizeof(header);
+  for (size_t i = 0; i < data.size(); i++) {
+    os.write_zeros(header.sections_[i].offset_ - pos);
+    os.write(data[i].data(), data[i].size());
+    pos = header.sections_[i].offset_ + data[i].size();
+  }
+  os.close();
+  if (os.has_error()) {
+    os.clear_error();
+    llvm::sys::fs::remove(tmp_path);
+    return false;
+  }
+  if (llvm::sys::fs::rename(tmp_path, path)) {
+    llvm::sys::fs::remove(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+auto FlatAST::GetNodeCount() const -> size_t {
+  return std::apply(
+      [](const auto &...nodes) { return (nodes.size() + ...); }, node_views_);
+}
+
+auto FlatAST::GetMemoryUsage() const -> size_t {
+  size_t bytes = std::apply(
+      [](const auto &...nodes) {
+        return ((nodes.size() * sizeof(nodes[0])) + ...);
+      },
+      node_views_);
+  bytes += lists_view_.size() * sizeof(NodeId);
+  bytes += strings_view_.size() * sizeof(StringEntry);
+  bytes += string_data_view_.size();
+  return bytes + decls_view_.size() * sizeof(NodeId);
+}
+
+auto FlatAST::ExpandExpr(NodeId id) const -> std::unique_ptr<Expr> {
+  if (id.IsNull()) {
+    return nullptr;
+  }
+  switch (id.GetKind()) {
+  case INTEGER_LITERAL: {
+    const auto &e = Get<FlatIntegerLiteral>(id);
+    return MakeNode<IntegerLiteral>(e.loc_, e.value_,
+                                    GetString(e.type_).str());
+  }
+  case FLOATING_LITERAL: {
+    const auto &e = Get<FlatFloatingLiteral>(id);
+    return MakeNode<FloatingLiteral>(e.loc_, e.value_,
+                                     GetString(e.type_).str());
+  }
+  case STRING_LITERAL: {
+    const auto &e = Get<FlatStringLiteral>(id);
+    return MakeNode<StringLiteral>(e.loc_, GetString(e.value_).str(),
+                                   GetString(e.type_).str());
+  }
+  case DECL_REF_EXPR: {
+    const auto &e = Get<FlatDeclRefExpr>(id);
+    return MakeNode<DeclRefExpr>(e.loc_, ExpandDecl(e.decl_));
+  }
+  case IMPLICIT_CAST_EXPR: {
+    const auto &e = Get<FlatImplicitCastExpr>(id);
+    return MakeNode<ImplicitCastExpr>(e.loc_, GetString(e.type_).str(),
+                                      ExpandExpr(e.expr_));
+  }
+  case PAREN_EXPR: {
+    const auto &e = Get<FlatParenExpr>(id);
+    return MakeNode<ParenExpr>(e.loc_, ExpandExpr(e.expr_));
+  }
+  case CALL_EXPR: {
+    const auto &e = Get<FlatCallExpr>(id);
+    std::unique_ptr<DeclRefExpr> callee(
+        llvm::cast<DeclRefExpr>(ExpandExpr(e.callee_).release()));
+    std::vector<std::unique_ptr<Expr>> args;
+    const NodeId *children = GetList(e.args_);
+    for (uint32_t i = 0; i < e.args_.size_; i++) {
+      args.push_back(ExpandExpr(children[i]));
+    }
+    return MakeNode<CallExpr>(e.loc_, std::move(callee), std::move(args));
+  }
+  case UNARY_OPERATOR: {
+    const auto &e = Get<FlatUnaryOperator>(id);
+    return MakeNode<UnaryOperator>(
+        e.loc_,
+        Token(static_cast<TokenTy>(e.op_type_), GetString(e.op_value_).str()),
+        ExpandExpr(e.expr_), GetString(e.type_).str(),
+        static_cast<UnarySide>(e.side_));
+  }
+  case BINARY_OPERATOR: {
+    const auto &e = Get<FlatBinaryOperator>(id);
+    return MakeNode<BinaryOperator>(
+        e.loc_,
+        Token(static_cast<TokenTy>(e.op_type_), GetString(e.op_value_).str()),
+        ExpandExpr(e.left_), ExpandExpr(e.right_), GetString(e.type_).str());
+  }
+  case CONDITIONAL_OPERATOR: {
+    const auto &e = Get<FlatConditionalOperator>(id);
+    return MakeNode<ConditionalOperator>(
+        e.loc_, ExpandExpr(e.cond_), ExpandExpr(e.true_expr_),
+        ExpandExpr(e.false_expr_), GetString(e.type_).str());
+  }
+  default:
+    llvm_unreachable("invalid expression kind");
+  }
+}
+
+auto FlatAST::ExpandStmt(NodeId id) const -> std::unique_ptr<Stmt> {
+  if (id.IsNull()) {
+    return nullptr;
+  }
+  switch (id.GetKind()) {
+  case COMPOUND_STMT: {
+    const auto &s = Get<FlatCompoundStmt>(id);
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    const NodeId *children = GetList(s.stmts_);
+    for (uint32_t i = 0; i < s.stmts_.size_; i++) {
+      stmts.push_back(ExpandStmt(children[i]));
+    }
+    return MakeNode<CompoundStmt>(s.loc_, std::move(stmts));
+  }
+  case EXPR_STMT: {
+    const auto &s = Get<FlatExprStmt>(id);
+    return MakeNode<ExprStmt>(s.loc_, ExpandExpr(s.expr_));
+  }
+  case DECL_STMT: {
+    const auto &s = Get<FlatDeclStmt>(id);
+    return MakeNode<DeclStmt>(s.loc_, ExpandDecl(s.decl_));
+  }
+  case IF_STMT: {
+    const auto &s = Get<FlatIfStmt>(id);
+    return MakeNode<IfStmt>(s.loc_, ExpandExpr(s.cond_),
+                            ExpandStmt(s.then_stmt_), ExpandStmt(s.else_stmt_));
+  }
+  case WHILE_STMT: {
+    const auto &s = Get<FlatWhileStmt>(id);
+    return MakeNode<WhileStmt>(s.loc_, ExpandExpr(s.cond_),
+                               ExpandStmt(s.stmt_));
+  }
+  case FOR_STMT: {
+    const auto &s = Get<FlatForStmt>(id);
+    std::unique_ptr<DeclStmt> init(
+        llvm::cast<DeclStmt>(ExpandStmt(s.init_).release()));
+    return MakeNode<ForStmt>(s.loc_, std::move(init), ExpandExpr(s.cond_),
+                             ExpandExpr(s.update_), ExpandStmt(s.body_));
+  }
+  case RETURN_STMT: {
+    const auto &s = Get<FlatReturnStmt>(id);
+    return MakeNode<ReturnStmt>(s.loc_, ExpandExpr(s.expr_));
+  }
+  case SWITCH_STMT: {
+    const auto &s = Get<FlatSwitchStmt>(id);
+    return MakeNode<SwitchStmt>(s.loc_, ExpandExpr(s.cond_),
+                                ExpandStmt(s.body_));
+  }
+  case CASE_STMT: {
+    const auto &s = Get<FlatCaseStmt>(id);
+    return MakeNode<CaseStmt>(s.loc_, ExpandExpr(s.value_));
+  }
+  case DEFAULT_STMT:
+    return MakeNode<DefaultStmt>(Get<FlatDefaultStmt>(id).loc_);
+  case BREAK_STMT:
+    return MakeNode<BreakStmt>(Get<FlatBreakStmt>(id).loc_);
+  default:
+    llvm_unreachable("invalid statement kind");
+  }
+}
+
+auto FlatAST::ExpandDecl(NodeId id) const -> std::unique_ptr<Decl> {
+  if (id.IsNull()) {
+    return nullptr;
+  }
+  switch (id.GetKind()) {
+  case VAR_DECL: {
+    const auto &d = Get<FlatVarDecl>(id);
+    return MakeNode<VarDecl>(d.loc_, GetString(d.name_).str(),
+                             GetString(d.type_).str(), ExpandExpr(d.init_),
+                             static_cast<VarScope>(d.scope_), d.specs_);
+  }
+  case PARM_VAR_DECL: {
+    const auto &d = Get<FlatParmVarDecl>(id);
+    return MakeNode<ParmVarDecl>(d.loc_, GetString(d.name_).str(),
+                                 GetString(d.type_).str());
+  }
+  case FUNCTION_DECL: {
+    auto decl = ExpandPrototype(id);
+    decl->body_ = ExpandStmt(Get<FlatFunctionDecl>(id).body_);
+    return decl;
+  }
+  default:
+    llvm_unreachable("invalid declaration kind");
+  }
+}
+
+auto FlatAST::ExpandPrototype(NodeId id) const
+    -> std::unique_ptr<FunctionDecl> {
+  const auto &d = Get<FlatFunctionDecl>(id);
+  std::vector<std::unique_ptr<ParmVarDecl>> params;
+  const NodeId *children = GetList(d.params_);
+  for (uint32_t i = 0; i < d.params_.size_; i++) {
+    const auto &param = Get<FlatParmVarDecl>(children[i]);
+    params.push_back(MakeNode<ParmVarDecl>(param.loc_,
+                                           GetString(param.name_).str(),
+                                           GetString(param.type_).str()));
+  }
+  return MakeNode<FunctionDecl>(
+      d.loc_,
+      std::make_unique<FunctionProto>(GetString(d.name_).str(),
+                                      GetString(d.type_).str(),
+                                      std::move(params), d.refered_),
+      nullptr, static_cast<FuncKind>(d.kind_), d.specs_);
+}
+
+auto FlatAST::Expand() const -> std::unique_ptr<TranslationUnitDecl> {
+  std::vector<std::unique_ptr<Decl>> decls;
+  for (NodeId id : decls_view_) {
+    decls.push_back(ExpandDecl(id));
+  }
+  return std::make_unique<TranslationUnitDecl>(std::move(decls));
+}
+
+} // namespace toyc
@@ -8,30 +8,168 @@
 
 #include <llvm/ADT/APFloat.h>
 #include <llvm/ADT/APInt.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSwitch.h>
 #include <llvm/ADT/Triple.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Constant.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/PassTimingInfo.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/X86TargetParser.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/Scalar/TailRecursionElimination.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 namespace toyc {
 
+namespace {
+
+/// libtoyc math function implemented by an LLVM intrinsic
+struct Builtin {
+  llvm::Intrinsic::ID id_;
+  unsigned arity_;
+};
+
+auto GetBuiltin(llvm::StringRef name) -> Builtin {
+  return llvm::StringSwitch<Builtin>(name)
+      .Case("_absi", {llvm::Intrinsic::abs, 1})
+      .Case("_absf", {llvm::Intrinsic::fabs, 1})
+      .Case("_sqrt", {llvm::Intrinsic::sqrt, 1})
+      .Case("_ceil", {llvm::Intrinsic::ceil, 1})
+      .Case("_floor", {llvm::Intrinsic::floor, 1})
+      .Case("_trunc", {llvm::Intrinsic::trunc, 1})
+      .Case("_round", {llvm::Intrinsic::round, 1})
+      .Case("_rint", {llvm::Intrinsic::rint, 1})
+      .Case("_nearbyint", {llvm::Intrinsic::nearbyint, 1})
+      .Case("_sin", {llvm::Intrinsic::sin, 1})
+      .Case("_cos", {llvm::Intrinsic::cos, 1})
+      .Case("_exp", {llvm::Intrinsic::exp, 1})
+      .Case("_exp2", {llvm::Intrinsic::exp2, 1})
+      .Case("_log", {llvm::Intrinsic::log, 1})
+      .Case("_log2", {llvm::Intrinsic::log2, 1})
+      .Case("_log10", {llvm::Intrinsic::log10, 1})
+      .Case("_pow", {llvm::Intrinsic::pow, 2})
+      .Case("_fmax", {llvm::Intrinsic::maxnum, 2})
+      .Case("_fmin", {llvm::Intrinsic::minnum, 2})
+      .Case("_copysign", {llvm::Intrinsic::copysign, 2})
+      .Case("_fma", {llvm::Intrinsic::fma, 3})
+      .Default({llvm::Intrinsic::not_intrinsic, 0});
+}
+
+/// operands of `&&` and `||` and arms of `?:` worth evaluating up front
+/// instead of branching around: small, without side effects and unable to
+/// trap
+constexpr size_t CHEAP_OPERAND_NODES = 8;
+
+auto IsCheap(const Expr &expr, size_t &budget) -> bool {
+  /// parentheses and identity casts generate nothing
+  if (const auto *e = llvm::dyn_cast<ParenExpr>(&expr)) {
+    return IsCheap(*e->expr_, budget);
+  }
+  if (const auto *e = llvm::dyn_cast<ImplicitCastExpr>(&expr)) {
+    if (e->type_ == e->expr_->GetType()) {
+      return IsCheap(*e->expr_, budget);
+    }
+  }
+  if (budget == 0) {
+    return false;
+  }
+  budget--;
+  if (llvm::isa<IntegerLiteral, FloatingLiteral, DeclRefExpr>(expr)) {
+    return true;
+  }
+  if (const auto *e = llvm::dyn_cast<ImplicitCastExpr>(&expr)) {
+    return IsCheap(*e->expr_, budget);
+  }
+  if (const auto *e = llvm::dyn_cast<UnaryOperator>(&expr)) {
+    TokenTy op = e->op_.type_;
+    return op != INC_OP && op != DEC_OP && IsCheap(*e->expr_, budget);
+  }
+  if (const auto *e = llvm::dyn_cast<BinaryOperator>(&expr)) {
+    TokenTy op = e->op_.type_;
+    /// integer division traps on zero
+    if (op == EQUAL || op == DIV || op == MOD) {
+      return false;
+    }
+    return IsCheap(*e->left_, budget) && IsCheap(*e->right_, budget);
+  }
+  if (const auto *e = llvm::dyn_cast<ConditionalOperator>(&expr)) {
+    return IsCheap(*e->cond_, budget) && IsCheap(*e->true_expr_, budget) &&
+           IsCheap(*e->false_expr_, budget);
+  }
+  return false;
+}
+
+/// features of the host CPU as `+avx2,-avx512f,...`, sorted so that the IR
+/// does not depend on the order of a hash table
+auto GetHostFeatures() -> std::string {
+  llvm::StringMap<bool> host;
+  if (!llvm::sys::getHostCPUFeatures(host)) {
+    return "";
+  }
+  std::vector<std::string> names;
+  for (const auto &entry : host) {
+    names.push_back(entry.getKey().str());
+  }
+  std::sort(names.begin(), names.end());
+  llvm::SubtargetFeatures features;
+  for (const auto &name : names) {
+    features.AddFeature(name, host[name]);
+  }
+  return features.getString();
+}
+
+/// targets are registered once, shards initialize theirs from several
+/// threads
+void InitializeNativeTargetOnce() {
+  static std::once_flag native_target;
+  std::call_once(native_target, [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+}
+
+} // namespace
+
 /**
  * Base IR visitor
  */
@@ -51,6 +189,225 @@ void BaseIRVisitor::PrintVarEnv() {
   std::cout << "\033[0m\n";
 }
 
+void BaseIRVisitor::ClearVarEnv() {
+  var_env_.clear();
+  var_types_.clear();
+  current_defs_.clear();
+  incomplete_phis_.clear();
+  sealed_blocks_.clear();
+}
+
+auto BaseIRVisitor::CreateEntryAlloca(llvm::Type *type) -> llvm::AllocaInst * {
+  llvm::BasicBlock &entry =
+      builder_->GetInsertBlock()->getParent()->getEntryBlock();
+  /// after the slots already there, to keep them in declaration order
+  auto it = entry.begin();
+  while (it != entry.end() && llvm::isa<llvm::AllocaInst>(*it)) {
+    ++it;
+  }
+  llvm::IRBuilder<> entry_builder(&entry, it);
+  return entry_builder.CreateAlloca(type, nullptr);
+}
+
+void BaseIRVisitor::DeclareVariable(const std::string &name, llvm::Type *type,
+                                    llvm::Value *init) {
+  if (!direct_ssa_) {
+    llvm::AllocaInst *ptr = CreateEntryAlloca(type);
+    if (init != nullptr) {
+      builder_->CreateStore(init, ptr);
+    }
+    var_env_[name] = ptr;
+    return;
+  }
+  var_types_[name] = type;
+  current_defs_[name].clear();
+  /// reading an uninitialized variable gives whatever, as a stack slot would
+  WriteVariable(name, init != nullptr ? init : llvm::UndefValue::get(type));
+}
+
+auto BaseIRVisitor::IsLocalVariable(const std::string &name) -> bool {
+  if (direct_ssa_) {
+    return var_types_.contains(name);
+  }
+  auto it = var_env_.find(name);
+  return it != var_env_.end() && it->second != nullptr;
+}
+
+auto BaseIRVisitor::ReadVariable(const std::string &name) -> llvm::Value * {
+  if (!direct_ssa_) {
+    llvm::AllocaInst *ptr = var_env_[name];
+    return builder_->CreateLoad(ptr->getAllocatedType(), ptr);
+  }
+  return ReadVariable(name, builder_->GetInsertBlock());
+}
+
+auto BaseIRVisitor::WriteVariable(const std::string &name, llvm::Value *value)
+    -> llvm::Value * {
+  if (!direct_ssa_) {
+    return builder_->CreateStore(value, var_env_[name]);
+  }
+  current_defs_[name][builder_->GetInsertBlock()] = value;
+  return nullptr;
+}
+
+void BaseIRVisitor::ForgetVariable(const std::string &name) {
+  var_env_.erase(name);
+  var_types_.erase(name);
+  current_defs_.erase(name);
+}
+
+void BaseIRVisitor::SealBlock(llvm::BasicBlock *block) {
+  if (!direct_ssa_) {
+    return;
+  }
+  auto it = incomplete_phis_.find(block);
+  if (it != incomplete_phis_.end()) {
+    /// take the phis out first, filling them in may add to the map
+    auto phis = std::move(it->second);
+    incomplete_phis_.erase(it);
+    for (auto &[name, phi] : phis) {
+      AddPhiOperands(name, phi);
+    }
+  }
+  sealed_blocks_.insert(block);
+}
+
+auto BaseIRVisitor::ReadVariable(const std::string &name,
+                                 llvm::BasicBlock *block) -> llvm::Value * {
+  auto &defs = current_defs_[name];
+  auto it = defs.find(block);
+  if (it != defs.end()) {
+    return it->second;
+  }
+  return ReadVariableRecursive(name, block);
+}
+
+auto BaseIRVisitor::ReadVariableRecursive(const std::string &name,
+                                          llvm::BasicBlock *block)
+    -> llvm::Value * {
+  llvm::Value *value;
+  if (!sealed_blocks_.contains(block)) {
+    /// more predecessors to come, complete the phi in `SealBlock`
+    llvm::PHINode *phi = CreatePhi(name, block);
+    incomplete_phis_[block][name] = phi;
+    value = phi;
+  } else if (llvm::BasicBlock *pred = block->getSinglePredecessor()) {
+    value = ReadVariable(name, pred);
+  } else {
+    /// define the phi first to break cycles through loops
+    llvm::PHINode *phi = CreatePhi(name, block);
+    current_defs_[name][block] = phi;
+    value = AddPhiOperands(name, phi);
+  }
+  current_defs_[name][block] = value;
+  return value;
+}
+
+auto BaseIRVisitor::CreatePhi(const std::string &name, llvm::BasicBlock *block)
+    -> llvm::PHINode * {
+  llvm::Type *type = var_types_.at(name);
+  if (block->empty()) {
+    return llvm::PHINode::Create(type, 0, "", block);
+  }
+  return llvm::PHINode::Create(type, 0, "", &block->front());
+}
+
+auto BaseIRVisitor::AddPhiOperands(const std::string &name, llvm::PHINode *phi)
+    -> llvm::Value * {
+  for (llvm::BasicBlock *pred : llvm::predecessors(phi->getParent())) {
+    phi->addIncoming(ReadVariable(name, pred), pred);
+  }
+  return TryRemoveTrivialPhi(phi);
+}
+
+auto BaseIRVisitor::TryRemoveTrivialPhi(llvm::PHINode *phi) -> llvm::Value * {
+  llvm::Value *same = nullptr;
+  for (llvm::Value *op : phi->incoming_values()) {
+    if (op == same || op == phi) {
+      continue;
+    }
+    if (same != nullptr) {
+      /// merges at least two values
+      return phi;
+    }
+    same = op;
+  }
+  if (same == nullptr) {
+    /// unreachable or in the entry block
+    same = llvm::UndefValue::get(phi->getType());
+  }
+
+  /// users may turn trivial, removing one may delete another, hence weak
+  llvm::SmallVector<llvm::WeakVH, 4> users;
+  for (llvm::User *user : phi->users()) {
+    if (user != phi && llvm::isa<llvm::PHINode>(user)) {
+      users.emplace_back(user);
+    }
+  }
+  phi->replaceAllUsesWith(same);
+  for (auto &[name, defs] : current_defs_) {
+    for (auto &[block, def] : defs) {
+      if (def == phi) {
+        def = same;
+      }
+    }
+  }
+  phi->eraseFromParent();
+  for (llvm::WeakVH &user : users) {
+    if (auto *user_phi = llvm::dyn_cast_or_null<llvm::PHINode>(user)) {
+      TryRemoveTrivialPhi(user_phi);
+    }
+  }
+  return same;
+}
+
+auto BaseIRVisitor::LoadRuntime() -> bool {
+  /// `<prefix>/bin/toycc` finds `<prefix>/lib/libtoyc.bc`
+  llvm::SmallString<128> path(llvm::sys::path::parent_path(
+      llvm::sys::path::parent_path(
+          llvm::sys::fs::getMainExecutable(nullptr, nullptr))));
+  llvm::sys::path::append(path, "lib", "libtoyc.bc");
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    return false;
+  }
+  runtime_ = std::move(*buffer);
+  return true;
+}
+
+void BaseIRVisitor::LinkRuntime() {
+  if (runtime_ == nullptr) {
+    return;
+  }
+  auto runtime = llvm::getLazyBitcodeModule(*runtime_, *context_);
+  if (!runtime) {
+    throw CodeGenException(makeString(
+        "invalid runtime bitcode: {}", llvm::toString(runtime.takeError())));
+  }
+  /// the runtime is built for the host as well, only the spelling may differ
+  (*runtime)->setTargetTriple(module_->getTargetTriple());
+  (*runtime)->setDataLayout(module_->getDataLayout());
+  bool failed = llvm::Linker::linkModules(
+      *module_, std::move(*runtime), llvm::Linker::LinkOnlyNeeded,
+      [](llvm::Module &module, const llvm::StringSet<> &linked) {
+        /// the runtime must not ask for more target features than its
+        /// callers, or the inliner refuses to inline it
+        for (const auto &entry : linked) {
+          if (llvm::Function *func = module.getFunction(entry.getKey())) {
+            func->removeFnAttr("target-cpu");
+            func->removeFnAttr("target-features");
+            func->removeFnAttr("tune-cpu");
+          }
+        }
+        llvm::internalizeModule(module, [&linked](const llvm::GlobalValue &gv) {
+          return !gv.hasName() || !linked.contains(gv.getName());
+        });
+      });
+  if (failed) {
+    throw CodeGenException("failed to link the runtime bitcode");
+  }
+}
+
 void BaseIRVisitor::Dump(llvm::raw_ostream &os) {
   module_->print(os, nullptr, false, false);
 }
@@ -66,6 +423,144 @@ auto BaseIRVisitor::VerifyModule(llvm::raw_ostream &os) -> bool {
   return false;
 }
 
+void BaseIRVisitor::CreateCompileUnit() {
+  if (!debug_info_ || di_unit_ != nullptr) {
+    return;
+  }
+  di_builder_ = std::make_unique<llvm::DIBuilder>(*module_);
+  llvm::StringRef source = module_->getSourceFileName();
+  llvm::DIFile *file = di_builder_->createFile(
+      llvm::sys::path::filename(source), llvm::sys::path::parent_path(source));
+  /// toyc is close enough to C for debuggers to print values
+  di_unit_ = di_builder_->createCompileUnit(
+      llvm::dwarf::DW_LANG_C, file, "toyc", false, "", 0);
+  if (module_->getModuleFlag("Debug Info Version") == nullptr) {
+    module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                           llvm::DEBUG_METADATA_VERSION);
+    module_->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+  }
+}
+
+void BaseIRVisitor::FinalizeDebugInfo() {
+  if (di_builder_ == nullptr) {
+    return;
+  }
+  di_builder_->finalize();
+  di_builder_.reset();
+  di_unit_ = nullptr;
+}
+
+auto BaseIRVisitor::GetDebugType(llvm::Type *type) -> llvm::DIType * {
+  if (type->isIntegerTy(64)) {
+    return di_builder_->createBasicType("i64", 64, llvm::dwarf::DW_ATE_signed);
+  }
+  if (type->isDoubleTy()) {
+    return di_builder_->createBasicType("f64", 64, llvm::dwarf::DW_ATE_float);
+  }
+  /// void
+  return nullptr;
+}
+
+void BaseIRVisitor::EmitLocation(SourceLoc loc) {
+  if (di_scope_ == nullptr) {
+    return;
+  }
+  builder_->SetCurrentDebugLocation(llvm::DILocation::get(
+      *context_, loc.GetLine(), loc.GetCol(), di_scope_));
+}
+
+void BaseIRVisitor::DeclareDebugVariable(const std::string &name,
+                                         SourceLoc loc, unsigned arg_no) {
+  if (di_scope_ == nullptr || direct_ssa_) {
+    return;
+  }
+  llvm::AllocaInst *ptr = var_env_[name];
+  llvm::DIType *type = GetDebugType(ptr->getAllocatedType());
+  llvm::DIFile *file = di_scope_->getFile();
+  llvm::DILocalVariable *var =
+      arg_no != 0
+          ? di_builder_->createParameterVariable(di_scope_, name, arg_no, file,
+                                                 loc.GetLine(), type, true)
+          : di_builder_->createAutoVariable(di_scope_, name, file,
+                                            loc.GetLine(), type, true);
+  di_builder_->insertDeclare(
+      ptr, var, di_builder_->createExpression(),
+      llvm::DILocation::get(*context_, loc.GetLine(), loc.GetCol(), di_scope_),
+      builder_->GetInsertBlock());
+}
+
+auto BaseIRVisitor::IsTerminated() -> bool {
+  return builder_->GetInsertBlock()->getTerminator() != nullptr;
+}
+
+void BaseIRVisitor::AddFunctionAttrs(llvm::Function *func) {
+  auto it = func_attrs_.find(func->getName().str());
+  if (it == func_attrs_.end()) {
+    return;
+  }
+  const FunctionAttrs &attrs = it->second;
+  if (attrs.readnone_) {
+    func->setDoesNotAccessMemory();
+  } else if (attrs.readonly_) {
+    func->setOnlyReadsMemory();
+  }
+  if (attrs.nounwind_) {
+    func->setDoesNotThrow();
+  }
+  if (attrs.norecurse_) {
+    func->setDoesNotRecurse();
+  }
+  if (attrs.willreturn_) {
+    func->setWillReturn();
+  }
+}
+
+void BaseIRVisitor::AddCallAttrs(llvm::CallInst *call) {
+  llvm::Function *callee = call->getCalledFunction();
+  if (callee == nullptr) {
+    return;
+  }
+  auto it = func_attrs_.find(callee->getName().str());
+  if (it == func_attrs_.end()) {
+    return;
+  }
+  const FunctionAttrs &attrs = it->second;
+  if (attrs.readnone_) {
+    call->setDoesNotAccessMemory();
+  } else if (attrs.readonly_) {
+    call->setOnlyReadsMemory();
+  }
+  if (attrs.nounwind_) {
+    call->setDoesNotThrow();
+  }
+}
+
+auto BaseIRVisitor::CodegenBuiltin(llvm::Function *callee,
+                                   llvm::ArrayRef<llvm::Value *> args)
+    -> llvm::Value * {
+  if (!builtins_ || !callee->isDeclaration()) {
+    return nullptr;
+  }
+  Builtin builtin = GetBuiltin(callee->getName());
+  if (builtin.id_ == llvm::Intrinsic::not_intrinsic) {
+    return nullptr;
+  }
+  /// a declaration of another signature is not the libtoyc function
+  llvm::Type *type = callee->getReturnType();
+  if (args.size() != builtin.arity_ || callee->arg_size() != builtin.arity_ ||
+      llvm::any_of(args, [&](llvm::Value *arg) {
+        return arg->getType() != type;
+      })) {
+    return nullptr;
+  }
+  if (builtin.id_ == llvm::Intrinsic::abs) {
+    /// `_absi` of the minimum value wraps instead of being poison
+    return builder_->CreateBinaryIntrinsic(builtin.id_, args[0],
+                                           builder_->getFalse());
+  }
+  return builder_->CreateIntrinsic(builtin.id_, {type}, args);
+}
+
 auto BaseIRVisitor::GetFunction(const FunctionDecl &decl) -> llvm::Function * {
   /// function return type
   llvm::Type *result_ty;
@@ -80,7 +575,7 @@ auto BaseIRVisitor::GetFunction(const FunctionDecl &decl) -> llvm::Function * {
   /// function parameters
   std::vector<llvm::Type *> params;
   for (auto &param : decl.proto_->params_) {
-    params.push_back(param->Accept(*this));
+    params.push_back(Codegen(*param));
   }
 
   /// create function
@@ -88,9 +583,72 @@ auto BaseIRVisitor::GetFunction(const FunctionDecl &decl) -> llvm::Function * {
       llvm::FunctionType::get(result_ty, params, false);
   llvm::Function *func = llvm::Function::Create(
       func_ty, llvm::Function::ExternalLinkage, decl.proto_->name_, *module_);
+  AddFunctionAttrs(func);
+  if (decl.IsStatic()) {
+    SetStatic(func);
+  }
+  if (decl.IsInline()) {
+    func->addFnAttr(llvm::Attribute::InlineHint);
+  }
   return func;
 }
 
+auto BaseIRVisitor::ResolveTargetCPU(const std::string &cpu)
+    -> std::pair<std::string, std::string> {
+  if (cpu == "native") {
+    return {llvm::sys::getHostCPUName().str(), GetHostFeatures()};
+  }
+  /// the features of a named CPU, as clang spells them out for `-march`;
+  /// only x86 has a table of them outside its backend, other targets get
+  /// them from `target-cpu` alone
+  llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+  if (!triple.isX86() ||
+      llvm::X86::parseArchX86(cpu) == llvm::X86::CK_None) {
+    return {cpu, ""};
+  }
+  llvm::SmallVector<llvm::StringRef, 32> names;
+  llvm::X86::getFeaturesForCPU(cpu, names);
+  std::sort(names.begin(), names.end());
+  llvm::SubtargetFeatures features;
+  for (const auto &name : names) {
+    features.AddFeature(name);
+  }
+  return {cpu, features.getString()};
+}
+
+auto BaseIRVisitor::SelectTargetCPU(const std::string &march,
+                                    const std::string &mcpu)
+    -> const std::string & {
+  return mcpu.empty() ? march : mcpu;
+}
+
+auto BaseIRVisitor::IsTargetCPUValid(const std::string &cpu) -> bool {
+  if (cpu == "native") {
+    return true;
+  }
+  InitializeNativeTargetOnce();
+  std::string error;
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  const auto *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (target == nullptr) {
+    return false;
+  }
+  std::unique_ptr<llvm::MCSubtargetInfo> subtarget(
+      target->createMCSubtargetInfo(triple, "", ""));
+  return subtarget->isCPUStringValid(cpu);
+}
+
+void BaseIRVisitor::SetTargetCPU(const std::string &_cpu) {
+  std::tie(target_cpu_, target_features_) = ResolveTargetCPU(_cpu);
+}
+
+void BaseIRVisitor::SetStatic(llvm::GlobalObject *object) {
+  object->setLinkage(llvm::GlobalValue::InternalLinkage);
+  if (auto *func = llvm::dyn_cast<llvm::Function>(object)) {
+    func->setCallingConv(llvm::CallingConv::Fast);
+  }
+}
+
 /**
  * Expr
  */
@@ -105,9 +663,9 @@ auto BaseIRVisitor::Codegen(const FloatingLiteral &expr) -> llvm::Value * {
 
 auto BaseIRVisitor::Codegen(const ImplicitCastExpr &expr) -> llvm::Value * {
   if (expr.type_ == expr.expr_->GetType()) {
-    return expr.expr_->Accept(*this);
+    return Visit(*expr.expr_);
   }
-  llvm::Value *value = expr.expr_->Accept(*this);
+  llvm::Value *value = Visit(*expr.expr_);
   if (expr.type_ == "f64" && expr.expr_->GetType() == "i64") {
     return builder_->CreateSIToFP(value, llvm::Type::getDoubleTy(*context_));
   }
@@ -118,7 +676,112 @@ auto BaseIRVisitor::Codegen(const ImplicitCastExpr &expr) -> llvm::Value * {
 }
 
 auto BaseIRVisitor::Codegen(const ParenExpr &expr) -> llvm::Value * {
-  return expr.expr_->Accept(*this);
+  return Visit(*expr.expr_);
+}
+
+auto BaseIRVisitor::CodegenBool(llvm::Value *value) -> llvm::Value * {
+  if (value->getType()->isIntegerTy(1)) {
+    return value;
+  }
+  if (value->getType()->isDoubleTy()) {
+    /// NaN is true, as in C
+    return builder_->CreateFCmpUNE(
+        value, llvm::ConstantFP::get(value->getType(), 0));
+  }
+  return builder_->CreateICmpNE(value,
+                                llvm::ConstantInt::get(value->getType(), 0));
+}
+
+auto BaseIRVisitor::CodegenNumber(llvm::Value *value, llvm::Type *type)
+    -> llvm::Value * {
+  if (!value->getType()->isIntegerTy(1) || type->isIntegerTy(1)) {
+    return value;
+  }
+  return type->isDoubleTy() ? builder_->CreateUIToFP(value, type)
+                            : builder_->CreateZExt(value, type);
+}
+
+auto BaseIRVisitor::CodegenLogical(const BinaryOperator &expr)
+    -> llvm::Value * {
+  bool is_and = expr.op_.type_ == AND_OP;
+  size_t budget = CHEAP_OPERAND_NODES;
+  if (IsCheap(*expr.left_, budget) && IsCheap(*expr.right_, budget)) {
+    /// `select` instead of `and`/`or`, it does not leak poison of the right
+    /// operand when the left one decides
+    llvm::Value *l = CodegenBool(Visit(*expr.left_));
+    llvm::Value *r = CodegenBool(Visit(*expr.right_));
+    return is_and ? builder_->CreateSelect(l, r, builder_->getFalse())
+                  : builder_->CreateSelect(l, builder_->getTrue(), r);
+  }
+
+  llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
+  llvm::Value *l = CodegenBool(Visit(*expr.left_));
+  llvm::BasicBlock *left_b = builder_->GetInsertBlock();
+  llvm::BasicBlock *right_b =
+      llvm::BasicBlock::Create(*context_, "", parent_func);
+  llvm::BasicBlock *merge_b =
+      llvm::BasicBlock::Create(*context_, "", parent_func);
+  /// the right operand runs only if the left one does not decide
+  if (is_and) {
+    builder_->CreateCondBr(l, right_b, merge_b);
+  } else {
+    builder_->CreateCondBr(l, merge_b, right_b);
+  }
+  SealBlock(right_b);
+
+  builder_->SetInsertPoint(right_b);
+  llvm::Value *r = CodegenBool(Visit(*expr.right_));
+  right_b = builder_->GetInsertBlock();
+  builder_->CreateBr(merge_b);
+  SealBlock(merge_b);
+
+  builder_->SetInsertPoint(merge_b);
+  llvm::PHINode *phi = builder_->CreatePHI(builder_->getInt1Ty(), 2);
+  phi->addIncoming(is_and ? builder_->getFalse() : builder_->getTrue(), left_b);
+  phi->addIncoming(r, right_b);
+  return phi;
+}
+
+auto BaseIRVisitor::Codegen(const ConditionalOperator &expr) -> llvm::Value * {
+  llvm::Type *type = expr.type_ == "f64" ? builder_->getDoubleTy()
+                                         : builder_->getInt64Ty();
+  size_t budget = CHEAP_OPERAND_NODES;
+  if (IsCheap(*expr.true_expr_, budget) && IsCheap(*expr.false_expr_, budget)) {
+    llvm::Value *cond = CodegenBool(Visit(*expr.cond_));
+    llvm::Value *t = CodegenNumber(Visit(*expr.true_expr_), type);
+    llvm::Value *f = CodegenNumber(Visit(*expr.false_expr_), type);
+    return builder_->CreateSelect(cond, t, f);
+  }
+
+  llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
+  llvm::Value *cond = CodegenBool(Visit(*expr.cond_));
+  llvm::BasicBlock *true_b =
+      llvm::BasicBlock::Create(*context_, "", parent_func);
+  llvm::BasicBlock *false_b =
+      llvm::BasicBlock::Create(*context_, "", parent_func);
+  llvm::BasicBlock *merge_b =
+      llvm::BasicBlock::Create(*context_, "", parent_func);
+  builder_->CreateCondBr(cond, true_b, false_b);
+  SealBlock(true_b);
+  SealBlock(false_b);
+
+  /// only the selected arm runs
+  builder_->SetInsertPoint(true_b);
+  llvm::Value *t = CodegenNumber(Visit(*expr.true_expr_), type);
+  true_b = builder_->GetInsertBlock();
+  builder_->CreateBr(merge_b);
+
+  builder_->SetInsertPoint(false_b);
+  llvm::Value *f = CodegenNumber(Visit(*expr.false_expr_), type);
+  false_b = builder_->GetInsertBlock();
+  builder_->CreateBr(merge_b);
+  SealBlock(merge_b);
+
+  builder_->SetInsertPoint(merge_b);
+  llvm::PHINode *phi = builder_->CreatePHI(type, 2);
+  phi->addIncoming(t, true_b);
+  phi->addIncoming(f, false_b);
+  return phi;
 }
 
 /**
@@ -128,7 +791,11 @@ auto BaseIRVisitor::Codegen(const ParenExpr &expr) -> llvm::Value * {
 auto BaseIRVisitor::Codegen(const CompoundStmt &stmt) -> llvm::Value * {
   llvm::Value *ret_val = nullptr;
   for (auto &stmt : stmt.stmts_) {
-    if (llvm::Value *ret = stmt->Accept(*this)) {
+    /// code after a `return` or `break` can never run
+    if (IsTerminated()) {
+      break;
+    }
+    if (llvm::Value *ret = Visit(*stmt)) {
       ret_val = ret;
     }
   }
@@ -136,80 +803,67 @@ auto BaseIRVisitor::Codegen(const CompoundStmt &stmt) -> llvm::Value * {
 }
 
 auto BaseIRVisitor::Codegen(const ExprStmt &stmt) -> llvm::Value * {
-  return stmt.expr_->Accept(*this);
+  EmitLocation(stmt.loc_);
+  return Visit(*stmt.expr_);
 }
 
 auto BaseIRVisitor::Codegen(const DeclStmt &stmt) -> llvm::Value * {
-  if (auto *var = dynamic_cast<VarDecl *>(stmt.decl_.get())) {
-    return var->Accept(*this);
+  EmitLocation(stmt.loc_);
+  if (auto *var = llvm::dyn_cast<VarDecl>(stmt.decl_.get())) {
+    llvm::Value *val = Codegen(*var);
+    if (var->scope_ != GLOBAL) {
+      DeclareDebugVariable(var->name_, var->loc_);
+    }
+    return val;
   }
   throw CodeGenException("invalid declaration statement");
 }
 
 auto BaseIRVisitor::Codegen(const IfStmt &stmt) -> llvm::Value * {
   llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
-  llvm::Type *ret_ty = parent_func->getReturnType();
 
   /// set condition expression
-  llvm::Value *cond_val = stmt.cond_->Accept(*this);
+  EmitLocation(stmt.loc_);
+  llvm::Value *cond_val = Visit(*stmt.cond_);
   if (cond_val == nullptr) {
     throw CodeGenException("null condition expr for if-else statement");
   }
-  llvm::Value *zero_val;
-  llvm::Value *one_val;
-  if (cond_val->getType() != llvm::Type::getInt1Ty(*context_)) {
-    if (cond_val->getType() == llvm::Type::getInt64Ty(*context_)) {
-      zero_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0);
-      one_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 1);
-      cond_val = builder_->CreateICmpNE(cond_val, zero_val);
-    } else if (cond_val->getType() == llvm::Type::getInt64Ty(*context_)) {
-      zero_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 0);
-      one_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 1);
-      cond_val = builder_->CreateFCmpONE(cond_val, zero_val);
-    } else {
-      throw CodeGenException("not implemented!");
-    }
-  }
+  cond_val = CodegenBool(cond_val);
 
   if (stmt.else_stmt_ != nullptr) {
     /// create basic blocks
     llvm::BasicBlock *then_b =
         llvm::BasicBlock::Create(*context_, "", parent_func);
-    llvm::BasicBlock *else_b =
-        llvm::BasicBlock::Create(*context_, "", parent_func);
-    llvm::BasicBlock *merge_b =
-        llvm::BasicBlock::Create(*context_, "", parent_func);
+    llvm::BasicBlock *else_b = llvm::BasicBlock::Create(*context_);
+    llvm::BasicBlock *merge_b = llvm::BasicBlock::Create(*context_);
     builder_->CreateCondBr(cond_val, then_b, else_b);
+    SealBlock(then_b);
+    SealBlock(else_b);
 
     /// then block
     builder_->SetInsertPoint(then_b);
-    llvm::Value *then_val = stmt.then_stmt_->Accept(*this);
-    if (then_val == nullptr ||
-        then_val->getType() == llvm::Type::getVoidTy(*context_)) {
-      then_val = zero_val;
+    Visit(*stmt.then_stmt_);
+    if (!IsTerminated()) {
+      builder_->CreateBr(merge_b);
     }
-    builder_->CreateBr(merge_b);
-    then_b = builder_->GetInsertBlock();
 
     /// else block
     parent_func->insert(parent_func->end(), else_b);
     builder_->SetInsertPoint(else_b);
-    llvm::Value *else_val = nullptr;
-    else_val = stmt.else_stmt_->Accept(*this);
-    if (else_val == nullptr ||
-        else_val->getType() == llvm::Type::getVoidTy(*context_)) {
-      else_val = one_val;
+    Visit(*stmt.else_stmt_);
+    if (!IsTerminated()) {
+      builder_->CreateBr(merge_b);
     }
-    builder_->CreateBr(merge_b);
-    else_b = builder_->GetInsertBlock();
 
-    /// merge block
+    /// merge block, none if both branches return
+    if (llvm::pred_empty(merge_b)) {
+      delete merge_b;
+      return nullptr;
+    }
     parent_func->insert(parent_func->end(), merge_b);
+    SealBlock(merge_b);
     builder_->SetInsertPoint(merge_b);
-    llvm::PHINode *pn = builder_->CreatePHI(ret_ty, 2);
-    pn->addIncoming(then_val, then_b);
-    pn->addIncoming(else_val, else_b);
-    return pn;
+    return nullptr;
   }
   /**
    * if there is no else-stmt
@@ -218,96 +872,75 @@ auto BaseIRVisitor::Codegen(const IfStmt &stmt) -> llvm::Value * {
   /// create basic blocks
   llvm::BasicBlock *then_b =
       llvm::BasicBlock::Create(*context_, "then", parent_func);
-  llvm::BasicBlock *after_b =
-      llvm::BasicBlock::Create(*context_, "after", parent_func);
+  llvm::BasicBlock *after_b = llvm::BasicBlock::Create(*context_, "after");
   builder_->CreateCondBr(cond_val, then_b, after_b);
+  SealBlock(then_b);
 
   /// then block
   builder_->SetInsertPoint(then_b);
-  llvm::Value *then_val = stmt.then_stmt_->Accept(*this);
-  if (then_val == nullptr ||
-      then_val->getType() == llvm::Type::getVoidTy(*context_)) {
-    then_val = zero_val;
-  }
-
-  /// create return in if-stmt
-  if (parent_func->getReturnType()->isVoidTy()) {
-    builder_->CreateRetVoid();
-  } else {
-    /// if function does not have a terminator, create a return instruction
-    if (then_val == nullptr ||
-        (then_val != nullptr &&
-         then_val->getType() == llvm::Type::getVoidTy(*context_))) {
-      if (parent_func->getReturnType() == llvm::Type::getInt64Ty(*context_)) {
-        then_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0);
-      } else {
-        then_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 0);
-      }
-    }
-    builder_->CreateRet(then_val);
+  Visit(*stmt.then_stmt_);
+  if (!IsTerminated()) {
+    builder_->CreateBr(after_b);
   }
 
   /// after block
+  parent_func->insert(parent_func->end(), after_b);
+  SealBlock(after_b);
   builder_->SetInsertPoint(after_b);
-  return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*context_));
+  return nullptr;
 }
 
 auto BaseIRVisitor::Codegen(const WhileStmt &stmt) -> llvm::Value * {
   llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
-  llvm::Type *ret_ty = parent_func->getReturnType();
 
   /// create basic blocks
   llvm::BasicBlock *cond_b =
       llvm::BasicBlock::Create(*context_, "", parent_func);
   llvm::BasicBlock *body_b =
       llvm::BasicBlock::Create(*context_, "", parent_func);
-  llvm::BasicBlock *exit_b =
-      llvm::BasicBlock::Create(*context_, "", parent_func);
+  llvm::BasicBlock *exit_b = llvm::BasicBlock::Create(*context_);
 
   /// cond block
   builder_->CreateBr(cond_b);
   builder_->SetInsertPoint(cond_b);
 
   /// set condition expression
-  llvm::Value *cond_val = stmt.cond_->Accept(*this);
+  EmitLocation(stmt.loc_);
+  llvm::Value *cond_val = Visit(*stmt.cond_);
   if (cond_val == nullptr) {
     throw CodeGenException("null condition expr for if-else statement");
   }
-  llvm::Value *zero_val;
-  if (cond_val->getType() != llvm::Type::getInt1Ty(*context_)) {
-    if (cond_val->getType() == llvm::Type::getInt64Ty(*context_)) {
-      zero_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0);
-      cond_val = builder_->CreateICmpNE(cond_val, zero_val);
-    } else if (cond_val->getType() == llvm::Type::getInt64Ty(*context_)) {
-      zero_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 0);
-      cond_val = builder_->CreateFCmpONE(cond_val, zero_val);
-    } else {
-      throw CodeGenException("not implemented!");
-    }
-  }
+  cond_val = CodegenBool(cond_val);
 
   /// set condition branch
   builder_->CreateCondBr(cond_val, body_b, exit_b);
+  SealBlock(body_b);
 
-  /// then block
+  /// then block, `break` leaves to the exit block
   builder_->SetInsertPoint(body_b);
+  break_targets_.push_back(exit_b);
   if (stmt.stmt_ != nullptr) {
-    stmt.stmt_->Accept(*this);
+    Visit(*stmt.stmt_);
   }
-  builder_->CreateBr(cond_b);
+  break_targets_.pop_back();
+  if (!IsTerminated()) {
+    builder_->CreateBr(cond_b);
+  }
+  /// the back edge is the last predecessor of the condition
+  SealBlock(cond_b);
 
   /// exit block
+  parent_func->insert(parent_func->end(), exit_b);
+  SealBlock(exit_b);
   builder_->SetInsertPoint(exit_b);
   return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*context_));
 }
 
 auto BaseIRVisitor::Codegen(const ForStmt &stmt) -> llvm::Value * {
-  llvm::Value *init = stmt.init_->Accept(*this);
   llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
-  llvm::Type *ret_ty = parent_func->getReturnType();
 
   /// init
-  stmt.init_->Accept(*this);
+  Visit(*stmt.init_);
 
   /// condition block
   llvm::BasicBlock *cond_b =
@@ -315,30 +948,159 @@ auto BaseIRVisitor::Codegen(const ForStmt &stmt) -> llvm::Value * {
   builder_->CreateBr(cond_b);
   builder_->SetInsertPoint(cond_b);
   /// condition check
-  llvm::Value *cmp = stmt.cond_->Accept(*this);
+  EmitLocation(stmt.cond_->loc_);
+  llvm::Value *cmp = Visit(*stmt.cond_);
   llvm::BasicBlock *body_b =
       llvm::BasicBlock::Create(*context_, "", parent_func);
-  llvm::BasicBlock *exit_b =
-      llvm::BasicBlock::Create(*context_, "", parent_func);
+  llvm::BasicBlock *exit_b = llvm::BasicBlock::Create(*context_);
   builder_->CreateCondBr(cmp, body_b, exit_b);
+  SealBlock(body_b);
 
-  /// loop body
+  /// loop body, `break` leaves to the exit block
   builder_->SetInsertPoint(body_b);
-  stmt.body_->Accept(*this);
+  break_targets_.push_back(exit_b);
+  Visit(*stmt.body_);
+  break_targets_.pop_back();
   /// update loop
-  stmt.update_->Accept(*this);
-  builder_->CreateBr(cond_b);
+  if (!IsTerminated()) {
+    EmitLocation(stmt.update_->loc_);
+    Visit(*stmt.update_);
+    builder_->CreateBr(cond_b);
+  }
+  SealBlock(cond_b);
   /// exit
+  parent_func->insert(parent_func->end(), exit_b);
+  SealBlock(exit_b);
   builder_->SetInsertPoint(exit_b);
-  var_env_.erase(stmt.init_->decl_->GetName());
+  ForgetVariable(stmt.init_->decl_->GetName());
   return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*context_));
 }
 
 auto BaseIRVisitor::Codegen(const ReturnStmt &stmt) -> llvm::Value * {
+  EmitLocation(stmt.loc_);
+  llvm::Type *ret_ty =
+      builder_->GetInsertBlock()->getParent()->getReturnType();
+  llvm::Value *ret_val = nullptr;
   if (stmt.expr_ != nullptr) {
-    llvm::Value *ret_val = stmt.expr_->Accept(*this);
+    ret_val = Visit(*stmt.expr_);
+  }
+  if (ret_ty->isVoidTy()) {
+    MarkTailCall(ret_val);
+    builder_->CreateRetVoid();
     return ret_val;
   }
+  if (ret_val == nullptr) {
+    ret_val = llvm::Constant::getNullValue(ret_ty);
+  } else {
+    /// comparisons are `i1`, widen them to the return type
+    ret_val = CodegenNumber(ret_val, ret_ty);
+    MarkTailCall(ret_val);
+  }
+  builder_->CreateRet(ret_val);
+  return ret_val;
+}
+
+void BaseIRVisitor::MarkTailCall(llvm::Value *ret_val) {
+  auto *call = llvm::dyn_cast_or_null<llvm::CallInst>(ret_val);
+  llvm::BasicBlock *block = builder_->GetInsertBlock();
+  if (call == nullptr || call->getParent() != block || &block->back() != call) {
+    return;
+  }
+  /// toyc has no address-of, a callee never sees the stack slots of its
+  /// caller, so any call right before the `ret` may reuse the caller frame
+  call->setTailCall();
+  /// with the same signature and convention the backend can always jump to
+  /// the callee, which keeps deep tail recursion in constant stack at -O0
+  llvm::Function *caller = block->getParent();
+  llvm::Function *callee = call->getCalledFunction();
+  if (callee != nullptr && !callee->isIntrinsic() &&
+      callee->getFunctionType() == caller->getFunctionType() &&
+      callee->getCallingConv() == caller->getCallingConv()) {
+    call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  }
+}
+
+auto BaseIRVisitor::Codegen(const SwitchStmt &stmt) -> llvm::Value * {
+  llvm::Function *parent_func = builder_->GetInsertBlock()->getParent();
+
+  EmitLocation(stmt.loc_);
+  llvm::Value *cond_val = Visit(*stmt.cond_);
+  if (cond_val->getType()->isIntegerTy(1)) {
+    cond_val = builder_->CreateZExt(cond_val, builder_->getInt64Ty());
+  }
+  if (!cond_val->getType()->isIntegerTy(64)) {
+    throw CodeGenException("switch condition must be an integer");
+  }
+
+  /// one `switch` instruction for all the labels, the backend lowers dense
+  /// cases to a jump table and sparse ones to a balanced tree of compares;
+  /// without a `default` label it leaves to the exit block
+  const auto &body = llvm::cast<CompoundStmt>(*stmt.body_);
+  unsigned cases = llvm::count_if(body.stmts_, [](const StmtPtr &child) {
+    return llvm::isa<CaseStmt>(child.get());
+  });
+  llvm::BasicBlock *exit_b = llvm::BasicBlock::Create(*context_);
+  llvm::SwitchInst *switch_inst =
+      builder_->CreateSwitch(cond_val, exit_b, cases);
+  bool has_default = false;
+
+  break_targets_.push_back(exit_b);
+  for (const auto &child : body.stmts_) {
+    if (!llvm::isa<CaseStmt, DefaultStmt>(child.get())) {
+      /// code between a `break` or `return` and the next label never runs
+      if (!IsTerminated()) {
+        Visit(*child);
+      }
+      continue;
+    }
+    llvm::BasicBlock *label_b =
+        llvm::BasicBlock::Create(*context_, "", parent_func);
+    /// fall through from the statements of the previous label
+    if (!IsTerminated()) {
+      builder_->CreateBr(label_b);
+    }
+    if (const auto *c = llvm::dyn_cast<CaseStmt>(child.get())) {
+      auto *value = llvm::dyn_cast<llvm::ConstantInt>(Visit(*c->value_));
+      if (value == nullptr) {
+        throw CodeGenException("case value is not an integer constant");
+      }
+      if (switch_inst->findCaseValue(value) != switch_inst->case_default()) {
+        throw CodeGenException(
+            makeString("duplicate case value '{}'", value->getSExtValue()));
+      }
+      switch_inst->addCase(value, label_b);
+    } else {
+      if (has_default) {
+        throw CodeGenException("multiple default labels in one switch");
+      }
+      has_default = true;
+      switch_inst->setDefaultDest(label_b);
+    }
+    SealBlock(label_b);
+    builder_->SetInsertPoint(label_b);
+  }
+  break_targets_.pop_back();
+  if (!IsTerminated()) {
+    builder_->CreateBr(exit_b);
+  }
+
+  /// exit block, none if every path returns
+  if (llvm::pred_empty(exit_b)) {
+    delete exit_b;
+    return nullptr;
+  }
+  parent_func->insert(parent_func->end(), exit_b);
+  SealBlock(exit_b);
+  builder_->SetInsertPoint(exit_b);
+  return nullptr;
+}
+
+auto BaseIRVisitor::Codegen(const BreakStmt &stmt) -> llvm::Value * {
+  if (break_targets_.empty()) {
+    throw CodeGenException("'break' statement not in loop or switch statement");
+  }
+  EmitLocation(stmt.loc_);
+  builder_->CreateBr(break_targets_.back());
   return nullptr;
 }
 
@@ -361,43 +1123,77 @@ auto BaseIRVisitor::Codegen(const FunctionDecl &decl) -> llvm::Function * {
   if (decl.kind_ == EXTERN_FUNC) {
     return func;
   }
+  /// the CPU travels with the function, so tools compiling the IR later
+  /// (llc, the JIT, the linker with LTO) generate code for it as well
+  if (!target_cpu_.empty()) {
+    func->addFnAttr("target-cpu", target_cpu_);
+  }
+  if (!target_features_.empty()) {
+    func->addFnAttr("target-features", target_features_);
+  }
 
   /// function entry point
   llvm::BasicBlock *bb = llvm::BasicBlock::Create(*context_, "", func);
   builder_->SetInsertPoint(bb);
 
+  /// subprogram of the function, the prologue belongs to its declaration
+  if (debug_info_) {
+    CreateCompileUnit();
+    llvm::SmallVector<llvm::Metadata *, 4> types;
+    types.push_back(GetDebugType(func->getReturnType()));
+    for (auto &param : func->args()) {
+      types.push_back(GetDebugType(param.getType()));
+    }
+    llvm::DIFile *file = di_unit_->getFile();
+    di_scope_ = di_builder_->createFunction(
+        file, decl.GetName(), func->getName(), file, decl.loc_.GetLine(),
+        di_builder_->createSubroutineType(
+            di_builder_->getOrCreateTypeArray(types)),
+        decl.loc_.GetLine(), llvm::DINode::FlagPrototyped,
+        llvm::DISubprogram::SPFlagDefinition |
+            (func->hasLocalLinkage() ? llvm::DISubprogram::SPFlagLocalToUnit
+                                     : llvm::DISubprogram::SPFlagZero));
+    func->setSubprogram(di_scope_);
+    EmitLocation(decl.loc_);
+  }
+
   /// clear local variable table
   ClearVarEnv();
+  SealBlock(bb);
   for (auto &param : func->args()) {
     size_t idx = param.getArgNo();
     std::string param_name = decl.proto_->params_[idx]->name_;
     llvm::Type *type = func->getFunctionType()->getParamType(idx);
-    var_env_[param_name] = builder_->CreateAlloca(type, nullptr);
-    builder_->CreateStore(&param, var_env_[param_name]);
+    DeclareVariable(param_name, type, &param);
+    DeclareDebugVariable(param_name, decl.proto_->params_[idx]->loc_,
+                         idx + 1);
   }
 
   /// return type
   llvm::Value *ret_val = nullptr;
+  break_targets_.clear();
   if (decl.body_ != nullptr) {
-    if (llvm::Value *ret = decl.body_->Accept(*this)) {
+    if (llvm::Value *ret = Visit(*decl.body_)) {
       ret_val = ret;
     }
   }
-  /// create void return if function type is void
-  if (func->getReturnType()->isVoidTy()) {
-    builder_->CreateRetVoid();
-  } else {
-    /// if function does not have a terminator, create a return instruction
-    if (ret_val == nullptr ||
-        (ret_val != nullptr &&
-         ret_val->getType() == llvm::Type::getVoidTy(*context_))) {
-      if (func->getReturnType() == llvm::Type::getInt64Ty(*context_)) {
-        ret_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0);
-      } else {
-        ret_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 0);
+  /// nothing to add if every path of the body ends with a `return`
+  if (!IsTerminated()) {
+    /// create void return if function type is void
+    if (func->getReturnType()->isVoidTy()) {
+      builder_->CreateRetVoid();
+    } else {
+      /// falling off the end returns the value of the last statement
+      if (ret_val == nullptr || ret_val->getType() != func->getReturnType()) {
+        ret_val = llvm::Constant::getNullValue(func->getReturnType());
       }
+      builder_->CreateRet(ret_val);
     }
-    builder_->CreateRet(ret_val);
+  }
+  if (di_scope_ != nullptr) {
+    di_builder_->finalizeSubprogram(di_scope_);
+    di_scope_ = nullptr;
+    builder_->SetCurrentDebugLocation(llvm::DebugLoc());
   }
   return func;
 }
@@ -433,18 +1229,129 @@ void CompilerIRVisitor::SetModuleID(std::string &name) {
   module_->setSourceFileName(name);
 }
 
+void CompilerIRVisitor::WriteBitcode(llvm::raw_ostream &os) {
+  llvm::WriteBitcodeToFile(*module_, os);
+}
+
+void CompilerIRVisitor::LinkBitcode(llvm::MemoryBufferRef bitcode) {
+  auto module = llvm::parseBitcodeFile(bitcode, *context_);
+  if (!module) {
+    throw CodeGenException(makeString("invalid module bitcode: {}",
+                                      llvm::toString(module.takeError())));
+  }
+  if (llvm::Linker::linkModules(*module_, std::move(*module))) {
+    throw CodeGenException("failed to link the module bitcode");
+  }
+}
+
+void CompilerIRVisitor::SetStatic(llvm::GlobalObject *object) {
+  BaseIRVisitor::SetStatic(object);
+  /// shards define what others declare, an internal name would not resolve
+  if (shards_ > 1) {
+    object->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    object->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+}
+
+void CompilerIRVisitor::InternalizeShards() {
+  for (llvm::GlobalObject &object : module_->global_objects()) {
+    if (!object.isDeclaration() && object.hasHiddenVisibility()) {
+      object.setVisibility(llvm::GlobalValue::DefaultVisibility);
+      object.setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+  }
+}
+
+void CompilerIRVisitor::Optimize(llvm::OptimizationLevel level) {
+  bool instrument = pgo_ && pgo_->Action == llvm::PGOOptions::IRInstr;
+  if (level == llvm::OptimizationLevel::O0 && !instrument) {
+    return;
+  }
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  /// -ftime-report times each pass
+  llvm::PassInstrumentationCallbacks pic;
+  std::unique_ptr<llvm::StandardInstrumentations> si;
+  if (llvm::TimePassesIsEnabled) {
+    si = std::make_unique<llvm::StandardInstrumentations>(*context_, false);
+    si->registerCallbacks(pic, &fam);
+  }
+  llvm::PassBuilder pb(target_machine_.get(), llvm::PipelineTuningOptions(),
+                       pgo_, &pic);
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  /// only -O2 and up eliminate tail recursion by default, turn the recursive
+  /// calls (with an accumulator when needed) into loops at -O1 too
+  if (level == llvm::OptimizationLevel::O1) {
+    pb.registerScalarOptimizerLateEPCallback(
+        [](llvm::FunctionPassManager &fpm, llvm::OptimizationLevel) {
+          fpm.addPass(llvm::TailCallElimPass());
+        });
+  }
+  /// the pipeline does not split cold code by default, with a profile the
+  /// blocks it never saw run are known to be cold
+  if (pgo_ && pgo_->Action == llvm::PGOOptions::IRUse) {
+    pb.registerOptimizerLastEPCallback(
+        [](llvm::ModulePassManager &mpm, llvm::OptimizationLevel) {
+          mpm.addPass(llvm::HotColdSplittingPass());
+        });
+  }
+  llvm::ModulePassManager mpm = level == llvm::OptimizationLevel::O0
+                                    ? pb.buildO0DefaultPipeline(level)
+                                    : pb.buildPerModuleDefaultPipeline(level);
+  mpm.run(*module_, mam);
+}
+
+void CompilerIRVisitor::InitializeTarget() {
+  InitializeNativeTargetOnce();
+
+  std::string error;
+  const std::string &triple = module_->getTargetTriple();
+  const auto *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (target == nullptr) {
+    throw CodeGenException(error);
+  }
+  std::string cpu = target_cpu_.empty() ? "generic" : target_cpu_;
+  /// LLVM only warns about an unknown CPU and falls back to the baseline
+  if (!IsTargetCPUValid(cpu)) {
+    throw CodeGenException(makeString("unknown target CPU '{}'", cpu));
+  }
+  llvm::TargetOptions options;
+  target_machine_.reset(target->createTargetMachine(
+      triple, cpu, target_features_, options, llvm::Reloc::PIC_));
+  module_->setDataLayout(target_machine_->createDataLayout());
+}
+
+void CompilerIRVisitor::EmitObject(llvm::raw_pwrite_stream &os) {
+  if (target_machine_ == nullptr) {
+    InitializeTarget();
+  }
+  llvm::legacy::PassManager pm;
+  if (target_machine_->addPassesToEmitFile(pm, os, nullptr,
+                                           llvm::CGFT_ObjectFile)) {
+    throw CodeGenException("target can not emit object files");
+  }
+  pm.run(*module_);
+}
+
 auto CompilerIRVisitor::Codegen(const DeclRefExpr &expr) -> llvm::Value * {
   std::string var_name = expr.decl_->GetName();
-  llvm::AllocaInst *id = var_env_[var_name];
-  if (id != nullptr) {
-    auto *id_val = builder_->CreateLoad(id->getAllocatedType(), id);
-    if (id_val == nullptr) {
-      throw CodeGenException(makeString("identifier '{}' not load", var_name));
-    }
-    return id_val;
+  if (IsLocalVariable(var_name)) {
+    return ReadVariable(var_name);
   }
   llvm::GlobalVariable *gid = global_var_env_[var_name];
   if (gid != nullptr) {
+    /// reads of a `const` variable fold to its initializer
+    if (gid->isConstant() && gid->hasInitializer()) {
+      return gid->getInitializer();
+    }
     auto *id_val = builder_->CreateLoad(gid->getValueType(), gid);
     if (id_val == nullptr) {
       throw CodeGenException(makeString("identifier '{}' not load", var_name));
@@ -462,17 +1369,23 @@ auto CompilerIRVisitor::Codegen(const CallExpr &expr) -> llvm::Value * {
   }
   std::vector<llvm::Value *> arg_vals;
   for (auto &arg : expr.args_) {
-    llvm ::Value *arg_val = arg->Accept(*this);
+    llvm ::Value *arg_val = Visit(*arg);
     if (arg_val == nullptr) {
       throw CodeGenException("params not exists");
     }
     arg_vals.push_back(arg_val);
   }
-  return builder_->CreateCall(callee, arg_vals);
+  if (llvm::Value *builtin = CodegenBuiltin(callee, arg_vals)) {
+    return builtin;
+  }
+  llvm::CallInst *call = builder_->CreateCall(callee, arg_vals);
+  call->setCallingConv(callee->getCallingConv());
+  AddCallAttrs(call);
+  return call;
 }
 
 auto CompilerIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
-  llvm::Value *e = expr.expr_->Accept(*this);
+  llvm::Value *e = Visit(*expr.expr_);
   if (e == nullptr) {
     throw CodeGenException("[UnaryOperator] the operand is null");
   }
@@ -484,14 +1397,19 @@ auto CompilerIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
   } else {
     one_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 1);
   }
-  llvm::Value *ptr;
-  if (auto *left = dynamic_cast<DeclRefExpr *>(expr.expr_.get())) {
+  /// store the updated value back to the variable
+  auto update = [&](llvm::Value *updated) {
+    auto *left = llvm::dyn_cast<DeclRefExpr>(expr.expr_.get());
+    if (left == nullptr) {
+      throw CodeGenException("[UnaryOperator] operand is not assignable");
+    }
     std::string var_name = left->decl_->GetName();
-    ptr = var_env_[var_name];
-    if (ptr == nullptr) {
-      ptr = global_var_env_[var_name];
+    if (IsLocalVariable(var_name)) {
+      WriteVariable(var_name, updated);
+    } else {
+      builder_->CreateStore(updated, global_var_env_[var_name]);
     }
-  }
+  };
 
   switch (expr.op_.type_) {
   case ADD:
@@ -511,7 +1429,7 @@ auto CompilerIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
     } else {
       updated = builder_->CreateFAdd(e, one_val);
     }
-    builder_->CreateStore(updated, ptr);
+    update(updated);
     if (expr.side_ == POSTFIX) {
       return e;
     }
@@ -524,7 +1442,7 @@ auto CompilerIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
     } else {
       updated = builder_->CreateFSub(e, one_val);
     }
-    builder_->CreateStore(updated, ptr);
+    update(updated);
     if (expr.side_ == POSTFIX) {
       return e;
     }
@@ -541,30 +1459,27 @@ auto CompilerIRVisitor::Codegen(const BinaryOperator &expr) -> llvm::Value * {
   llvm::Value *r;
 
   if (expr.op_.type_ == EQUAL) {
-    if (auto *left = dynamic_cast<DeclRefExpr *>(expr.left_.get())) {
+    if (auto *left = llvm::dyn_cast<DeclRefExpr>(expr.left_.get())) {
       std::string var_name = left->decl_->GetName();
-      l = var_env_[var_name];
-      if (l == nullptr) {
-        l = global_var_env_[var_name];
+      r = Visit(*expr.right_);
+      if (IsLocalVariable(var_name)) {
+        return WriteVariable(var_name, r);
       }
+      return builder_->CreateStore(r, global_var_env_[var_name]);
     }
-    r = expr.right_->Accept(*this);
-    return builder_->CreateStore(r, l);
-  }
-
-  l = expr.left_->Accept(*this);
-  r = expr.right_->Accept(*this);
-  if (l == nullptr || r == nullptr) {
-    throw CodeGenException("[BinaryOperator] operands must be not null");
+    throw CodeGenException("[BinaryOperator] left operand is not assignable");
   }
 
   /// logical operation (no matter types)
   TokenTy op_ty = expr.op_.type_;
-  if (op_ty == AND_OP) {
-    return builder_->CreateAnd(l, r);
+  if (op_ty == AND_OP || op_ty == OR_OP) {
+    return CodegenLogical(expr);
   }
-  if (op_ty == OR_OP) {
-    return builder_->CreateOr(l, r);
+
+  l = Visit(*expr.left_);
+  r = Visit(*expr.right_);
+  if (l == nullptr || r == nullptr) {
+    throw CodeGenException("[BinaryOperator] operands must be not null");
   }
 
   if (expr.type_ == "i64") {
@@ -634,43 +1549,61 @@ auto CompilerIRVisitor::Codegen(const VarDecl &decl) -> llvm::Value * {
       (decl.type_ == "i64" ? builder_->getInt64Ty() : builder_->getDoubleTy());
   llvm::Constant *initializer =
       (decl.init_ != nullptr
-           ? reinterpret_cast<llvm::Constant *>(decl.init_->Accept(*this))
+           ? reinterpret_cast<llvm::Constant *>(Visit(*decl.init_))
            : nullptr);
 
   if (decl.scope_ == GLOBAL) {
-    auto *var = new llvm::GlobalVariable(*module_, var_ty, false,
+    /// comparisons are `i1`, widen them to the type of the variable
+    if (initializer != nullptr) {
+      initializer =
+          llvm::cast<llvm::Constant>(CodegenNumber(initializer, var_ty));
+    }
+    /// shards other than 0 refer to the definition of shard 0
+    if (shard_ != 0 && !decl.IsConst()) {
+      initializer = nullptr;
+    }
+    auto *var = new llvm::GlobalVariable(*module_, var_ty, decl.IsConst(),
                                          llvm::GlobalVariable::ExternalLinkage,
                                          initializer, decl.name_);
+    if (decl.IsStatic()) {
+      SetStatic(var);
+    }
+    /// the others keep the value of a `const` variable, to fold its reads
+    if (shard_ != 0 && decl.IsConst()) {
+      var->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    }
     global_var_env_[decl.name_] = var;
     return var;
   }
 
-  llvm::AllocaInst *ptr = builder_->CreateAlloca(var_ty, nullptr);
-  if (decl.init_ != nullptr) {
-    builder_->CreateStore(initializer, ptr);
-  }
-  var_env_[decl.name_] = ptr;
-  return ptr;
+  DeclareVariable(decl.name_, var_ty, initializer);
+  return direct_ssa_ ? nullptr : var_env_[decl.name_];
 }
 
 /**
  * TranslationUnitDecl
  */
 
-void CompilerIRVisitor::Codegen(const TranslationUnitDecl &decl) {
-  for (auto &d : decl.decls_) {
-    if (auto *var_decl = dynamic_cast<VarDecl *>(d.get())) {
-      var_decl->Accept(*this);
-    } else if (auto *func_decl = dynamic_cast<FunctionDecl *>(d.get())) {
-      if (func_decl->GetKind() != DECLARATION) {
-        func_decl->Accept(*this);
+void CompilerIRVisitor::CodegenTopLevel(const Decl &decl) {
+  if (const auto *var_decl = llvm::dyn_cast<VarDecl>(&decl)) {
+    Codegen(*var_decl);
+  } else if (const auto *func_decl = llvm::dyn_cast<FunctionDecl>(&decl)) {
+    if (func_decl->kind_ == EXTERN_FUNC) {
+      GetFunction(*func_decl);
+    } else if (func_decl->kind_ != DECLARATION) {
+      /// definitions of other shards are only declared
+      if (definitions_++ % shards_ == shard_) {
+        BaseIRVisitor::Codegen(*func_decl);
+      } else {
+        GetFunction(*func_decl);
       }
-    } else {
-      throw CodeGenException("[TranslationUnitDecl] unsupported declaration");
     }
+  } else {
+    throw CodeGenException("[TranslationUnitDecl] unsupported declaration");
   }
+}
 
-  /// remove not used extern functions
+void CompilerIRVisitor::RemoveUnusedExternFunctions() {
   auto function_list = &module_->getFunctionList();
   for (auto it = function_list->begin(), end = function_list->end();
        it != end;) {
@@ -682,4 +1615,32 @@ void CompilerIRVisitor::Codegen(const TranslationUnitDecl &decl) {
   }
 }
 
+void CompilerIRVisitor::Codegen(const TranslationUnitDecl &decl) {
+  for (auto &d : decl.decls_) {
+    CodegenTopLevel(*d);
+  }
+  RemoveUnusedExternFunctions();
+  FinalizeDebugInfo();
+}
+
+void CompilerIRVisitor::Codegen(const FlatAST &ast) {
+  /// expand one top-level declaration at a time, so only the flat encoding of
+  /// the unit stays alive
+  for (NodeId id : ast.GetDecls()) {
+    /// definitions of other shards are only declared, so the bodies of
+    /// their functions are not expanded
+    if (id.GetKind() == FUNCTION_DECL) {
+      auto kind = static_cast<FuncKind>(ast.Get<FlatFunctionDecl>(id).kind_);
+      if (kind != EXTERN_FUNC && kind != DECLARATION &&
+          definitions_ % shards_ != shard_) {
+        CodegenTopLevel(*ast.ExpandPrototype(id));
+        continue;
+      }
+    }
+    CodegenTopLevel(*ast.ExpandDecl(id));
+  }
+  RemoveUnusedExternFunctions();
+  FinalizeDebugInfo();
+}
+
 } // namespace toyc
@@ -25,6 +25,7 @@
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Utils.h>
 
 #include <cstddef>
 #include <cstdint>
@@ -32,6 +33,7 @@
 #include <memory>
 #include <tuple>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace toyc {
@@ -40,16 +42,33 @@ void InterpreterIRVisitor::Initialize() {
   context_ = std::make_unique<llvm::LLVMContext>();
   module_ = std::make_unique<llvm::Module>("toyc jit", *context_);
   module_->setDataLayout(jit_->GetDataLayout());
+  if (!source_name_.empty()) {
+    module_->setSourceFileName(source_name_);
+  }
   builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
 
   fpm_ = std::make_unique<llvm::legacy::FunctionPassManager>(module_.get());
+  fpm_->add(llvm::createPromoteMemoryToRegisterPass());
   fpm_->add(llvm::createInstructionCombiningPass());
   fpm_->add(llvm::createReassociatePass());
   fpm_->add(llvm::createGVNPass());
   fpm_->add(llvm::createCFGSimplificationPass());
+  /// self recursion into loops, so deep recursion does not grow the stack
+  fpm_->add(llvm::createTailCallEliminationPass());
   fpm_->doInitialization();
 }
 
+auto InterpreterIRVisitor::TakeModule() -> llvm::orc::ThreadSafeModule {
+  FinalizeDebugInfo();
+  for (llvm::Function &func : *module_) {
+    if (!func.isDeclaration()) {
+      fpm_->run(func);
+    }
+  }
+  fpm_->doFinalization();
+  return {std::move(module_), std::move(context_)};
+}
+
 void InterpreterIRVisitor::ResetReferGlobalVar() {
   for (auto &var : global_var_env_) {
     if (auto &f = var.second) {
@@ -75,6 +94,21 @@ InterpreterIRVisitor::InterpreterIRVisitor() {
   Initialize();
 }
 
+void InterpreterIRVisitor::SetTargetCPU(const std::string &_cpu) {
+  BaseIRVisitor::SetTargetCPU(_cpu);
+  /// the target machine of the JIT compiles whole modules, the attributes
+  /// of the functions alone would leave the rest to the baseline CPU
+  jit_ = exit_on_err_(ToycJIT::Create(target_cpu_, target_features_));
+  Initialize();
+}
+
+void InterpreterIRVisitor::EnableDebugInfo(const std::string &source) {
+  debug_info_ = true;
+  source_name_ = source;
+  module_->setSourceFileName(source_name_);
+  jit_->RegisterDebuggerListeners();
+}
+
 auto InterpreterIRVisitor::GetGlobalVar(const std::string &name)
     -> llvm::GlobalVariable * {
   llvm::GlobalVariable *var = nullptr;
@@ -104,6 +138,10 @@ auto InterpreterIRVisitor::GetFunction(const FunctionDecl &decl)
     }
     fn->refered_++;
   }
+  /// an `extern` declared in this module already
+  if (llvm::Function *func = module_->getFunction(func_name)) {
+    return func;
+  }
 
   /// function return type
   llvm::Type *result_ty;
@@ -118,7 +156,7 @@ auto InterpreterIRVisitor::GetFunction(const FunctionDecl &decl)
   /// function parameters
   std::vector<llvm::Type *> params;
   for (auto &param : decl.proto_->params_) {
-    params.push_back(param->Accept(*this));
+    params.push_back(Codegen(*param));
   }
 
   /// create function
@@ -126,6 +164,7 @@ auto InterpreterIRVisitor::GetFunction(const FunctionDecl &decl)
       llvm::FunctionType::get(result_ty, params, false);
   llvm::Function *func = llvm::Function::Create(
       func_ty, llvm::Function::ExternalLinkage, decl.proto_->name_, *module_);
+  AddFunctionAttrs(func);
   return func;
 }
 
@@ -144,6 +183,17 @@ auto InterpreterIRVisitor::Codegen(const DeclRefExpr &expr) -> llvm::Value * {
     }
     return id_val;
   }
+  /// reads of a `const` variable fold to its value
+  auto it = global_var_env_.find(var_name);
+  if (it != global_var_env_.end() && it->second != nullptr &&
+      it->second->value_.has_value()) {
+    const ConstantValue &value = *it->second->value_;
+    if (const auto *i = std::get_if<int64_t>(&value)) {
+      return builder_->getInt64(*i);
+    }
+    return llvm::ConstantFP::get(builder_->getDoubleTy(),
+                                 std::get<double>(value));
+  }
   llvm::GlobalVariable *gid = GetGlobalVar(var_name);
   if (gid != nullptr) {
     llvm::LoadInst *id_val = builder_->CreateLoad(gid->getValueType(), gid);
@@ -158,25 +208,29 @@ auto InterpreterIRVisitor::Codegen(const DeclRefExpr &expr) -> llvm::Value * {
 
 auto InterpreterIRVisitor::Codegen(const CallExpr &expr) -> llvm::Value * {
   llvm::Function *callee =
-      // GetFunction((const FunctionDecl &)*expr.callee_->decl_);
-      GetFunction(reinterpret_cast<const FunctionDecl &>(*expr.callee_->decl_));
+      GetFunction(llvm::cast<FunctionDecl>(*expr.callee_->decl_));
   if (callee == nullptr) {
     throw CodeGenException(makeString("function '{}' not declared",
                                       expr.callee_->decl_->GetName()));
   }
   std::vector<llvm::Value *> arg_vals;
   for (auto &arg : expr.args_) {
-    llvm ::Value *arg_val = arg->Accept(*this);
+    llvm ::Value *arg_val = Visit(*arg);
     if (arg_val == nullptr) {
       throw CodeGenException("params not exists");
     }
     arg_vals.push_back(arg_val);
   }
-  return builder_->CreateCall(callee, arg_vals);
+  if (llvm::Value *builtin = CodegenBuiltin(callee, arg_vals)) {
+    return builtin;
+  }
+  llvm::CallInst *call = builder_->CreateCall(callee, arg_vals);
+  AddCallAttrs(call);
+  return call;
 }
 
 auto InterpreterIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
-  llvm::Value *e = expr.expr_->Accept(*this);
+  llvm::Value *e = Visit(*expr.expr_);
   if (e == nullptr) {
     throw CodeGenException("[UnaryOperator] the operand is null");
   }
@@ -189,7 +243,7 @@ auto InterpreterIRVisitor::Codegen(const UnaryOperator &expr) -> llvm::Value * {
     one_val = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context_), 1);
   }
   llvm::Value *ptr;
-  if (auto *left = dynamic_cast<DeclRefExpr *>(expr.expr_.get())) {
+  if (auto *left = llvm::dyn_cast<DeclRefExpr>(expr.expr_.get())) {
     std::string var_name = left->decl_->GetName();
     ptr = var_env_[var_name];
     if (ptr == nullptr) {
@@ -246,30 +300,27 @@ auto InterpreterIRVisitor::Codegen(const BinaryOperator &expr)
   llvm::Value *r;
 
   if (expr.op_.type_ == EQUAL) {
-    if (auto *left = dynamic_cast<DeclRefExpr *>(expr.left_.get())) {
+    if (auto *left = llvm::dyn_cast<DeclRefExpr>(expr.left_.get())) {
       std::string var_name = left->decl_->GetName();
       l = var_env_[var_name];
       if (l == nullptr) {
         l = GetGlobalVar(var_name);
       }
     }
-    r = expr.right_->Accept(*this);
+    r = Visit(*expr.right_);
     return builder_->CreateStore(r, l);
   }
 
-  l = expr.left_->Accept(*this);
-  r = expr.right_->Accept(*this);
-  if (l == nullptr || r == nullptr) {
-    throw CodeGenException("[BinaryOperator] operands must be not null");
-  }
-
   /// logical operation (no matter types)
   TokenTy op_ty = expr.op_.type_;
-  if (op_ty == AND_OP) {
-    return builder_->CreateAnd(l, r);
+  if (op_ty == AND_OP || op_ty == OR_OP) {
+    return CodegenLogical(expr);
   }
-  if (op_ty == OR_OP) {
-    return builder_->CreateOr(l, r);
+
+  l = Visit(*expr.left_);
+  r = Visit(*expr.right_);
+  if (l == nullptr || r == nullptr) {
+    throw CodeGenException("[BinaryOperator] operands must be not null");
   }
 
   if (expr.type_ == "i64") {
@@ -342,10 +393,10 @@ auto InterpreterIRVisitor::Codegen(const VarDecl &decl) -> llvm::Value * {
   llvm::Type *var_ty =
       (decl.type_ == "i64" ? builder_->getInt64Ty() : builder_->getDoubleTy());
   llvm::Constant *initializer =
-      // (decl.init_ != nullptr ? (llvm::Constant *)decl.init_->Accept(*this)
+      // (decl.init_ != nullptr ? (llvm::Constant *)decl.Codegen(*init_)
       //                        : nullptr);
       (decl.init_ != nullptr
-           ? reinterpret_cast<llvm::Constant *>(decl.init_->Accept(*this))
+           ? reinterpret_cast<llvm::Constant *>(Visit(*decl.init_))
            : nullptr);
 
   if (decl.scope_ == GLOBAL) {
@@ -357,7 +408,7 @@ auto InterpreterIRVisitor::Codegen(const VarDecl &decl) -> llvm::Value * {
     return var;
   }
 
-  llvm::AllocaInst *ptr = builder_->CreateAlloca(var_ty, nullptr);
+  llvm::AllocaInst *ptr = CreateEntryAlloca(var_ty);
   if (decl.init_ != nullptr) {
     builder_->CreateStore(initializer, ptr);
   }
@@ -370,7 +421,7 @@ auto InterpreterIRVisitor::Codegen(const VarDecl &decl) -> llvm::Value * {
  */
 
 void InterpreterIRVisitor::HandleDeclaration(std::unique_ptr<Decl> &decl) {
-  if (auto *var_decl = dynamic_cast<VarDecl *>(decl.get())) {
+  if (auto *var_decl = llvm::dyn_cast<VarDecl>(decl.get())) {
     /// for variable declaration, all see as global variable
     llvm::Type *var_ty =
         (var_decl->GetType() == "i64" ? builder_->getInt64Ty()
@@ -383,22 +434,36 @@ void InterpreterIRVisitor::HandleDeclaration(std::unique_ptr<Decl> &decl) {
     }
     llvm::Constant *initializer =
         // (var_decl->init_ != nullptr && var_decl->init_->IsConstant()
-        //      ? (llvm::Constant *)var_decl->init_->Accept(*this)
+        //      ? (llvm::Constant *)var_decl->Codegen(*init_)
         //      : (llvm::Constant *)zero_val);
         (var_decl->init_ != nullptr && var_decl->init_->IsConstant()
-             ? reinterpret_cast<llvm::Constant *>(
-                   var_decl->init_->Accept(*this))
+             ? reinterpret_cast<llvm::Constant *>(Visit(*var_decl->init_))
              : reinterpret_cast<llvm::Constant *>(zero_val));
 
+    /// comparisons are `i1`, widen them to the type of the variable
+    initializer =
+        llvm::cast<llvm::Constant>(CodegenNumber(initializer, var_ty));
+    /// a `const` variable initialized at run time is written once
+    bool is_constant = var_decl->IsConst() && (var_decl->init_ == nullptr ||
+                                               var_decl->init_->IsConstant());
+
     /// variable definition
-    auto *var = new llvm::GlobalVariable(*module_, var_ty, false,
+    auto *var = new llvm::GlobalVariable(*module_, var_ty, is_constant,
                                          llvm::GlobalVariable::ExternalLinkage,
                                          initializer, var_decl->GetName());
-    global_var_env_[var_decl->GetName()] = std::make_unique<GlobalVar>(
-        var_decl->GetName(), var_decl->GetType(), 0);
+    auto global_var = std::make_unique<GlobalVar>(var_decl->GetName(),
+                                                  var_decl->GetType(), 0);
+    if (is_constant) {
+      if (const auto *i = llvm::dyn_cast<llvm::ConstantInt>(initializer)) {
+        global_var->value_ = i->getSExtValue();
+      } else if (const auto *f =
+                     llvm::dyn_cast<llvm::ConstantFP>(initializer)) {
+        global_var->value_ = f->getValueAPF().convertToDouble();
+      }
+    }
+    global_var_env_[var_decl->GetName()] = std::move(global_var);
 
-    exit_on_err_(jit_->AddModule(
-        llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_))));
+    exit_on_err_(jit_->AddModule(TakeModule()));
     Initialize();
     ResetReferGlobalVar();
 
@@ -415,12 +480,10 @@ void InterpreterIRVisitor::HandleDeclaration(std::unique_ptr<Decl> &decl) {
           std::vector<std::unique_ptr<ParmVarDecl>>{}, 0);
       auto func_decl =
           std::make_unique<FunctionDecl>(std::move(proto), std::move(stmt));
-      func_decl->Accept(*this);
+      Codegen(*func_decl);
 
       auto res_tracker = jit_->GetMainJITDylib().createResourceTracker();
-      auto tsm =
-          llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_));
-      exit_on_err_(jit_->AddModule(std::move(tsm), res_tracker));
+      exit_on_err_(jit_->AddModule(TakeModule(), res_tracker));
       Initialize();
       ResetReferGlobalVar();
 
@@ -435,14 +498,13 @@ void InterpreterIRVisitor::HandleDeclaration(std::unique_ptr<Decl> &decl) {
       }
       exit_on_err_(res_tracker->remove());
     }
-  } else if (auto *func_decl = dynamic_cast<FunctionDecl *>(decl.get())) {
+  } else if (auto *func_decl = llvm::dyn_cast<FunctionDecl>(decl.get())) {
     /// for function definition
     if (func_decl->GetKind() != DECLARATION) {
-      func_decl->Accept(*this);
+      Codegen(*func_decl);
       function_env_[func_decl->GetName()] = std::move(func_decl->proto_);
       if (func_decl->GetKind() == DEFINITION) {
-        exit_on_err_(jit_->AddModule(llvm::orc::ThreadSafeModule(
-            std::move(module_), std::move(context_))));
+        exit_on_err_(jit_->AddModule(TakeModule()));
         Initialize();
         ResetReferGlobalVar();
         ResetReferFunctionProto();
@@ -459,11 +521,9 @@ void InterpreterIRVisitor::HandleStatement(std::unique_ptr<Stmt> &stmt) {
       0);
   auto func_decl =
       std::make_unique<FunctionDecl>(std::move(proto), std::move(stmt));
-  if (func_decl->Accept(*this) != nullptr) {
+  if (Codegen(*func_decl) != nullptr) {
     auto res_tracker = jit_->GetMainJITDylib().createResourceTracker();
-    auto tsm =
-        llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_));
-    exit_on_err_(jit_->AddModule(std::move(tsm), res_tracker));
+    exit_on_err_(jit_->AddModule(TakeModule(), res_tracker));
     Initialize();
     ResetReferGlobalVar();
     // resetReferFunctionProto();
@@ -492,11 +552,9 @@ void InterpreterIRVisitor::HandleExpression(std::unique_ptr<Expr> &expr) {
   auto func_decl =
       std::make_unique<FunctionDecl>(std::move(proto), std::move(stmt));
 
-  if (func_decl->Accept(*this) != nullptr) {
+  if (Codegen(*func_decl) != nullptr) {
     auto res_tracker = jit_->GetMainJITDylib().createResourceTracker();
-    auto tsm =
-        llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_));
-    exit_on_err_(jit_->AddModule(std::move(tsm), res_tracker));
+    exit_on_err_(jit_->AddModule(TakeModule(), res_tracker));
     Initialize();
     ResetReferGlobalVar();
     ResetReferFunctionProto();
@@ -0,0 +1,196 @@
+//! compile cache implementation
+
+#include <Compiler/CompileCache.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA256.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace toyc {
+
+CompileCache::CompileCache(std::string _dir, uint64_t _max_size)
+    : dir_(std::move(_dir)), max_size_(_max_size) {
+  llvm::sys::fs::create_directories(dir_);
+}
+
+auto CompileCache::GetEntryPath(llvm::StringRef key) -> std::string {
+  llvm::SmallString<128> path(dir_);
+  llvm::sys::path::append(path, key.take_front(2), key);
+  return path.str().str();
+}
+
+auto CompileCache::GetStatsPath() -> std::string {
+  llvm::SmallString<128> path(dir_);
+  llvm::sys::path::append(path, "stats");
+  return path.str().str();
+}
+
+auto CompileCache::HashKey(llvm::ArrayRef<std::string> parts) -> std::string {
+  llvm::SHA256 hash;
+  for (const auto &part : parts) {
+    hash.update(std::to_string(part.size()) + ":");
+    hash.update(part);
+  }
+  return llvm::toHex(hash.final(), true);
+}
+
+void CompileCache::UpdateStats(llvm::function_ref<void(CacheStats &)> update) {
+  int fd = -1;
+  if (llvm::sys::fs::openFileForReadWrite(GetStatsPath(), fd,
+                                          llvm::sys::fs::CD_OpenAlways,
+                                          llvm::sys::fs::OF_None)) {
+    return;
+  }
+  if (llvm::sys::fs::lockFile(fd)) {
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    return;
+  }
+  CacheStats stats;
+  llvm::SmallString<128> content;
+  if (!llvm::errorToBool(llvm::sys::fs::readNativeFileToEOF(
+          llvm::sys::fs::convertFDToNativeFile(fd), content))) {
+    std::istringstream is(content.str().str());
+    std::string name;
+    uint64_t value = 0;
+    while (is >> name >> value) {
+      if (name == "hits") {
+        stats.hits_ = value;
+      } else if (name == "misses") {
+        stats.misses_ = value;
+      } else if (name == "size") {
+        stats.size_ = value;
+      }
+    }
+  }
+  update(stats);
+  {
+    llvm::raw_fd_ostream os(fd, false);
+    os.seek(0);
+    os << "hits " << stats.hits_ << "\nmisses " << stats.misses_ << "\nsize "
+       << stats.size_ << "\n";
+    os.flush();
+    /// the counters only grow in length, but the size may shrink
+    llvm::sys::fs::resize_file(fd, os.tell());
+  }
+  llvm::sys::fs::unlockFile(fd);
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+auto CompileCache::Evict(uint64_t target) -> uint64_t {
+  /// <last use, size, path> of every entry
+  std::vector<std::tuple<llvm::sys::TimePoint<>, uint64_t, std::string>>
+      entries;
+  uint64_t total = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::recursive_directory_iterator it(dir_, ec), end;
+       it != end && !ec; it.increment(ec)) {
+    llvm::StringRef name = llvm::sys::path::filename(it->path());
+    /// entries being written by other compilers are not counted yet
+    if (it->type() != llvm::sys::fs::file_type::regular_file ||
+        name == "stats" || name.startswith("tmp-")) {
+      continue;
+    }
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(it->path(), status)) {
+      continue;
+    }
+    entries.emplace_back(status.getLastModificationTime(), status.getSize(),
+                         it->path());
+    total += status.getSize();
+  }
+  std::sort(entries.begin(), entries.end());
+  for (const auto &[time, size, path] : entries) {
+    if (total <= target) {
+      break;
+    }
+    if (!llvm::sys::fs::remove(path)) {
+      total -= size;
+    }
+  }
+  return total;
+}
+
+auto CompileCache::Fetch(llvm::StringRef key, llvm::raw_ostream &os) -> bool {
+  std::string path = GetEntryPath(key);
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    UpdateStats([](CacheStats &stats) { stats.misses_++; });
+    return false;
+  }
+  os << (*buffer)->getBuffer();
+  /// a hit makes the entry the most recently used
+  int fd = -1;
+  if (!llvm::sys::fs::openFileForWrite(path, fd,
+                                       llvm::sys::fs::CD_OpenExisting,
+                                       llvm::sys::fs::OF_Append)) {
+    llvm::sys::fs::setLastAccessAndModificationTime(
+        fd, std::chrono::system_clock::now());
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+  UpdateStats([](CacheStats &stats) { stats.hits_++; });
+  return true;
+}
+
+void CompileCache::Store(llvm::StringRef key, llvm::StringRef content) {
+  llvm::SmallString<128> model(dir_);
+  llvm::sys::path::append(model, key.take_front(2));
+  if (llvm::sys::fs::create_directories(model)) {
+    return;
+  }
+  llvm::sys::path::append(model, "tmp-%%%%%%%%");
+  int fd = -1;
+  llvm::SmallString<128> tmp;
+  if (llvm::sys::fs::createUniqueFile(model, fd, tmp)) {
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, true);
+    os << content;
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmp);
+      return;
+    }
+  }
+  /// an entry stored meanwhile by another compiler is replaced, its bytes
+  /// are counted already
+  std::string entry = GetEntryPath(key);
+  uint64_t replaced = 0;
+  llvm::sys::fs::file_status status;
+  if (!llvm::sys::fs::status(entry, status)) {
+    replaced = status.getSize();
+  }
+  if (llvm::sys::fs::rename(tmp, entry)) {
+    llvm::sys::fs::remove(tmp);
+    return;
+  }
+  UpdateStats([&](CacheStats &stats) {
+    stats.size_ += content.size();
+    stats.size_ -= std::min(stats.size_, replaced);
+    /// evict a tenth more than needed, so the next stores do not scan again
+    if (stats.size_ > max_size_) {
+      stats.size_ = Evict(max_size_ / 10 * 9);
+    }
+  });
+}
+
+auto CompileCache::GetStats() -> CacheStats {
+  CacheStats stats;
+  UpdateStats([&](CacheStats &current) { stats = current; });
+  return stats;
+}
+
+} // namespace toyc
@@ -1,9 +1,23 @@
 //! compiler class implementation
 
+#include <AST/ASTPrint.h>
+#include <AST/FlatAST.h>
 #include <Compiler/Compiler.h>
 #include <Preprocessor/Preprocessor.h>
+#include <Sema/Canonicalizer.h>
+#include <Sema/ConstantFolder.h>
+#include <Sema/DeadCodeEliminator.h>
+#include <Sema/FunctionAttrInference.h>
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/PassTimingInfo.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/Timer.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include <cstdlib>
@@ -11,11 +25,136 @@
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <sstream>
+#include <system_error>
+#include <vector>
 
 namespace toyc {
 
-void Compiler::Compile(std::string &src, llvm::raw_ostream &os) {
+namespace {
+
+/// -ftime-report groups: the phases of `Compile`, and the AST passes of the
+/// sema phase
+constexpr const char *PHASE_GROUP = "toycc";
+constexpr const char *PHASE_GROUP_DESC = "Compile phase timing report";
+constexpr const char *SEMA_GROUP = "sema";
+constexpr const char *SEMA_GROUP_DESC = "AST pass timing report";
+
+/// changes whenever the key or the entries of the cache change meaning
+constexpr const char *CACHE_FORMAT = "toycc-cache-1";
+
+/// size and modification time of a file, or nothing if it is missing
+auto GetFileStamp(const std::string &path) -> std::string {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status)) {
+    return path;
+  }
+  return makeString("{} {} {}", path, status.getSize(),
+                    status.getLastModificationTime().time_since_epoch().count());
+}
+
+} // namespace
+
+void Compiler::SetTimeReport(bool _print, const std::string &_json) {
+  time_report_ = _print || !_json.empty();
+  print_time_report_ = _print;
+  time_report_json_ = _json;
+}
+
+void Compiler::ReportTimes() {
+  if (!time_report_json_.empty()) {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(time_report_json_, ec);
+    if (ec) {
+      std::cerr << makeString("failed to open file '{}'\n", time_report_json_);
+    } else {
+      os << "{\n";
+      llvm::TimerGroup::printAllJSONValues(os, "");
+      os << "\n}\n";
+    }
+  }
+  if (print_time_report_) {
+    llvm::TimerGroup::printAll(llvm::errs());
+  }
+  /// the codegen passes of the legacy pass manager keep their own timers
+  if (print_time_report_ && llvm::TimePassesIsEnabled) {
+    llvm::reportAndResetTimings(&llvm::errs());
+  }
+}
+
+auto Compiler::GetCacheKey(const std::string &src, const std::string &input)
+    -> std::string {
+  /// the source path names the module and its debug info
+  std::vector<std::string> parts{CACHE_FORMAT, src, input};
+  /// files of precompiled includes are not part of the input
+  for (const auto &path : preprocessor_.GetIncludes()) {
+    std::string content;
+    ReadFrom(path, content);
+    parts.push_back(path);
+    parts.push_back(std::move(content));
+  }
+  /// a rebuilt compiler or runtime is a new version
+  std::string exe = llvm::sys::fs::getMainExecutable(nullptr, nullptr);
+  llvm::SmallString<128> runtime(
+      llvm::sys::path::parent_path(llvm::sys::path::parent_path(exe)));
+  llvm::sys::path::append(runtime, "lib", "libtoyc.bc");
+  parts.push_back(GetFileStamp(exe));
+  parts.push_back(GetFileStamp(runtime.str().str()));
+
+  auto [cpu, features] = BaseIRVisitor::ResolveTargetCPU(target_cpu_);
+  parts.push_back(makeString(
+      "O{}{} kind={} ast-dump={} link-runtime={} direct-ssa={} builtins={} "
+      "g={} j={} cpu={} features={}",
+      opt_level_.getSpeedupLevel(), opt_level_.getSizeLevel(),
+      static_cast<int>(output_kind_),
+      ast_dump_.has_value() ? static_cast<int>(*ast_dump_) : -1, link_runtime_,
+      direct_ssa_, builtins_, debug_info_, jobs_, cpu, features));
+  parts.push_back(profile_generate_.has_value()
+                      ? "profile-generate=" + *profile_generate_
+                      : "");
+  /// outputs optimized with a profile change with the profile
+  std::string profile;
+  if (profile_use_.has_value()) {
+    ReadFrom(*profile_use_, profile);
+  }
+  parts.push_back(std::move(profile));
+  return CompileCache::HashKey(parts);
+}
+
+auto Compiler::LoadInclude(const std::string &path) -> FlatAST {
+  /// the cache is valid as long as it is not older than the file
+  std::string cache = path + ".ast";
+  llvm::sys::fs::file_status src_status;
+  llvm::sys::fs::file_status cache_status;
+  if (!llvm::sys::fs::status(path, src_status) &&
+      !llvm::sys::fs::status(cache, cache_status) &&
+      cache_status.getLastModificationTime() >=
+          src_status.getLastModificationTime()) {
+    if (auto ast = FlatAST::Load(cache)) {
+      return std::move(*ast);
+    }
+  }
+
+  /// files included by the file itself are inserted as text
+  std::string input;
+  if (!ReadFrom(path, input)) {
+    std::cerr << makeString("failed to open file '{}'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  Preprocessor preprocessor;
+  preprocessor.SetInput(input);
+  input = preprocessor.Process();
+  Parser parser;
+  parser.AddInput(input);
+  FlatAST ast = FlatAST::Flatten(*parser.Parse());
+  /// the include directory may be read-only, the AST is usable anyway
+  ast.Save(cache);
+  return ast;
+}
+
+void Compiler::Compile(std::string &src, llvm::raw_pwrite_stream &os) {
+  /// the shards would time their passes on several threads at once
+  llvm::TimePassesIsEnabled = time_report_ && jobs_ == 1;
+
   /// read from src file
   std::string input;
   if (!ReadFrom(src, input)) {
@@ -25,27 +164,138 @@ void Compiler::Compile(std::string &src, llvm::raw_ostream &os) {
 
   /// preprocessor
   preprocessor_.SetInput(input);
+  preprocessor_.SetPrecompiledIncludes(precompiled_includes_);
   try {
+    llvm::NamedRegionTimer timer("preprocess", "Preprocess", PHASE_GROUP,
+                                 PHASE_GROUP_DESC, time_report_);
     input = preprocessor_.Process();
   } catch (PreprocessorException e) {
     std::cerr << e.what() << "\n";
     exit(EXIT_FAILURE);
   }
 
+  if (cache_ == nullptr) {
+    CompilePreprocessed(src, input, os);
+    return;
+  }
+  /// parsing, code generation and optimization are skipped on a hit
+  std::string key = GetCacheKey(src, input);
+  if (cache_->Fetch(key, os)) {
+    return;
+  }
+  llvm::SmallString<0> output;
+  llvm::raw_svector_ostream ros(output);
+  CompilePreprocessed(src, input, ros);
+  cache_->Store(key, output);
+  os << output;
+}
+
+void Compiler::CompilePreprocessed(std::string &src, std::string &input,
+                                   llvm::raw_pwrite_stream &os) {
   /// parse
   parser_.AddInput(input);
   try {
-    auto translation_unit = parser_.Parse();
+    std::unique_ptr<TranslationUnitDecl> translation_unit;
+    {
+      /// the parser lexes on demand, so the two are timed together
+      llvm::NamedRegionTimer timer("lex-parse", "Lex and parse", PHASE_GROUP,
+                                   PHASE_GROUP_DESC, time_report_);
+      /// declarations of precompiled includes go first, as if inserted as
+      /// text
+      std::vector<DeclPtr> included;
+      for (const auto &path : preprocessor_.GetIncludes()) {
+        FlatAST ast = LoadInclude(path);
+        for (NodeId id : ast.GetDecls()) {
+          included.push_back(ast.ExpandDecl(id));
+          parser_.AddDeclaration(*included.back());
+        }
+      }
+      translation_unit = parser_.Parse();
+      if (translation_unit != nullptr) {
+        translation_unit->decls_.insert(
+            translation_unit->decls_.begin(),
+            std::make_move_iterator(included.begin()),
+            std::make_move_iterator(included.end()));
+      }
+    }
     if (translation_unit != nullptr) {
+      FunctionAttrInference attr_inference;
+      {
+        llvm::NamedRegionTimer sema_timer("sema", "Sema (AST passes)",
+                                          PHASE_GROUP, PHASE_GROUP_DESC,
+                                          time_report_);
+        /// canonicalize first, so later passes see fewer node shapes
+        Canonicalizer canonicalizer;
+        {
+          llvm::NamedRegionTimer timer("canonicalize", "Canonicalize",
+                                       SEMA_GROUP, SEMA_GROUP_DESC,
+                                       time_report_);
+          canonicalizer.Run(*translation_unit);
+        }
+        /// fold constant subtrees, `toycc` runs no IR optimization
+        ConstantFolder folder;
+        {
+          llvm::NamedRegionTimer timer("fold", "Fold constants", SEMA_GROUP,
+                                       SEMA_GROUP_DESC, time_report_);
+          folder.Run(*translation_unit);
+        }
+        /// prune code which never runs, using the folded conditions
+        DeadCodeEliminator eliminator;
+        {
+          llvm::NamedRegionTimer timer("dce", "Eliminate dead code",
+                                       SEMA_GROUP, SEMA_GROUP_DESC,
+                                       time_report_);
+          eliminator.Run(*translation_unit);
+        }
+        /// infer function attributes from the call graph
+        {
+          llvm::NamedRegionTimer timer("attrs", "Infer function attributes",
+                                       SEMA_GROUP, SEMA_GROUP_DESC,
+                                       time_report_);
+          attr_inference.Run(*translation_unit);
+        }
+        /// what the AST passes did, next to the time they took
+        if (print_time_report_) {
+          std::cerr << makeString(
+              "sema: canonicalizer removed {} nodes, folder folded {} nodes, "
+              "eliminator removed {} statements\n",
+              canonicalizer.GetRemoved(), folder.GetFolded(),
+              eliminator.GetRemoved());
+        }
+      }
 #ifndef NDEBUG
-      std::stringstream ss;
-      translation_unit->Dump(ss);
-      std::cerr << ss.str();
+      translation_unit->Dump(std::cerr);
 #endif
+      if (ast_dump_.has_value()) {
+        ASTDumper(os, *ast_dump_).Dump(*translation_unit);
+        return;
+      }
+      if (jobs_ > 1) {
+        llvm::NamedRegionTimer timer("shards", "Lower shards (codegen, opt, "
+                                     "emit and merge)",
+                                     PHASE_GROUP, PHASE_GROUP_DESC,
+                                     time_report_);
+        /// the shards share the flat encoding of the unit, read only, and
+        /// expand the declarations they lower
+        FlatAST flat_ast = FlatAST::Flatten(*translation_unit);
+        translation_unit.reset();
+        CompileShards(flat_ast, attr_inference.GetAttrs(), src, os);
+        return;
+      }
       /// generate IR code
+      llvm::NamedRegionTimer timer("codegen", "Codegen", PHASE_GROUP,
+                                   PHASE_GROUP_DESC, time_report_);
+      visitor_.SetFunctionAttrs(attr_inference.GetAttrs());
+      visitor_.SetDirectSSA(direct_ssa_);
+      visitor_.SetBuiltins(builtins_);
+      visitor_.SetDebugInfo(debug_info_);
+      visitor_.SetTargetCPU(target_cpu_);
       visitor_.SetModuleID(src);
       visitor_.Codegen(*translation_unit);
     }
+  } catch (PreprocessorException e0) {
+    std::cerr << e0.what() << "\n";
+    exit(EXIT_FAILURE);
   } catch (LexerException e1) {
     std::cerr << e1.what() << "\n";
     exit(EXIT_FAILURE);
@@ -66,11 +316,185 @@ void Compiler::Compile(std::string &src, llvm::raw_ostream &os) {
   visitor_.Dump();
 #endif
 
-  if (!visitor_.VerifyModule()) {
-    std::cerr << "there is something wrong in compiler inner\n";
+  {
+    llvm::NamedRegionTimer timer("verify", "Verify", PHASE_GROUP,
+                                 PHASE_GROUP_DESC, time_report_);
+    if (!visitor_.VerifyModule()) {
+      std::cerr << "there is something wrong in compiler inner\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+  try {
+    {
+      llvm::NamedRegionTimer timer("opt", "Optimize", PHASE_GROUP,
+                                   PHASE_GROUP_DESC, time_report_);
+      Lower(visitor_);
+    }
+    llvm::NamedRegionTimer timer("emit", "Emit", PHASE_GROUP,
+                                 PHASE_GROUP_DESC, time_report_);
+    if (output_kind_ == OBJECT_FILE) {
+      visitor_.EmitObject(os);
+    } else {
+      visitor_.Dump(os);
+    }
+  } catch (CodeGenException e) {
+    std::cerr << e.what() << "\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+void Compiler::Lower(CompilerIRVisitor &visitor) {
+  if (profile_generate_.has_value()) {
+    visitor.SetProfileGenerate(*profile_generate_);
+  } else if (profile_use_.has_value()) {
+    visitor.SetProfileUse(*profile_use_);
+  }
+  /// the runtime is only worth linking in when the inliner runs, which in
+  /// turn needs the target to weigh the cost of calls
+  bool optimize = opt_level_ != llvm::OptimizationLevel::O0;
+  if (output_kind_ == OBJECT_FILE || optimize) {
+    visitor.InitializeTarget();
+  }
+  if (optimize && link_runtime_ && visitor.LoadRuntime()) {
+    visitor.LinkRuntime();
+  }
+  visitor.Optimize(opt_level_);
+}
+
+void Compiler::CompileShards(const FlatAST &ast,
+                             const std::map<std::string, FunctionAttrs> &attrs,
+                             std::string &src, llvm::raw_pwrite_stream &os) {
+  /// shard 0 is lowered by `visitor_`, whose context the IR is linked into
+  std::vector<std::unique_ptr<CompilerIRVisitor>> others;
+  std::vector<CompilerIRVisitor *> shards{&visitor_};
+  for (size_t i = 1; i < jobs_; i++) {
+    others.push_back(std::make_unique<CompilerIRVisitor>());
+    shards.push_back(others.back().get());
+  }
+  /// objects, or bitcode of the shards to link into shard 0
+  std::vector<llvm::SmallString<0>> outputs(jobs_);
+  std::vector<std::string> errors(jobs_);
+
+  llvm::ThreadPool pool(llvm::hardware_concurrency(jobs_));
+  for (size_t i = 0; i < jobs_; i++) {
+    pool.async([&, i] {
+      CompilerIRVisitor &visitor = *shards[i];
+      llvm::raw_svector_ostream ros(outputs[i]);
+      /// exceptions do not cross threads, report them once all are done
+      try {
+        visitor.SetFunctionAttrs(attrs);
+        visitor.SetDirectSSA(direct_ssa_);
+        visitor.SetBuiltins(builtins_);
+        visitor.SetDebugInfo(debug_info_);
+        visitor.SetTargetCPU(target_cpu_);
+        visitor.SetModuleID(src);
+        visitor.SetShard(i, jobs_);
+        visitor.Codegen(ast);
+        Lower(visitor);
+        if (output_kind_ == OBJECT_FILE) {
+          visitor.EmitObject(ros);
+        } else if (i != 0) {
+          visitor.WriteBitcode(ros);
+        }
+      } catch (CodeGenException e) {
+        errors[i] = e.what();
+      }
+    });
+  }
+  pool.wait();
+  for (const auto &error : errors) {
+    if (!error.empty()) {
+      std::cerr << error << "\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (output_kind_ == IR_FILE) {
+    try {
+      for (size_t i = 1; i < jobs_; i++) {
+        visitor_.LinkBitcode(llvm::MemoryBufferRef(outputs[i], src));
+      }
+      visitor_.InternalizeShards();
+    } catch (CodeGenException e) {
+      std::cerr << e.what() << "\n";
+      exit(EXIT_FAILURE);
+    }
+    visitor_.Dump(os);
+    return;
+  }
+
+  /// one relocatable object out of the objects of the shards
+  std::vector<std::string> objects;
+  bool failed = false;
+  for (const auto &output : outputs) {
+    llvm::SmallString<128> object;
+    if (llvm::sys::fs::createTemporaryFile("toycc", "o", object)) {
+      failed = true;
+      break;
+    }
+    objects.push_back(object.str().str());
+    std::error_code ec;
+    llvm::raw_fd_ostream file(objects.back(), ec);
+    if (ec) {
+      failed = true;
+      break;
+    }
+    file << output;
+  }
+  llvm::SmallString<128> merged;
+  if (!failed && !llvm::sys::fs::createTemporaryFile("toycc", "o", merged)) {
+    std::vector<std::string> args{"-nostdlib", "-r", "-o", merged.str().str()};
+    args.insert(args.end(), objects.begin(), objects.end());
+    std::string content;
+    failed = !RunDriver(args, merged.str().str()) ||
+             !ReadFrom(merged.str().str(), content);
+    if (!failed) {
+      os << content;
+    }
+    llvm::sys::fs::remove(merged);
+  } else {
+    failed = true;
+  }
+  for (const auto &object : objects) {
+    llvm::sys::fs::remove(object);
+  }
+  if (failed) {
+    std::cerr << makeString("failed to merge the objects of the shards\n");
     exit(EXIT_FAILURE);
   }
-  visitor_.Dump(os);
+}
+
+auto Compiler::RunDriver(const std::vector<std::string> &args,
+                         const std::string &output, const std::string &driver)
+    -> bool {
+  auto path = llvm::sys::findProgramByName(driver);
+  if (!path) {
+    std::cerr << makeString("failed to find the compiler driver '{}'\n",
+                            driver);
+    return false;
+  }
+  std::vector<llvm::StringRef> argv{*path};
+  argv.insert(argv.end(), args.begin(), args.end());
+  std::string error;
+  if (llvm::sys::ExecuteAndWait(*path, argv, {}, {}, 0, 0, &error) != 0) {
+    std::cerr << makeString("failed to link '{}'{}\n", output,
+                            error.empty() ? "" : ": " + error);
+    return false;
+  }
+  return true;
+}
+
+auto Compiler::Link(const std::string &object, const std::string &exe,
+                    bool profile) -> bool {
+  /// the runtime linked in as bitcode calls into libm and libstdc++ itself
+  std::vector<std::string> args{object, "-o", exe, "-ltoyc", "-lm", "-lstdc++"};
+  if (!profile) {
+    return RunDriver(args, exe);
+  }
+  /// the counters are written by the profile runtime of compiler-rt, of the
+  /// clang CMake found next to LLVM
+  args.push_back("-fprofile-generate");
+  return RunDriver(args, exe, TOYC_CLANG);
 }
 
 } // namespace toyc
@@ -1,30 +1,281 @@
 //! compiler for toyc
 
+#include <CodeGen/CodeGen.h>
 #include <Compiler/Compiler.h>
 #include <Config.h>
 
-auto main(int argc, const char **argv) -> int {
-  if (argc < 2) {
-    std::cerr << makeString("Usage: {} <src> <bytcode>\n", argv[0]);
-    exit(EXIT_FAILURE);
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+
+static llvm::cl::OptionCategory toycc_category("toycc options");
+
+static llvm::cl::opt<std::string> input_file(llvm::cl::Positional,
+                                             llvm::cl::Required,
+                                             llvm::cl::desc("<src>"),
+                                             llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> output_file(llvm::cl::Positional,
+                                              llvm::cl::init("a.ll"),
+                                              llvm::cl::desc("<bytecode>"),
+                                              llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool>
+    compile_only("c", llvm::cl::desc("Emit a native object file, do not link"),
+                 llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> output_path(
+    "o",
+    llvm::cl::desc("Write the object file (with -c) or the executable "
+                   "linked against libtoyc to <file>"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> precompiled_includes(
+    "precompiled-includes",
+    llvm::cl::desc("Load `#include` files from binary ASTs cached next to "
+                   "them, building the caches on first use"),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<toyc::DumpFormat> ast_dump(
+    "ast-dump", llvm::cl::desc("Write the AST instead of the IR"),
+    llvm::cl::values(clEnumValN(toyc::TEXT_DUMP, "text", "indented tree"),
+                     clEnumValN(toyc::JSON_DUMP, "json", "JSON objects"),
+                     clEnumValN(toyc::BINARY_DUMP, "binary",
+                                "compact binary encoding")),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<char>
+    opt_level("O",
+              llvm::cl::desc("Optimization level: -O0, -O1, -O2, -O3, -Os or "
+                             "-Oz (default -O0)"),
+              llvm::cl::Prefix, llvm::cl::init('0'),
+              llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> link_runtime(
+    "link-runtime",
+    llvm::cl::desc("Link the bitcode of libtoyc into the module when "
+                   "optimizing, so runtime calls can be inlined (default on)"),
+    llvm::cl::init(true), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> direct_ssa(
+    "direct-ssa",
+    llvm::cl::desc("Keep local variables in SSA registers and phis instead of "
+                   "stack slots, even without optimization"),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> no_builtin(
+    "fno-builtin",
+    llvm::cl::desc("Call the math functions of libtoyc instead of lowering "
+                   "them to LLVM intrinsics"),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> debug_info(
+    "g",
+    llvm::cl::desc("Emit DWARF debug info (line tables, functions and local "
+                   "variables) for debuggers and profilers"),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<unsigned>
+    jobs("j",
+         llvm::cl::desc("Lower and optimize the functions in <n> shards on "
+                        "parallel threads (default 1)"),
+         llvm::cl::value_desc("n"), llvm::cl::Prefix, llvm::cl::init(1),
+         llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> march(
+    "march",
+    llvm::cl::desc("Generate code for <cpu> (`skylake`, `znver3`...), "
+                   "`native` for the CPU of the host and its features"),
+    llvm::cl::value_desc("cpu"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string>
+    mcpu("mcpu", llvm::cl::desc("Same as -march, and takes precedence over it"),
+         llvm::cl::value_desc("cpu"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> profile_generate(
+    "fprofile-generate",
+    llvm::cl::desc("Instrument the program to write a profile of its run "
+                   "into <dir> (default the working directory)"),
+    llvm::cl::value_desc("dir"), llvm::cl::ValueOptional,
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> profile_use(
+    "fprofile-use",
+    llvm::cl::desc("Optimize with the profile <file>, merged from the raw "
+                   "profiles by `llvm-profdata merge`"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool> time_report(
+    "ftime-report",
+    llvm::cl::desc("Print the time of each compile phase and LLVM pass"),
+    llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> time_report_json(
+    "ftime-report-json",
+    llvm::cl::desc("Write the time of each compile phase as JSON to <file>"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<std::string> cache_dir(
+    "cache-dir",
+    llvm::cl::desc("Reuse the outputs of earlier compiles cached in <dir>, "
+                   "and cache new ones there (default $TOYCC_CACHE_DIR, "
+                   "no cache if unset)"),
+    llvm::cl::value_desc("dir"), llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<uint64_t>
+    cache_size("cache-size",
+               llvm::cl::desc("Evict the least recently used outputs beyond "
+                              "<n> MiB (default 1024)"),
+               llvm::cl::value_desc("n"), llvm::cl::init(1024),
+               llvm::cl::cat(toycc_category));
+
+static llvm::cl::opt<bool>
+    cache_stats("cache-stats",
+                llvm::cl::desc("Print the hits, misses and size of the cache"),
+                llvm::cl::cat(toycc_category));
+
+/// write `content` into file `dest` as is
+static auto WriteFile(const std::string &dest, llvm::StringRef content)
+    -> bool {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(dest, ec);
+  if (ec) {
+    return false;
   }
+  os << content;
+  return true;
+}
+
+auto main(int argc, const char **argv) -> int {
+  /// LLVM registers options of its own, show only ours
+  llvm::cl::HideUnrelatedOptions(toycc_category);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "toyc compiler\n");
 
   toyc::Compiler compiler;
+  compiler.SetPrecompiledIncludes(precompiled_includes);
+  compiler.SetLinkRuntime(link_runtime);
+  compiler.SetDirectSSA(direct_ssa);
+  compiler.SetBuiltins(!no_builtin);
+  compiler.SetDebugInfo(debug_info);
+  compiler.SetJobs(jobs);
+  compiler.SetTimeReport(time_report, time_report_json);
+  std::string cache = cache_dir;
+  if (cache.empty()) {
+    if (const char *env = std::getenv("TOYCC_CACHE_DIR")) {
+      cache = env;
+    }
+  }
+  if (!cache.empty()) {
+    compiler.SetCache(cache, cache_size * 1024 * 1024);
+  }
+  const std::string &cpu =
+      toyc::BaseIRVisitor::SelectTargetCPU(march.getValue(), mcpu.getValue());
+  if (!cpu.empty() && !toyc::BaseIRVisitor::IsTargetCPUValid(cpu)) {
+    std::cerr << makeString("unknown target CPU '{}'\n", cpu);
+    exit(EXIT_FAILURE);
+  }
+  compiler.SetTargetCPU(cpu);
+  switch (opt_level) {
+  case '0':
+    compiler.SetOptLevel(llvm::OptimizationLevel::O0);
+    break;
+  case '1':
+    compiler.SetOptLevel(llvm::OptimizationLevel::O1);
+    break;
+  case '2':
+    compiler.SetOptLevel(llvm::OptimizationLevel::O2);
+    break;
+  case '3':
+    compiler.SetOptLevel(llvm::OptimizationLevel::O3);
+    break;
+  case 's':
+    compiler.SetOptLevel(llvm::OptimizationLevel::Os);
+    break;
+  case 'z':
+    compiler.SetOptLevel(llvm::OptimizationLevel::Oz);
+    break;
+  default:
+    std::cerr << makeString("invalid optimization level '-O{}'\n",
+                            opt_level.getValue());
+    exit(EXIT_FAILURE);
+  }
+  bool profile = profile_generate.getNumOccurrences() != 0;
+  if (profile && profile_use.getNumOccurrences() != 0) {
+    std::cerr << makeString(
+        "-fprofile-generate and -fprofile-use can not be used together\n");
+    exit(EXIT_FAILURE);
+  }
+  if (profile) {
+    /// one raw profile per binary, as clang names them
+    llvm::SmallString<128> profile_file;
+    if (!profile_generate.empty()) {
+      llvm::sys::path::append(profile_file, profile_generate.getValue(),
+                              "default_%m.profraw");
+    }
+    compiler.SetProfileGenerate(profile_file.str().str());
+  } else if (profile_use.getNumOccurrences() != 0) {
+    compiler.SetProfileUse(profile_use);
+  }
+  if (ast_dump.getNumOccurrences() != 0) {
+    compiler.SetASTDump(ast_dump);
+  }
   /// wrap parameters
-  std::string src = argv[1];
+  std::string src = input_file;
   if (!src.ends_with(toyc::ext)) {
     std::cerr << makeString("incorrect file extension\n");
     exit(EXIT_FAILURE);
   }
-  std::string dest = (argc == 3) ? argv[2] : "a.ll";
+  /// `-o` without `-c` links an executable
+  bool link = output_path.getNumOccurrences() != 0 && !compile_only;
+  if (compile_only || link) {
+    compiler.SetOutputKind(toyc::OBJECT_FILE);
+  }
+  std::string dest = output_file;
+  if (output_path.getNumOccurrences() != 0) {
+    dest = output_path;
+  } else if (compile_only && output_file.getNumOccurrences() == 0) {
+    dest = (llvm::sys::path::stem(src) + ".o").str();
+  }
 
-  /// redirect to string first
-  std::string output;
-  llvm::raw_string_ostream ros(output);
+  /// redirect to memory first
+  llvm::SmallString<0> output;
+  llvm::raw_svector_ostream ros(output);
   compiler.Compile(src, ros);
-  /// write into file
-  if (!toyc::WriteTo(dest, output)) {
-    std::cerr << makeString("failed to open file '{}'\n", src);
+  compiler.ReportTimes();
+  if (cache_stats && compiler.GetCache() != nullptr) {
+    toyc::CompileCache &cache = *compiler.GetCache();
+    toyc::CacheStats stats = cache.GetStats();
+    std::cerr << makeString("cache '{}': {} hits, {} misses, {:.1f} of {} MiB\n",
+                            cache.GetDir(), stats.hits_, stats.misses_,
+                            static_cast<double>(stats.size_) / (1024 * 1024),
+                            cache.GetMaxSize() / (1024 * 1024));
+  }
+  if (!link) {
+    /// write into file
+    if (!WriteFile(dest, output)) {
+      std::cerr << makeString("failed to open file '{}'\n", dest);
+      exit(EXIT_FAILURE);
+    }
+    return 0;
+  }
+
+  /// hand the object code to the linker through a temporary file
+  llvm::SmallString<128> object;
+  if (llvm::sys::fs::createTemporaryFile("toycc", "o", object) ||
+      !WriteFile(object.str().str(), output)) {
+    std::cerr << makeString("failed to create a temporary object file\n");
+    exit(EXIT_FAILURE);
+  }
+  bool linked = toyc::Compiler::Link(object.str().str(), dest, profile);
+  llvm::sys::fs::remove(object);
+  if (!linked) {
     exit(EXIT_FAILURE);
   }
   return 0;
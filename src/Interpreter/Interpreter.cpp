@@ -1,18 +1,36 @@
 //! Interpreter implementation
 
 #include <Interpreter/Interpreter.h>
+#include <Sema/Canonicalizer.h>
+#include <Sema/ConstantFolder.h>
+#include <Sema/DeadCodeEliminator.h>
+#include <Sema/FunctionAttrInference.h>
 
 #include <cstdint>
 #include <cstdlib>
 #include <exception>
 #include <memory>
 #include <sstream>
+#include <variant>
 
 namespace toyc {
 
 void Interpreter::Execute(InterpreterParser::ParseResult &unit) {
+  /// run AST passes before generating IR
+  std::visit(
+      [this](auto &node) {
+        Canonicalizer canonicalizer;
+        canonicalizer.Run(node);
+        ConstantFolder folder;
+        folder.Run(node);
+        eliminator_.Run(node);
+      },
+      unit);
+
   if (unit.index() == 0) {
     auto &decl = std::get<std::unique_ptr<Decl>>(unit);
+    attr_inference_.Run(decl);
+    visitor_.SetFunctionAttrs(attr_inference_.GetAttrs());
     visitor_.HandleDeclaration(decl);
   } else if (unit.index() == 1) {
     auto &stmt = std::get<std::unique_ptr<Stmt>>(unit);
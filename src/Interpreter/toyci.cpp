@@ -1,5 +1,6 @@
 //! entry point of toyc
 
+#include <CodeGen/CodeGen.h>
 #include <Config.h>
 #include <Interpreter/Interpreter.h>
 
@@ -8,22 +9,55 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <string>
 #include <vector>
 
 auto main(int argc, const char **argv) -> int {
-  if (argc < 2) {
-    std::cerr << makeString("Usage: {} <src>\n", argv[0]);
+  /// options before the source: `-g` emits debug info, `-march=<cpu>` (or
+  /// `-mcpu=<cpu>`, which wins) generates code for `cpu`, `native` for the
+  /// host
+  bool debug_info = false;
+  std::string march;
+  std::string mcpu;
+  bool usage = argc < 2;
+  for (int i = 1; i < argc - 1; i++) {
+    std::string arg(argv[i]);
+    if (arg == "-g") {
+      debug_info = true;
+    } else if (arg.starts_with("-march=")) {
+      march = arg.substr(7);
+    } else if (arg.starts_with("-mcpu=")) {
+      mcpu = arg.substr(6);
+    } else {
+      usage = true;
+    }
+  }
+  if (usage) {
+    std::cerr << makeString(
+        "Usage: {} [-g] [-march=<cpu>] [-mcpu=<cpu>] <src>\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  const std::string &cpu = toyc::BaseIRVisitor::SelectTargetCPU(march, mcpu);
+  if (!cpu.empty() && !toyc::BaseIRVisitor::IsTargetCPUValid(cpu)) {
+    std::cerr << makeString("unknown target CPU '{}'\n", cpu);
     exit(EXIT_FAILURE);
   }
 
   toyc::Interpreter interpreter;
   std::string input;
-  std::string src(argv[1]);
+  std::string src(argv[argc - 1]);
   if (!src.ends_with(toyc::script_ext)) {
     std::cerr << makeString("incorrect file extension\n");
     exit(EXIT_FAILURE);
   }
 
+  /// the JIT is created anew for the CPU, before it is told about debug info
+  if (!cpu.empty()) {
+    interpreter.SetTargetCPU(cpu);
+  }
+  if (debug_info) {
+    interpreter.EnableDebugInfo(src);
+  }
   toyc::ReadFrom(src, input);
   interpreter.ParseAndExecute(input);
   return 0;
@@ -14,6 +14,7 @@
 namespace toyc {
 
 auto InterpreterParser::ParseExprOrExprStmt() -> InterpreterParser::ExprOrStmt {
+  SourceLoc loc = GetLoc(Peek());
   ExprPtr expr = nullptr;
   bool is_stmt = true;
   if (!Match(SEMI)) {
@@ -22,12 +23,14 @@ auto InterpreterParser::ParseExprOrExprStmt() -> InterpreterParser::ExprOrStmt {
       is_stmt = false;
     }
   }
-  return {std::make_unique<ExprStmt>(std::move(expr)), is_stmt};
+  return {MakeNode<ExprStmt>(loc, std::move(expr)), is_stmt};
 }
 
 auto InterpreterParser::ParseVariableDeclaration(std::string type,
                                                  std::string name,
                                                  VarScope scope) -> DeclPtr {
+  /// called right after the name
+  SourceLoc loc = GetLoc(Previous());
   ExprPtr init;
   if (scope == GLOBAL) {
     if (global_var_table_.find(name) != global_var_table_.end()) {
@@ -44,36 +47,21 @@ auto InterpreterParser::ParseVariableDeclaration(std::string type,
   }
 
   if (init != nullptr && type != init->GetType()) {
-    init = std::make_unique<ImplicitCastExpr>(type, std::move(init));
+    init = MakeNode<ImplicitCastExpr>(init->loc_, type, std::move(init));
   }
-  std::unique_ptr<VarDecl> decl = std::make_unique<VarDecl>(
-      std::move(name), std::move(type), std::move(init), scope);
+  std::unique_ptr<VarDecl> decl = MakeNode<VarDecl>(
+      loc, std::move(name), std::move(type), std::move(init), scope);
   Consume(SEMI, "expected ';' after declaration");
 
   return decl;
 }
 
 auto InterpreterParser::Parse() -> InterpreterParser::ParseResult {
-  std::string type;
-  std::string name;
-  bool is_extern = false;
-  if (Match(EXTERN)) {
-    is_extern = true;
-  }
   /// declaration
-  if (Match({VOID, I64, F64})) {
-    type = Previous().value_;
-    if (Match(IDENTIFIER)) {
-      name = Previous().value_;
-    } else {
-      throw ParserException(loc_, "invalid expression");
-    }
-    if (Match(LP)) {
-      return ParseFunctionDeclaration(type, name, is_extern);
-    }
-    return ParseVariableDeclaration(type, name, GLOBAL);
+  if (Check({EXTERN, STATIC, INLINE, CONST, VOID, I64, F64})) {
+    return ParseExternalDeclaration();
   }
-  if (Check({IF, WHILE, FOR, LC})) {
+  if (Check({IF, SWITCH, WHILE, FOR, BREAK, LC})) {
     return ParseStatement();
   }
   auto [stmt, flag] = ParseExprOrExprStmt();
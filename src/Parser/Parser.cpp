@@ -40,6 +40,12 @@ auto BaseParser::Consume(TokenTy type, std::string message) -> Token {
   throw ParserException(loc_, std::move(message));
 }
 
+auto BaseParser::GetLoc(const Token &token) -> SourceLoc {
+  /// tokens end at their column, string values lost their quotes
+  size_t size = token.value_.size() + (token.type_ == STRING ? 2 : 0);
+  return {token.line_, token.col_ >= size ? token.col_ - size + 1 : 1};
+}
+
 auto BaseParser::Check(std::initializer_list<TokenTy> types) -> bool {
   for (TokenTy type : types) {
     if (type == _EOF) {
@@ -93,13 +99,13 @@ auto BaseParser::ParseIntegerLiteral() -> ExprPtr {
     base = 8;
   }
   value = std::stoll(value_str, nullptr, base);
-  return std::make_unique<IntegerLiteral>(value, "i64");
+  return MakeNode<IntegerLiteral>(GetLoc(Previous()), value, "i64");
 }
 
 auto BaseParser::ParseFloatingLiteral() -> ExprPtr {
   std::string value_str = Previous().value_;
   double value = std::stold(value_str, nullptr);
-  return std::make_unique<FloatingLiteral>(value, "f64");
+  return MakeNode<FloatingLiteral>(GetLoc(Previous()), value, "f64");
 }
 
 auto BaseParser::ParsePrimaryExpression() -> ExprPtr {
@@ -113,7 +119,8 @@ auto BaseParser::ParsePrimaryExpression() -> ExprPtr {
     std::string value = Previous().value_;
     /// add a terminator '\0' size
     std::string type = makeString("char[{}]", value.size() + 1);
-    return std::make_unique<StringLiteral>(std::move(value), std::move(type));
+    return MakeNode<StringLiteral>(GetLoc(Previous()), std::move(value),
+                                   std::move(type));
   }
   if (Match(IDENTIFIER)) {
     Token token = Previous();
@@ -122,15 +129,19 @@ auto BaseParser::ParsePrimaryExpression() -> ExprPtr {
     if (Peek().type_ != LP) { /// variable
       /// if local variable table not found, turn to global variable table
       type = var_table_[name];
+      bool is_const = const_vars_.contains(name);
       if (type.empty()) {
         type = global_var_table_[name];
+        is_const = const_global_vars_.contains(name);
       }
       if (type.empty()) {
         throw ParserException(loc_,
                               makeString("identifier '{}' not found", name));
       }
-      return std::make_unique<DeclRefExpr>(
-          std::make_unique<VarDecl>(std::move(name), std::move(type)));
+      return MakeNode<DeclRefExpr>(
+          GetLoc(token),
+          std::make_unique<VarDecl>(std::move(name), std::move(type), nullptr,
+                                    LOCAL, is_const ? CONST_SPEC : NO_SPEC));
     }
 
     /// function call
@@ -150,14 +161,16 @@ auto BaseParser::ParsePrimaryExpression() -> ExprPtr {
       params.push_back(std::make_unique<ParmVarDecl>(param_name, param));
     }
 
-    return std::make_unique<DeclRefExpr>(
+    return MakeNode<DeclRefExpr>(
+        GetLoc(token),
         std::make_unique<FunctionDecl>(std::make_unique<FunctionProto>(
             func_name, ret_type, std::move(params), 0)));
   }
   if (Match(LP)) {
+    SourceLoc loc = GetLoc(Previous());
     auto expr = ParseExpression();
     Consume(RP, "expected ')'");
-    expr = std::make_unique<ParenExpr>(std::move(expr));
+    expr = MakeNode<ParenExpr>(loc, std::move(expr));
     return expr;
   }
   throw ParserException(loc_, "parse primary expression error");
@@ -168,8 +181,8 @@ auto BaseParser::ParsePostfixExpression() -> ExprPtr {
   /// parse function call
   if (Match(LP)) {
     auto func =
-        std::make_unique<DeclRefExpr>(dynamic_cast<DeclRefExpr *>(expr.get()));
-    auto f = dynamic_cast<FunctionDecl *>(func->decl_.get());
+        std::make_unique<DeclRefExpr>(llvm::dyn_cast<DeclRefExpr>(expr.get()));
+    auto f = llvm::dyn_cast<FunctionDecl>(func->decl_.get());
     if (f == nullptr) {
       throw ParserException(loc_, "error when parsing function call");
     }
@@ -184,23 +197,21 @@ auto BaseParser::ParsePostfixExpression() -> ExprPtr {
                          f->proto_->params_.size()));
         }
         auto arg = ParseExpression();
-        arg = std::make_unique<ImplicitCastExpr>(
-            f->proto_->params_[idx]->GetType(), std::move(arg));
+        arg = MakeNode<ImplicitCastExpr>(
+            arg->loc_, f->proto_->params_[idx]->GetType(), std::move(arg));
         idx++;
         args.push_back(std::move(arg));
       } while (Match(COMMA));
     }
     Consume(RP, "expect ')' after arguments");
-    return std::make_unique<CallExpr>(std::move(func), std::move(args));
+    return MakeNode<CallExpr>(func->loc_, std::move(func), std::move(args));
   }
   if (Match({INC_OP, DEC_OP})) {
-    if (!expr->Assignable()) {
-      throw ParserException(loc_, "expression is not assignable");
-    }
+    CheckAssignable(*expr);
     Token op = Previous();
     std::string type = actions_.CheckUnaryOperator(expr, op.type_);
-    return std::make_unique<UnaryOperator>(op, std::move(expr), std::move(type),
-                                           POSTFIX);
+    return MakeNode<UnaryOperator>(GetLoc(op), op, std::move(expr),
+                                   std::move(type), POSTFIX);
   }
   return expr;
 }
@@ -211,19 +222,17 @@ auto BaseParser::ParseUnaryExpression() -> ExprPtr {
     Token op = Previous();
     auto expr = ParseUnaryExpression();
     std::string type = actions_.CheckUnaryOperator(expr, op.type_);
-    return std::make_unique<UnaryOperator>(op, std::move(expr), std::move(type),
-                                           PREFIX);
+    return MakeNode<UnaryOperator>(GetLoc(op), op, std::move(expr),
+                                   std::move(type), PREFIX);
   }
   /// prefix unary operator (assignable)
   if (Match({INC_OP, DEC_OP})) {
     Token op = Previous();
     auto expr = ParseUnaryExpression();
-    if (!expr->Assignable()) {
-      throw ParserException(loc_, "expression is not assignable");
-    }
+    CheckAssignable(*expr);
     std::string type = actions_.CheckUnaryOperator(expr, op.type_);
-    return std::make_unique<UnaryOperator>(op, std::move(expr), std::move(type),
-                                           PREFIX);
+    return MakeNode<UnaryOperator>(GetLoc(op), op, std::move(expr),
+                                   std::move(type), PREFIX);
   }
   return ParsePostfixExpression();
 }
@@ -234,8 +243,8 @@ auto BaseParser::ParseMultiplicativeExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseUnaryExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -246,8 +255,8 @@ auto BaseParser::ParseAdditiveExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseMultiplicativeExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -264,8 +273,8 @@ auto BaseParser::ParseShiftExpression() -> ExprPtr {
           makeString("invalid operands to binary expression ('{}' and '{}')",
                      expr->GetType(), right->GetType()));
     }
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -276,8 +285,8 @@ auto BaseParser::ParseRelationalExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseShiftExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -288,8 +297,8 @@ auto BaseParser::ParseEqualityExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseRelationalExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -300,8 +309,8 @@ auto BaseParser::ParseLogicalAndExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseEqualityExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
@@ -312,23 +321,44 @@ auto BaseParser::ParseLogicalOrExpression() -> ExprPtr {
     Token op = Previous();
     auto right = ParseLogicalAndExpression();
     std::string type = actions_.CheckBinaryOperator(expr, right, op.type_);
-    expr = std::make_unique<BinaryOperator>(op, std::move(expr),
-                                            std::move(right), std::move(type));
+    expr = MakeNode<BinaryOperator>(GetLoc(op), op, std::move(expr),
+                                    std::move(right), std::move(type));
   }
   return expr;
 }
 
-auto BaseParser::ParseAssignmentExpression() -> ExprPtr {
+auto BaseParser::ParseConditionalExpression() -> ExprPtr {
   auto expr = ParseLogicalOrExpression();
+  if (Match(QUE)) {
+    Token token = Previous();
+    auto true_expr = ParseExpression();
+    Consume(COLON, "expected ':' in conditional expression");
+    auto false_expr = ParseConditionalExpression();
+    std::string type = actions_.CheckConditionalOperator(true_expr, false_expr);
+    if (type.empty()) {
+      throw ParserException(
+          loc_, makeString("incompatible operand types ('{}' and '{}')",
+                           true_expr->GetType(), false_expr->GetType()));
+    }
+    return MakeNode<ConditionalOperator>(GetLoc(token), std::move(expr),
+                                         std::move(true_expr),
+                                         std::move(false_expr), type);
+  }
+  return expr;
+}
+
+auto BaseParser::ParseAssignmentExpression() -> ExprPtr {
+  auto expr = ParseConditionalExpression();
   if (Match(EQUAL)) {
     Token token = Previous();
+    CheckAssignable(*expr);
     auto right = ParseAssignmentExpression();
     if (expr->GetType() != right->GetType()) {
-      right =
-          std::make_unique<ImplicitCastExpr>(expr->GetType(), std::move(right));
+      right = MakeNode<ImplicitCastExpr>(right->loc_, expr->GetType(),
+                                         std::move(right));
     }
-    return std::make_unique<BinaryOperator>(token, std::move(expr),
-                                            std::move(right), right->GetType());
+    return MakeNode<BinaryOperator>(GetLoc(token), token, std::move(expr),
+                                    std::move(right), right->GetType());
   }
   return expr;
 }
@@ -342,36 +372,44 @@ auto BaseParser::ParseExpression() -> ExprPtr {
  */
 
 auto BaseParser::ParseExpressionStatement() -> StmtPtr {
+  SourceLoc loc = GetLoc(Peek());
   ExprPtr expr = nullptr;
   if (!Match(SEMI)) {
     expr = ParseExpression();
     Consume(SEMI, "expected ';' after expression");
   }
-  return std::make_unique<ExprStmt>(std::move(expr));
+  return MakeNode<ExprStmt>(loc, std::move(expr));
 }
 
 auto BaseParser::ParseReturnStatement() -> StmtPtr {
-  Consume(RETURN, "expected 'return'");
+  SourceLoc loc = GetLoc(Consume(RETURN, "expected 'return'"));
   ExprPtr expr = nullptr;
   if (!Match(SEMI)) {
     expr = ParseExpression();
     Consume(SEMI, "expected ';' after expression");
   }
-  return std::make_unique<ReturnStmt>(std::move(expr));
+  return MakeNode<ReturnStmt>(loc, std::move(expr));
+}
+
+auto BaseParser::ParseBreakStatement() -> StmtPtr {
+  SourceLoc loc = GetLoc(Consume(BREAK, "expected 'break'"));
+  Consume(SEMI, "expected ';' after 'break'");
+  return MakeNode<BreakStmt>(loc);
 }
 
 auto BaseParser::ParseIterationStatement() -> StmtPtr {
+  SourceLoc loc = GetLoc(Peek());
   if (Match(WHILE)) {
     Consume(LP, "expect '(' after 'while'");
     auto expr = ParseExpression();
     Consume(RP, "expect ')'");
     auto stmt = ParseStatement();
-    return std::make_unique<WhileStmt>(std::move(expr), std::move(stmt));
+    return MakeNode<WhileStmt>(loc, std::move(expr), std::move(stmt));
   }
   if (Match(FOR)) {
     Consume(LP, "expect '(' after 'for'");
     StmtPtr init;
-    if (Check({I64, F64})) {
+    if (Check({CONST, I64, F64})) {
       init = ParseDeclarationStatement();
     } else {
       throw ParserException(loc_, "not support expression statement now!");
@@ -382,16 +420,18 @@ auto BaseParser::ParseIterationStatement() -> StmtPtr {
     Consume(RP, "expect ')'");
     auto body = ParseStatement();
 
-    auto decl_stmt = dynamic_cast<DeclStmt *>(init.get());
+    auto decl_stmt = llvm::dyn_cast<DeclStmt>(init.get());
     var_table_.erase(decl_stmt->decl_->GetName());
-    return std::make_unique<ForStmt>(std::make_unique<DeclStmt>(decl_stmt),
-                                     std::move(cond), std::move(update),
-                                     std::move(body));
+    const_vars_.erase(decl_stmt->decl_->GetName());
+    return MakeNode<ForStmt>(loc, std::make_unique<DeclStmt>(decl_stmt),
+                             std::move(cond), std::move(update),
+                             std::move(body));
   }
   throw ParserException(loc_, "error in iteration statement");
 }
 
 auto BaseParser::ParseSelectionStatement() -> StmtPtr {
+  SourceLoc loc = GetLoc(Peek());
   if (Match(IF)) {
     Consume(LP, "expect '(' after 'if'");
     auto expr = ParseExpression();
@@ -402,44 +442,99 @@ auto BaseParser::ParseSelectionStatement() -> StmtPtr {
     if (Match(ELSE)) {
       else_stmt = ParseStatement();
     }
-    return std::make_unique<IfStmt>(std::move(expr), std::move(then_stmt),
-                                    std::move(else_stmt));
+    return MakeNode<IfStmt>(loc, std::move(expr), std::move(then_stmt),
+                            std::move(else_stmt));
+  }
+  if (Match(SWITCH)) {
+    Consume(LP, "expect '(' after 'switch'");
+    auto expr = ParseExpression();
+    Consume(RP, "expect ')'");
+    if (expr->GetType() != "i64") {
+      throw ParserException(loc_, "switch condition must be of type 'i64'");
+    }
+    auto body = ParseSwitchBody();
+    return MakeNode<SwitchStmt>(loc, std::move(expr), std::move(body));
   }
   throw ParserException(loc_, "error in selection statement");
 }
 
+auto BaseParser::ParseSwitchBody() -> StmtPtr {
+  SourceLoc loc = GetLoc(Consume(LC, "expected '{' after switch condition"));
+  std::vector<StmtPtr> stmts;
+  while (!Check(RC) && current_.type_ != _EOF) {
+    SourceLoc label = GetLoc(Peek());
+    if (Match(CASE)) {
+      auto value = ParseExpression();
+      if (!value->IsConstant() || value->GetType() != "i64") {
+        throw ParserException(
+            loc_, "case value must be an 'i64' constant expression");
+      }
+      Consume(COLON, "expected ':' after 'case'");
+      stmts.push_back(MakeNode<CaseStmt>(label, std::move(value)));
+    } else if (Match(DEFAULT)) {
+      Consume(COLON, "expected ':' after 'default'");
+      stmts.push_back(MakeNode<DefaultStmt>(label));
+    } else {
+      stmts.push_back(ParseStatement());
+    }
+  }
+  Consume(RC, "expected '}'");
+  return MakeNode<CompoundStmt>(loc, std::move(stmts));
+}
+
 auto BaseParser::ParseDeclarationStatement() -> StmtPtr {
-  Advance();
+  SourceLoc loc = GetLoc(Advance());
+  bool is_const = Previous().type_ == CONST;
+  if (is_const) {
+    Advance();
+  }
   auto type = Previous().value_;
   if (Match(IDENTIFIER)) {
     auto name = Previous().value_;
     auto decl = ParseVariableDeclaration(type, name, LOCAL);
-    return std::make_unique<DeclStmt>(std::move(decl));
+    /// a redeclaration drops the `const` of an earlier variable of that name
+    if (is_const) {
+      llvm::cast<VarDecl>(*decl).specs_ |= CONST_SPEC;
+      const_vars_.insert(name);
+    } else {
+      const_vars_.erase(name);
+    }
+    return MakeNode<DeclStmt>(loc, std::move(decl));
   }
   throw ParserException(loc_, "expected identifier");
 }
 
 auto BaseParser::ParseCompoundStatement() -> StmtPtr {
-  Consume(LC, "expected function body after function declarator");
+  SourceLoc loc =
+      GetLoc(Consume(LC, "expected function body after function declarator"));
   std::vector<StmtPtr> stmts;
   while (!Check(RC) && current_.type_ != _EOF) {
     auto stmt = ParseStatement();
     stmts.push_back(std::move(stmt));
   }
   Consume(RC, "expected '}'");
-  return std::make_unique<CompoundStmt>(std::move(stmts));
+  return MakeNode<CompoundStmt>(loc, std::move(stmts));
 }
 
 auto BaseParser::ParseStatement() -> StmtPtr {
   if (Check(RETURN)) {
     return ParseReturnStatement();
   }
-  if (Check({VOID, I64, F64})) {
+  if (Check({CONST, VOID, I64, F64})) {
     return ParseDeclarationStatement();
   }
-  if (Check(IF)) {
+  if (Check({IF, SWITCH})) {
     return ParseSelectionStatement();
   }
+  /// labels are parsed by `ParseSwitchBody()` only
+  if (Check({CASE, DEFAULT})) {
+    throw ParserException(loc_,
+                          makeString("'{}' label not within a switch body",
+                                     Peek().value_));
+  }
+  if (Check(BREAK)) {
+    return ParseBreakStatement();
+  }
   /// support while and for statement
   if (Check({WHILE, FOR})) {
     return ParseIterationStatement();
@@ -456,19 +551,52 @@ auto BaseParser::ParseStatement() -> StmtPtr {
  * internal parse
  */
 
-auto BaseParser::ParseDeclarationSpecifiers() -> std::pair<std::string, bool> {
-  std::string spec;
-  bool is_extern = false;
-  if (Match(EXTERN)) {
-    is_extern = true;
+auto BaseParser::ParseDeclarationSpecifiers() -> DeclSpecifiers {
+  DeclSpecifiers spec;
+  /// `extern`, `static`, `inline` and `const` come in any order before the
+  /// type
+  while (Match({EXTERN, STATIC, INLINE, CONST})) {
+    switch (Previous().type_) {
+    case EXTERN:
+      spec.is_extern_ = true;
+      break;
+    case STATIC:
+      spec.specs_ |= STATIC_SPEC;
+      break;
+    case INLINE:
+      spec.specs_ |= INLINE_SPEC;
+      break;
+    default:
+      spec.specs_ |= CONST_SPEC;
+      break;
+    }
+  }
+  if (spec.is_extern_ && (spec.specs_ & STATIC_SPEC) != 0) {
+    throw ParserException(
+        loc_, "cannot combine 'static' with 'extern' declaration specifier");
   }
   if (Match({VOID, I64, F64})) {
-    spec = Previous().value_;
+    spec.type_ = Previous().value_;
   };
-  return {spec, is_extern};
+  return spec;
   throw ParserException(loc_, "expected type specifier");
 }
 
+void BaseParser::CheckAssignable(const Expr &expr) {
+  if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(&expr)) {
+    const auto *var = llvm::dyn_cast<VarDecl>(ref->decl_.get());
+    if (var != nullptr && var->IsConst()) {
+      throw ParserException(
+          loc_, makeString("cannot assign to variable '{}' with "
+                           "const-qualified type",
+                           var->name_));
+    }
+  }
+  if (!expr.Assignable()) {
+    throw ParserException(loc_, "expression is not assignable");
+  }
+}
+
 auto BaseParser::ParseDeclarator() -> std::string {
   if (Match(IDENTIFIER)) {
     return Previous().value_;
@@ -484,11 +612,18 @@ auto BaseParser::ParseFunctionParameters()
       if (params.size() >= 255) {
         throw ParserException(loc_, "can't have more than 255 parameters");
       }
-      auto [type, flag] = ParseDeclarationSpecifiers();
+      auto spec = ParseDeclarationSpecifiers();
+      if (spec.is_extern_ || (spec.specs_ & ~CONST_SPEC) != 0) {
+        throw ParserException(
+            loc_, "invalid storage class specifier in function declarator");
+      }
       auto name = ParseDeclarator();
-      var_table_[name] = type;
-      params.push_back(
-          std::make_unique<ParmVarDecl>(std::move(name), std::move(type)));
+      var_table_[name] = spec.type_;
+      if ((spec.specs_ & CONST_SPEC) != 0) {
+        const_vars_.insert(name);
+      }
+      params.push_back(MakeNode<ParmVarDecl>(
+          GetLoc(Previous()), std::move(name), std::move(spec.type_)));
 
     } while (Match(COMMA));
   }
@@ -515,6 +650,8 @@ auto BaseParser::GenFuncType(std::string &&retTy,
 
 auto BaseParser::ParseVariableDeclaration(std::string type, std::string name,
                                           VarScope scope) -> DeclPtr {
+  /// called right after the name
+  SourceLoc loc = GetLoc(Previous());
   ExprPtr init;
   if (scope == GLOBAL) {
     if (global_var_table_.find(name) != global_var_table_.end()) {
@@ -523,9 +660,9 @@ auto BaseParser::ParseVariableDeclaration(std::string type, std::string name,
     /// for global variable, set default value
     ExprPtr zero;
     if (type == "i64") {
-      zero = std::make_unique<IntegerLiteral>(0, "i64");
+      zero = MakeNode<IntegerLiteral>(loc, 0, "i64");
     } else if (type == "f64") {
-      zero = std::make_unique<FloatingLiteral>(0, "f64");
+      zero = MakeNode<FloatingLiteral>(loc, 0, "f64");
     } else {
       throw ParserException(loc_, "not supported type");
     }
@@ -544,10 +681,10 @@ auto BaseParser::ParseVariableDeclaration(std::string type, std::string name,
   }
 
   if (init != nullptr && type != init->GetType()) {
-    init = std::make_unique<ImplicitCastExpr>(type, std::move(init));
+    init = MakeNode<ImplicitCastExpr>(init->loc_, type, std::move(init));
   }
-  std::unique_ptr<VarDecl> decl = std::make_unique<VarDecl>(
-      std::move(name), std::move(type), std::move(init), scope);
+  std::unique_ptr<VarDecl> decl = MakeNode<VarDecl>(
+      loc, std::move(name), std::move(type), std::move(init), scope);
   Consume(SEMI, "expected ';' after declaration");
   return decl;
 }
@@ -582,12 +719,46 @@ auto BaseParser::ParseFunctionDeclaration(std::string ret_ty, std::string name,
 }
 
 auto BaseParser::ParseExternalDeclaration() -> DeclPtr {
-  auto [type, flag] = ParseDeclarationSpecifiers();
+  auto spec = ParseDeclarationSpecifiers();
   auto name = ParseDeclarator();
+  SourceLoc loc = GetLoc(Previous());
   if (Match(LP)) {
-    return ParseFunctionDeclaration(type, name, flag);
+    if ((spec.specs_ & CONST_SPEC) != 0) {
+      throw ParserException(loc_, "'const' can only appear on variables");
+    }
+    DeclPtr decl = ParseFunctionDeclaration(spec.type_, name, spec.is_extern_);
+    decl->loc_ = loc;
+    llvm::cast<FunctionDecl>(*decl).specs_ = spec.specs_;
+    return decl;
+  }
+  if ((spec.specs_ & INLINE_SPEC) != 0) {
+    throw ParserException(loc_, "'inline' can only appear on functions");
+  }
+  DeclPtr decl = ParseVariableDeclaration(spec.type_, name, GLOBAL);
+  llvm::cast<VarDecl>(*decl).specs_ = spec.specs_;
+  if ((spec.specs_ & CONST_SPEC) != 0) {
+    const_global_vars_.insert(name);
+  }
+  return decl;
+}
+
+void BaseParser::AddDeclaration(const Decl &decl) {
+  if (const auto *var = llvm::dyn_cast<VarDecl>(&decl)) {
+    global_var_table_[var->name_] = var->type_;
+    if (var->IsConst()) {
+      const_global_vars_.insert(var->name_);
+    }
+  } else if (const auto *func = llvm::dyn_cast<FunctionDecl>(&decl)) {
+    /// function type is `<return type> (<param type>, ...)`
+    const std::string &func_type = func->proto_->type_;
+    std::vector<std::string> params_ty;
+    for (const auto &param : func->proto_->params_) {
+      params_ty.push_back(param->GetType());
+    }
+    func_table_[func->proto_->name_] =
+        FunctionParams(func->proto_->name_,
+                       func_type.substr(0, func_type.find(" (")), params_ty);
   }
-  return ParseVariableDeclaration(type, name, GLOBAL);
 }
 
 /**
@@ -2,6 +2,7 @@
 
 #include <Preprocessor/Preprocessor.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -93,6 +94,20 @@ void Preprocessor::ImportLib() {
     lib_name = absolute_path.parent_path().parent_path().string() +
                "/include/" + lib_name + ".toyc";
 
+    /// declarations of the file come from its precompiled AST
+    if (precompiled_) {
+      if (!fs::exists(lib_name)) {
+        std::cerr << makeString("failed to open file '{}'\n", lib_name);
+        exit(EXIT_FAILURE);
+      }
+      if (std::find(includes_.begin(), includes_.end(), lib_name) ==
+          includes_.end()) {
+        includes_.push_back(lib_name);
+      }
+      current_ = start_;
+      return;
+    }
+
     /// read content from file
     std::string content;
     if (!ReadFrom(lib_name, content)) {
@@ -103,6 +118,9 @@ void Preprocessor::ImportLib() {
     Preprocessor p;
     p.SetInput(content);
     content = p.Process();
+    /// the contents take the line of the `#include`, so that the lines of this
+    /// file, and the source locations of its nodes, stay where they are
+    std::replace(content.begin(), content.end(), '\n', ' ');
     /// insert content into current file and reset cursors
     input_.insert(start_, content);
     start_ += content.size() + 1;
@@ -0,0 +1,122 @@
+//! AST rewriter implementation
+
+#include <Sema/ASTRewriter.h>
+
+namespace toyc {
+
+void ASTRewriter::Run(TranslationUnitDecl &unit) {
+  for (auto &decl : unit.decls_) {
+    Run(decl);
+  }
+}
+
+void ASTRewriter::Run(DeclPtr &decl) {
+  if (decl == nullptr) {
+    return;
+  }
+  if (auto *var = llvm::dyn_cast<VarDecl>(decl.get())) {
+    if (var->init_ != nullptr) {
+      Run(var->init_);
+    }
+  } else if (auto *func = llvm::dyn_cast<FunctionDecl>(decl.get())) {
+    if (func->body_ != nullptr) {
+      Run(func->body_);
+    }
+  }
+}
+
+void ASTRewriter::Run(StmtPtr &stmt) {
+  if (stmt == nullptr) {
+    return;
+  }
+  switch (stmt->GetNodeKind()) {
+  case COMPOUND_STMT:
+    for (auto &child : llvm::cast<CompoundStmt>(*stmt).stmts_) {
+      Run(child);
+    }
+    break;
+  case EXPR_STMT:
+    Run(llvm::cast<ExprStmt>(*stmt).expr_);
+    break;
+  case DECL_STMT:
+    Run(llvm::cast<DeclStmt>(*stmt).decl_);
+    break;
+  case IF_STMT: {
+    auto &s = llvm::cast<IfStmt>(*stmt);
+    Run(s.cond_);
+    Run(s.then_stmt_);
+    Run(s.else_stmt_);
+    break;
+  }
+  case WHILE_STMT: {
+    auto &s = llvm::cast<WhileStmt>(*stmt);
+    Run(s.cond_);
+    Run(s.stmt_);
+    break;
+  }
+  case FOR_STMT: {
+    auto &s = llvm::cast<ForStmt>(*stmt);
+    /// `init_` is owned as `DeclStmt`, only its declaration can be rewritten
+    Run(s.init_->decl_);
+    Run(s.cond_);
+    Run(s.update_);
+    Run(s.body_);
+    break;
+  }
+  case RETURN_STMT:
+    Run(llvm::cast<ReturnStmt>(*stmt).expr_);
+    break;
+  case SWITCH_STMT: {
+    auto &s = llvm::cast<SwitchStmt>(*stmt);
+    Run(s.cond_);
+    Run(s.body_);
+    break;
+  }
+  case CASE_STMT:
+    Run(llvm::cast<CaseStmt>(*stmt).value_);
+    break;
+  default:
+    break;
+  }
+  Rewrite(stmt);
+}
+
+void ASTRewriter::Run(ExprPtr &expr) {
+  if (expr == nullptr) {
+    return;
+  }
+  switch (expr->GetNodeKind()) {
+  case IMPLICIT_CAST_EXPR:
+    Run(llvm::cast<ImplicitCastExpr>(*expr).expr_);
+    break;
+  case PAREN_EXPR:
+    Run(llvm::cast<ParenExpr>(*expr).expr_);
+    break;
+  case CALL_EXPR:
+    for (auto &arg : llvm::cast<CallExpr>(*expr).args_) {
+      Run(arg);
+    }
+    break;
+  case UNARY_OPERATOR:
+    Run(llvm::cast<UnaryOperator>(*expr).expr_);
+    break;
+  case BINARY_OPERATOR: {
+    auto &e = llvm::cast<BinaryOperator>(*expr);
+    Run(e.left_);
+    Run(e.right_);
+    break;
+  }
+  case CONDITIONAL_OPERATOR: {
+    auto &e = llvm::cast<ConditionalOperator>(*expr);
+    Run(e.cond_);
+    Run(e.true_expr_);
+    Run(e.false_expr_);
+    break;
+  }
+  default:
+    break;
+  }
+  Rewrite(expr);
+}
+
+} // namespace toyc
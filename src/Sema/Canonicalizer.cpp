@@ -0,0 +1,27 @@
+//! AST canonicalization implementation
+
+#include <Sema/Canonicalizer.h>
+
+#include <utility>
+
+namespace toyc {
+
+void Canonicalizer::Rewrite(ExprPtr &expr) {
+  if (auto *e = llvm::dyn_cast<ParenExpr>(expr.get())) {
+    ExprPtr inner = std::move(e->expr_);
+    expr = std::move(inner);
+    removed_++;
+    return;
+  }
+  if (auto *e = llvm::dyn_cast<ImplicitCastExpr>(expr.get())) {
+    /// children are canonical already, so `(T)(T)x` reaches here as an
+    /// identity cast over `(T)x`
+    if (e->type_ == e->expr_->GetType()) {
+      ExprPtr inner = std::move(e->expr_);
+      expr = std::move(inner);
+      removed_++;
+    }
+  }
+}
+
+} // namespace toyc
@@ -0,0 +1,313 @@
+//! constant folding implementation
+
+#include <Sema/ConstantFolder.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace toyc {
+
+namespace {
+
+auto IsComparison(TokenTy op) -> bool {
+  switch (op) {
+  case EQ_OP:
+  case NE_OP:
+  case LE_OP:
+  case GE_OP:
+  case LT:
+  case GT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+auto ToDouble(const ConstantValue &value) -> double {
+  if (const auto *i = std::get_if<int64_t>(&value)) {
+    return static_cast<double>(*i);
+  }
+  return std::get<double>(value);
+}
+
+/// NaN is true, as in C
+auto IsTrue(const ConstantValue &value) -> bool {
+  if (const auto *i = std::get_if<int64_t>(&value)) {
+    return *i != 0;
+  }
+  return std::get<double>(value) != 0;
+}
+
+auto EvaluateCast(const std::string &type, const ConstantValue &value)
+    -> std::optional<ConstantValue> {
+  if (type == "f64") {
+    return ToDouble(value);
+  }
+  if (type == "i64") {
+    if (const auto *i = std::get_if<int64_t>(&value)) {
+      return *i;
+    }
+    /// out of range conversion from floating point is undefined
+    double d = std::get<double>(value);
+    constexpr double limit = 9223372036854775808.0; /// 2^63
+    if (std::isnan(d) || d >= limit || d < -limit) {
+      return std::nullopt;
+    }
+    return static_cast<int64_t>(d);
+  }
+  return std::nullopt;
+}
+
+auto EvaluateInteger(TokenTy op, int64_t l, int64_t r)
+    -> std::optional<int64_t> {
+  int64_t res;
+  switch (op) {
+  case ADD:
+    if (__builtin_add_overflow(l, r, &res)) {
+      return std::nullopt;
+    }
+    return res;
+  case SUB:
+    if (__builtin_sub_overflow(l, r, &res)) {
+      return std::nullopt;
+    }
+    return res;
+  case MUL:
+    if (__builtin_mul_overflow(l, r, &res)) {
+      return std::nullopt;
+    }
+    return res;
+  case DIV:
+  case MOD:
+    if (r == 0 || (l == std::numeric_limits<int64_t>::min() && r == -1)) {
+      return std::nullopt;
+    }
+    return op == DIV ? l / r : l % r;
+  case LEFT_OP:
+    if (r < 0 || r >= 64 || l < 0 ||
+        l > (std::numeric_limits<int64_t>::max() >> r)) {
+      return std::nullopt;
+    }
+    return l << r;
+  case RIGHT_OP:
+    if (r < 0 || r >= 64) {
+      return std::nullopt;
+    }
+    /// arithmetic shift, same as `ashr`
+    return l >> r;
+  case EQ_OP:
+    return l == r;
+  case NE_OP:
+    return l != r;
+  case LE_OP:
+    return l <= r;
+  case GE_OP:
+    return l >= r;
+  case LT:
+    return l < r;
+  case GT:
+    return l > r;
+  default:
+    return std::nullopt;
+  }
+}
+
+auto EvaluateFloating(TokenTy op, double l, double r)
+    -> std::optional<ConstantValue> {
+  switch (op) {
+  case ADD:
+    return l + r;
+  case SUB:
+    return l - r;
+  case MUL:
+    return l * r;
+  case DIV:
+    return l / r;
+  case MOD:
+    /// same as `frem`
+    return std::fmod(l, r);
+  case EQ_OP:
+    return static_cast<int64_t>(l == r);
+  case NE_OP:
+    /// `fcmp one` is false if either operand is NaN
+    return static_cast<int64_t>(l < r || l > r);
+  case LE_OP:
+    return static_cast<int64_t>(l <= r);
+  case GE_OP:
+    return static_cast<int64_t>(l >= r);
+  case LT:
+    return static_cast<int64_t>(l < r);
+  case GT:
+    return static_cast<int64_t>(l > r);
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace
+
+auto ConstantFolder::IsBooleanValued(const Expr &expr) -> bool {
+  if (const auto *e = llvm::dyn_cast<BinaryOperator>(&expr)) {
+    TokenTy op = e->op_.type_;
+    return IsComparison(op) || op == AND_OP || op == OR_OP;
+  }
+  if (const auto *e = llvm::dyn_cast<ParenExpr>(&expr)) {
+    return IsBooleanValued(*e->expr_);
+  }
+  /// identity casts are skipped by code generation
+  if (const auto *e = llvm::dyn_cast<ImplicitCastExpr>(&expr)) {
+    return e->type_ == e->expr_->GetType() && IsBooleanValued(*e->expr_);
+  }
+  return false;
+}
+
+auto ConstantFolder::Evaluate(const Expr &expr)
+    -> std::optional<ConstantValue> {
+  if (const auto *e = llvm::dyn_cast<IntegerLiteral>(&expr)) {
+    return e->value_;
+  }
+  if (const auto *e = llvm::dyn_cast<FloatingLiteral>(&expr)) {
+    return e->value_;
+  }
+  if (const auto *e = llvm::dyn_cast<ParenExpr>(&expr)) {
+    return Evaluate(*e->expr_);
+  }
+  if (const auto *e = llvm::dyn_cast<ImplicitCastExpr>(&expr)) {
+    auto value = Evaluate(*e->expr_);
+    if (!value) {
+      return std::nullopt;
+    }
+    if (e->type_ == e->expr_->GetType()) {
+      return value;
+    }
+    /// an `i1` operand is sign extended by `sitofp`, do not guess
+    if (IsBooleanValued(*e->expr_)) {
+      return std::nullopt;
+    }
+    return EvaluateCast(e->type_, *value);
+  }
+  if (const auto *e = llvm::dyn_cast<UnaryOperator>(&expr)) {
+    /// `!` lowers to a bitwise not, which differs from C for non-boolean
+    /// operands, so only `+` and `-` are evaluated
+    if (e->op_.type_ != ADD && e->op_.type_ != SUB) {
+      return std::nullopt;
+    }
+    if (IsBooleanValued(*e->expr_)) {
+      return std::nullopt;
+    }
+    auto value = Evaluate(*e->expr_);
+    if (!value || e->op_.type_ == ADD) {
+      return value;
+    }
+    if (const auto *i = std::get_if<int64_t>(&*value)) {
+      if (*i == std::numeric_limits<int64_t>::min()) {
+        return std::nullopt;
+      }
+      return -*i;
+    }
+    return -std::get<double>(*value);
+  }
+  if (const auto *e = llvm::dyn_cast<BinaryOperator>(&expr)) {
+    TokenTy op = e->op_.type_;
+    if (op == EQUAL) {
+      return std::nullopt;
+    }
+    auto l = Evaluate(*e->left_);
+    /// `&&` and `||` short-circuit, the right operand is dropped, side effects
+    /// included, when the left one decides
+    if (op == AND_OP || op == OR_OP) {
+      if (!l) {
+        return std::nullopt;
+      }
+      bool lv = IsTrue(*l);
+      if (lv == (op == OR_OP)) {
+        return static_cast<int64_t>(lv);
+      }
+      auto r = Evaluate(*e->right_);
+      if (!r) {
+        return std::nullopt;
+      }
+      return static_cast<int64_t>(IsTrue(*r));
+    }
+    auto r = Evaluate(*e->right_);
+    if (!l || !r) {
+      return std::nullopt;
+    }
+    if (IsBooleanValued(*e->left_) || IsBooleanValued(*e->right_)) {
+      return std::nullopt;
+    }
+    if (e->type_ == "f64") {
+      return EvaluateFloating(op, ToDouble(*l), ToDouble(*r));
+    }
+    if (e->type_ == "i64") {
+      const auto *li = std::get_if<int64_t>(&*l);
+      const auto *ri = std::get_if<int64_t>(&*r);
+      if (li == nullptr || ri == nullptr) {
+        return std::nullopt;
+      }
+      if (auto value = EvaluateInteger(op, *li, *ri)) {
+        return *value;
+      }
+    }
+    return std::nullopt;
+  }
+  if (const auto *e = llvm::dyn_cast<ConditionalOperator>(&expr)) {
+    auto cond = Evaluate(*e->cond_);
+    if (!cond) {
+      return std::nullopt;
+    }
+    /// only the selected arm is evaluated, an `i1` arm is widened to 0 or 1
+    auto value = Evaluate(IsTrue(*cond) ? *e->true_expr_ : *e->false_expr_);
+    if (value && e->type_ == "f64") {
+      return ToDouble(*value);
+    }
+    return value;
+  }
+  return std::nullopt;
+}
+
+void ConstantFolder::Rewrite(ExprPtr &expr) {
+  /// a constant condition selects its arm, even when the arms are not constant
+  if (auto *e = llvm::dyn_cast<ConditionalOperator>(expr.get())) {
+    if (e->cond_->IsConstant()) {
+      if (auto cond = Evaluate(*e->cond_)) {
+        ExprPtr &arm = IsTrue(*cond) ? e->true_expr_ : e->false_expr_;
+        if (!IsBooleanValued(*arm)) {
+          ExprPtr selected = std::move(arm);
+          expr = std::move(selected);
+          folded_++;
+          return;
+        }
+      }
+    }
+  }
+  if (llvm::isa<Literal>(expr.get()) || !expr->IsConstant()) {
+    return;
+  }
+  /// keep `i1` values, replacing them with `i64` literals changes IR types
+  if (IsBooleanValued(*expr)) {
+    return;
+  }
+  std::string type = expr->GetType();
+  if (type != "i64" && type != "f64") {
+    return;
+  }
+  auto value = Evaluate(*expr);
+  if (!value) {
+    return;
+  }
+  if (type == "i64") {
+    auto *i = std::get_if<int64_t>(&*value);
+    if (i == nullptr) {
+      return;
+    }
+    expr = MakeNode<IntegerLiteral>(expr->loc_, *i, "i64");
+  } else {
+    expr = MakeNode<FloatingLiteral>(expr->loc_, ToDouble(*value), "f64");
+  }
+  folded_++;
+}
+
+} // namespace toyc
@@ -0,0 +1,227 @@
+//! dead code elimination implementation
+
+#include <Sema/ConstantFolder.h>
+#include <Sema/DeadCodeEliminator.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace toyc {
+
+namespace {
+
+auto StripParens(Expr *expr) -> Expr * {
+  while (auto *e = llvm::dyn_cast<ParenExpr>(expr)) {
+    expr = e->expr_.get();
+  }
+  return expr;
+}
+
+/// @return the assignment if `stmt` is `x = value;` for a variable `x`
+auto GetAssignment(const ExprStmt &stmt) -> BinaryOperator * {
+  if (stmt.expr_ == nullptr) {
+    return nullptr;
+  }
+  auto *assign = llvm::dyn_cast<BinaryOperator>(StripParens(stmt.expr_.get()));
+  if (assign == nullptr || assign->op_.type_ != EQUAL ||
+      !llvm::isa<DeclRefExpr>(StripParens(assign->left_.get()))) {
+    return nullptr;
+  }
+  return assign;
+}
+
+auto GetAssignedName(const BinaryOperator &assign) -> std::string {
+  return llvm::cast<DeclRefExpr>(StripParens(assign.left_.get()))
+      ->decl_->GetName();
+}
+
+/**
+ * @brief Count declarations, references and removable assignments of the
+ * variables of a function body
+ */
+class LocalUseCollector : public ASTRewriter {
+public:
+  std::map<std::string, size_t> decls_;
+  /// declarations which sit directly in a block and can be dropped from it
+  std::map<std::string, size_t> block_decls_;
+  std::map<std::string, size_t> refs_;
+  /// references which are the target of an assignment statement in a block
+  std::map<std::string, size_t> stores_;
+  std::set<std::string> loop_vars_;
+
+protected:
+  void Rewrite(ExprPtr &expr) override {
+    if (auto *e = llvm::dyn_cast<DeclRefExpr>(expr.get())) {
+      refs_[e->decl_->GetName()]++;
+    }
+  }
+
+  void Rewrite(StmtPtr &stmt) override {
+    if (auto *s = llvm::dyn_cast<DeclStmt>(stmt.get())) {
+      decls_[s->decl_->GetName()]++;
+    } else if (auto *s = llvm::dyn_cast<ForStmt>(stmt.get())) {
+      loop_vars_.insert(s->init_->decl_->GetName());
+    } else if (auto *s = llvm::dyn_cast<CompoundStmt>(stmt.get())) {
+      for (auto &child : s->stmts_) {
+        if (auto *d = llvm::dyn_cast<DeclStmt>(child.get())) {
+          block_decls_[d->decl_->GetName()]++;
+        } else if (auto *e = llvm::dyn_cast<ExprStmt>(child.get())) {
+          if (auto *assign = GetAssignment(*e)) {
+            stores_[GetAssignedName(*assign)]++;
+          }
+        }
+      }
+    }
+  }
+};
+
+} // namespace
+
+void DeadCodeEliminator::CollectDeadLocals(FunctionDecl &decl) {
+  LocalUseCollector collector;
+  collector.Run(decl.body_);
+
+  std::set<std::string> params;
+  for (auto &param : decl.proto_->params_) {
+    params.insert(param->GetName());
+  }
+  /// names shared with a global or a parameter may refer to either, leave
+  /// them alone
+  for (auto &[name, count] : collector.decls_) {
+    if (globals_.contains(name) || params.contains(name) ||
+        collector.loop_vars_.contains(name)) {
+      continue;
+    }
+    if (collector.block_decls_[name] == count &&
+        collector.refs_[name] == collector.stores_[name]) {
+      dead_locals_.insert(name);
+    }
+  }
+}
+
+auto DeadCodeEliminator::Prune(StmtPtr &stmt) -> bool {
+  if (auto *s = llvm::dyn_cast<DeclStmt>(stmt.get())) {
+    auto *var = llvm::dyn_cast<VarDecl>(s->decl_.get());
+    if (var == nullptr || !dead_locals_.contains(var->GetName())) {
+      return false;
+    }
+    if (var->init_ != nullptr && var->init_->HasSideEffects()) {
+      ExprPtr init = std::move(var->init_);
+      stmt = MakeNode<ExprStmt>(stmt->loc_, std::move(init));
+      return false;
+    }
+    return true;
+  }
+  if (auto *s = llvm::dyn_cast<ExprStmt>(stmt.get())) {
+    auto *assign = GetAssignment(*s);
+    if (assign == nullptr || !dead_locals_.contains(GetAssignedName(*assign))) {
+      return false;
+    }
+    if (assign->right_->HasSideEffects()) {
+      ExprPtr value = std::move(assign->right_);
+      s->expr_ = std::move(value);
+      return false;
+    }
+    return true;
+  }
+  /// `if` with a constant condition and an `else` branch is already replaced
+  if (auto *s = llvm::dyn_cast<IfStmt>(stmt.get())) {
+    return ConstantCondition(*s->cond_) == false;
+  }
+  if (auto *s = llvm::dyn_cast<WhileStmt>(stmt.get())) {
+    return ConstantCondition(*s->cond_) == false;
+  }
+  return false;
+}
+
+auto DeadCodeEliminator::IsTerminator(const Stmt &stmt) -> bool {
+  if (llvm::isa<ReturnStmt, BreakStmt>(&stmt)) {
+    return true;
+  }
+  /// blocks are already pruned, a terminator can only be the last statement
+  if (const auto *s = llvm::dyn_cast<CompoundStmt>(&stmt)) {
+    return !s->stmts_.empty() && IsTerminator(*s->stmts_.back());
+  }
+  if (const auto *s = llvm::dyn_cast<IfStmt>(&stmt)) {
+    return s->else_stmt_ != nullptr && IsTerminator(*s->then_stmt_) &&
+           IsTerminator(*s->else_stmt_);
+  }
+  return false;
+}
+
+auto DeadCodeEliminator::ConstantCondition(const Expr &cond)
+    -> std::optional<bool> {
+  if (!cond.IsConstant()) {
+    return std::nullopt;
+  }
+  auto value = ConstantFolder::Evaluate(cond);
+  if (!value) {
+    return std::nullopt;
+  }
+  if (const auto *i = std::get_if<int64_t>(&*value)) {
+    return *i != 0;
+  }
+  return std::get<double>(*value) != 0;
+}
+
+void DeadCodeEliminator::Rewrite(StmtPtr &stmt) {
+  if (auto *s = llvm::dyn_cast<IfStmt>(stmt.get())) {
+    auto cond = ConstantCondition(*s->cond_);
+    if (!cond) {
+      return;
+    }
+    StmtPtr taken = std::move(*cond ? s->then_stmt_ : s->else_stmt_);
+    /// a false `if` without `else` is dropped by the enclosing block
+    if (taken != nullptr) {
+      stmt = std::move(taken);
+      removed_++;
+    }
+    return;
+  }
+  if (auto *s = llvm::dyn_cast<CompoundStmt>(stmt.get())) {
+    std::vector<StmtPtr> stmts;
+    bool reachable = true;
+    for (auto &child : s->stmts_) {
+      /// a label of a `switch` body is reached from the `switch` itself
+      if (llvm::isa<CaseStmt, DefaultStmt>(child.get())) {
+        reachable = true;
+      }
+      /// statements after a terminator can never run
+      if (!reachable || Prune(child)) {
+        removed_++;
+        continue;
+      }
+      stmts.push_back(std::move(child));
+      reachable = !IsTerminator(*stmts.back());
+    }
+    s->stmts_ = std::move(stmts);
+  }
+}
+
+void DeadCodeEliminator::Run(TranslationUnitDecl &unit) {
+  for (auto &decl : unit.decls_) {
+    if (auto *var = llvm::dyn_cast<VarDecl>(decl.get())) {
+      globals_.insert(var->GetName());
+    }
+  }
+  for (auto &decl : unit.decls_) {
+    Run(decl);
+  }
+}
+
+void DeadCodeEliminator::Run(DeclPtr &decl) {
+  if (auto *var = llvm::dyn_cast<VarDecl>(decl.get())) {
+    globals_.insert(var->GetName());
+  } else if (auto *func = llvm::dyn_cast<FunctionDecl>(decl.get())) {
+    if (func->body_ != nullptr) {
+      CollectDeadLocals(*func);
+    }
+  }
+  ASTRewriter::Run(decl);
+  dead_locals_.clear();
+}
+
+} // namespace toyc
@@ -0,0 +1,210 @@
+//! function attribute inference implementation
+
+#include <Sema/ASTRewriter.h>
+#include <Sema/FunctionAttrInference.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace toyc {
+
+namespace {
+
+/// unwrap expressions which do not change the referenced variable
+auto StripParensAndCasts(Expr *expr) -> Expr * {
+  for (;;) {
+    if (auto *e = llvm::dyn_cast<ParenExpr>(expr)) {
+      expr = e->expr_.get();
+    } else if (auto *e = llvm::dyn_cast<ImplicitCastExpr>(expr)) {
+      expr = e->expr_.get();
+    } else {
+      return expr;
+    }
+  }
+}
+
+/**
+ * @brief Record names referenced, assigned and called by a function body
+ */
+class EffectCollector : public ASTRewriter {
+public:
+  std::set<std::string> refs_;
+  std::set<std::string> assigned_;
+  std::set<std::string> callees_;
+  bool has_loop_{false};
+
+private:
+  void Assign(Expr *target) {
+    if (auto *ref = llvm::dyn_cast<DeclRefExpr>(StripParensAndCasts(target))) {
+      assigned_.insert(ref->decl_->GetName());
+    }
+  }
+
+protected:
+  void Rewrite(ExprPtr &expr) override {
+    if (auto *e = llvm::dyn_cast<DeclRefExpr>(expr.get())) {
+      refs_.insert(e->decl_->GetName());
+    } else if (auto *e = llvm::dyn_cast<CallExpr>(expr.get())) {
+      callees_.insert(e->callee_->decl_->GetName());
+    } else if (auto *e = llvm::dyn_cast<BinaryOperator>(expr.get())) {
+      if (e->op_.type_ == EQUAL) {
+        Assign(e->left_.get());
+      }
+    } else if (auto *e = llvm::dyn_cast<UnaryOperator>(expr.get())) {
+      if (e->op_.type_ == INC_OP || e->op_.type_ == DEC_OP) {
+        Assign(e->expr_.get());
+      }
+    }
+  }
+
+  void Rewrite(StmtPtr &stmt) override {
+    if (llvm::isa<WhileStmt, ForStmt>(stmt.get())) {
+      has_loop_ = true;
+    }
+  }
+};
+
+} // namespace
+
+auto FunctionAttrInference::Collect(FunctionDecl &decl) -> FunctionInfo {
+  EffectCollector collector;
+  collector.Run(decl.body_);
+
+  /// parameters always shadow globals, locals may be declared after a use
+  /// of the global with the same name, so they are treated as globals
+  std::set<std::string> params;
+  for (auto &param : decl.proto_->params_) {
+    params.insert(param->GetName());
+  }
+  auto is_global = [&](const std::string &name) {
+    return globals_.contains(name) && !params.contains(name);
+  };
+
+  FunctionInfo info;
+  info.callees_ = std::move(collector.callees_);
+  info.has_loop_ = collector.has_loop_;
+  info.reads_global_ = std::ranges::any_of(collector.refs_, is_global);
+  info.writes_global_ = std::ranges::any_of(collector.assigned_, is_global);
+  return info;
+}
+
+void FunctionAttrInference::InferSCC(
+    const std::vector<std::string> &scc,
+    std::map<std::string, FunctionInfo> &infos) {
+  FunctionAttrs attrs;
+  attrs.readnone_ = true;
+  attrs.readonly_ = true;
+  attrs.nounwind_ = true;
+  attrs.willreturn_ = true;
+  attrs.norecurse_ =
+      scc.size() == 1 && !infos[scc[0]].callees_.contains(scc[0]);
+
+  std::set<std::string> members(scc.begin(), scc.end());
+  for (const auto &name : scc) {
+    auto &info = infos[name];
+    if (info.writes_global_) {
+      attrs.readnone_ = false;
+      attrs.readonly_ = false;
+    }
+    if (info.reads_global_) {
+      attrs.readnone_ = false;
+    }
+    /// loops are not proven to terminate
+    if (info.has_loop_) {
+      attrs.willreturn_ = false;
+    }
+    for (const auto &callee : info.callees_) {
+      /// members of the same SCC are optimistically assumed to agree
+      if (members.contains(callee)) {
+        continue;
+      }
+      auto it = attrs_.find(callee);
+      if (it == attrs_.end()) {
+        attrs = FunctionAttrs{};
+        break;
+      }
+      attrs.readnone_ &= it->second.readnone_;
+      attrs.readonly_ &= it->second.readonly_;
+      attrs.nounwind_ &= it->second.nounwind_;
+      attrs.willreturn_ &= it->second.willreturn_;
+    }
+  }
+  /// recursion is not proven to terminate either
+  if (!attrs.norecurse_) {
+    attrs.willreturn_ = false;
+  }
+  for (const auto &name : scc) {
+    attrs_[name] = attrs;
+  }
+}
+
+void FunctionAttrInference::Run(TranslationUnitDecl &unit) {
+  std::map<std::string, FunctionInfo> infos;
+  for (auto &decl : unit.decls_) {
+    if (auto *var = llvm::dyn_cast<VarDecl>(decl.get())) {
+      globals_.insert(var->GetName());
+    }
+  }
+  for (auto &decl : unit.decls_) {
+    if (auto *func = llvm::dyn_cast<FunctionDecl>(decl.get())) {
+      if (func->GetKind() == DEFINITION && func->body_ != nullptr) {
+        infos[func->GetName()] = Collect(*func);
+      }
+    }
+  }
+
+  /// Tarjan's algorithm, SCCs come out callees first
+  std::map<std::string, size_t> index;
+  std::map<std::string, size_t> lowlink;
+  std::set<std::string> on_stack;
+  std::vector<std::string> stack;
+  std::function<void(const std::string &)> connect =
+      [&](const std::string &name) {
+        index[name] = lowlink[name] = index.size();
+        stack.push_back(name);
+        on_stack.insert(name);
+        for (const auto &callee : infos[name].callees_) {
+          if (!infos.contains(callee)) {
+            continue;
+          }
+          if (!index.contains(callee)) {
+            connect(callee);
+            lowlink[name] = std::min(lowlink[name], lowlink[callee]);
+          } else if (on_stack.contains(callee)) {
+            lowlink[name] = std::min(lowlink[name], index[callee]);
+          }
+        }
+        if (lowlink[name] == index[name]) {
+          std::vector<std::string> scc;
+          std::string member;
+          do {
+            member = stack.back();
+            stack.pop_back();
+            on_stack.erase(member);
+            scc.push_back(member);
+          } while (member != name);
+          InferSCC(scc, infos);
+        }
+      };
+  for (auto &[name, info] : infos) {
+    if (!index.contains(name)) {
+      connect(name);
+    }
+  }
+}
+
+void FunctionAttrInference::Run(DeclPtr &decl) {
+  if (auto *var = llvm::dyn_cast<VarDecl>(decl.get())) {
+    globals_.insert(var->GetName());
+  } else if (auto *func = llvm::dyn_cast<FunctionDecl>(decl.get())) {
+    if (func->GetKind() == DEFINITION && func->body_ != nullptr) {
+      std::map<std::string, FunctionInfo> infos;
+      infos[func->GetName()] = Collect(*func);
+      InferSCC({func->GetName()}, infos);
+    } else {
+      attrs_.erase(func->GetName());
+    }
+  }
+}
+
+} // namespace toyc
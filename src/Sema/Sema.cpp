@@ -23,13 +23,13 @@ auto Sema::CheckBinaryOperator(ExprPtr &lhs, ExprPtr &rhs, TokenTy type)
     return "i64";
   }
   if (lhs->GetType() == rhs->GetType()) {
-    lhs = std::make_unique<ImplicitCastExpr>(lhs->GetType(), std::move(lhs));
-    rhs = std::make_unique<ImplicitCastExpr>(rhs->GetType(), std::move(rhs));
+    lhs = MakeNode<ImplicitCastExpr>(lhs->loc_, lhs->GetType(), std::move(lhs));
+    rhs = MakeNode<ImplicitCastExpr>(rhs->loc_, rhs->GetType(), std::move(rhs));
     return lhs->GetType();
   }
   if (lhs->GetType() == "f64" || rhs->GetType() == "f64") {
-    lhs = std::make_unique<ImplicitCastExpr>("f64", std::move(lhs));
-    rhs = std::make_unique<ImplicitCastExpr>("f64", std::move(rhs));
+    lhs = MakeNode<ImplicitCastExpr>(lhs->loc_, "f64", std::move(lhs));
+    rhs = MakeNode<ImplicitCastExpr>(rhs->loc_, "f64", std::move(rhs));
     return "f64";
   }
   return "i64";
@@ -43,4 +43,20 @@ auto Sema::CheckShiftOperator(ExprPtr &lhs, ExprPtr &rhs, TokenTy type)
   return "i64";
 }
 
+auto Sema::CheckConditionalOperator(ExprPtr &lhs, ExprPtr &rhs)
+    -> std::string {
+  auto arithmetic = [](const ExprPtr &arm) {
+    return arm->GetType() == "i64" || arm->GetType() == "f64";
+  };
+  if (!arithmetic(lhs) || !arithmetic(rhs)) {
+    return "";
+  }
+  if (lhs->GetType() == rhs->GetType()) {
+    return lhs->GetType();
+  }
+  ExprPtr &arm = lhs->GetType() == "f64" ? rhs : lhs;
+  arm = MakeNode<ImplicitCastExpr>(arm->loc_, "f64", std::move(arm));
+  return "f64";
+}
+
 } // namespace toyc
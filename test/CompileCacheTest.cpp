@@ -0,0 +1,123 @@
+#include <Compiler/CompileCache.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+
+namespace toyc {
+
+class CompileCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("toyc-cache", dir_));
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(dir_); }
+
+  /// entries live in `<dir>/<first 2 hex digits>/<key>`
+  auto GetEntryPath(const std::string &key) -> std::string {
+    llvm::SmallString<128> path(dir_);
+    llvm::sys::path::append(path, key.substr(0, 2), key);
+    return path.str().str();
+  }
+
+  /// make the entry of `key` look last used `age` seconds ago
+  void SetAge(const std::string &key, int age) {
+    int fd = -1;
+    ASSERT_FALSE(llvm::sys::fs::openFileForWrite(
+        GetEntryPath(key), fd, llvm::sys::fs::CD_OpenExisting,
+        llvm::sys::fs::OF_Append));
+    llvm::sys::fs::setLastAccessAndModificationTime(
+        fd, std::chrono::system_clock::now() - std::chrono::seconds(age));
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+
+  llvm::SmallString<128> dir_;
+};
+
+TEST_F(CompileCacheTest, HashKey) {
+  std::string key = CompileCache::HashKey({"a", "bc"});
+  EXPECT_EQ(key.size(), 64);
+  EXPECT_EQ(key, CompileCache::HashKey({"a", "bc"}));
+  /// moving text between parts or adding an empty one is another key
+  EXPECT_NE(key, CompileCache::HashKey({"ab", "c"}));
+  EXPECT_NE(key, CompileCache::HashKey({"a", "bc", ""}));
+  EXPECT_NE(key, CompileCache::HashKey({"a", "bd"}));
+}
+
+TEST_F(CompileCacheTest, FetchAfterStore) {
+  CompileCache cache(dir_.str().str(), 1024);
+  std::string key = CompileCache::HashKey({"fetch"});
+  std::string output;
+  llvm::raw_string_ostream os(output);
+
+  EXPECT_FALSE(cache.Fetch(key, os));
+  cache.Store(key, "; ModuleID = 'a.toyc'\n");
+  EXPECT_TRUE(cache.Fetch(key, os));
+  EXPECT_EQ(os.str(), "; ModuleID = 'a.toyc'\n");
+
+  CacheStats stats = cache.GetStats();
+  EXPECT_EQ(stats.hits_, 1);
+  EXPECT_EQ(stats.misses_, 1);
+  EXPECT_EQ(stats.size_, 22);
+}
+
+TEST_F(CompileCacheTest, CountMisses) {
+  CompileCache cache(dir_.str().str(), 1024);
+  std::string output;
+  llvm::raw_string_ostream os(output);
+  EXPECT_FALSE(cache.Fetch(CompileCache::HashKey({"a"}), os));
+  EXPECT_FALSE(cache.Fetch(CompileCache::HashKey({"b"}), os));
+  EXPECT_TRUE(os.str().empty());
+
+  /// the counters are kept in the directory, not in the object
+  CacheStats stats = CompileCache(dir_.str().str(), 1024).GetStats();
+  EXPECT_EQ(stats.hits_, 0);
+  EXPECT_EQ(stats.misses_, 2);
+  EXPECT_EQ(stats.size_, 0);
+}
+
+TEST_F(CompileCacheTest, StoreReplacesEntry) {
+  CompileCache cache(dir_.str().str(), 1024);
+  std::string key = CompileCache::HashKey({"replace"});
+  cache.Store(key, std::string(100, 'a'));
+  cache.Store(key, std::string(100, 'a'));
+  EXPECT_EQ(cache.GetStats().size_, 100);
+  cache.Store(key, std::string(40, 'b'));
+  EXPECT_EQ(cache.GetStats().size_, 40);
+}
+
+TEST_F(CompileCacheTest, EvictLeastRecentlyUsed) {
+  CompileCache cache(dir_.str().str(), 1000);
+  std::string a = CompileCache::HashKey({"a"});
+  std::string b = CompileCache::HashKey({"b"});
+  std::string c = CompileCache::HashKey({"c"});
+  std::string d = CompileCache::HashKey({"d"});
+  cache.Store(a, std::string(300, 'a'));
+  cache.Store(b, std::string(300, 'b'));
+  cache.Store(c, std::string(300, 'c'));
+  SetAge(a, 30);
+  SetAge(b, 20);
+  SetAge(c, 10);
+
+  /// a hit makes `a` the most recently used, so `b` is the oldest
+  std::string output;
+  llvm::raw_string_ostream os(output);
+  EXPECT_TRUE(cache.Fetch(a, os));
+
+  /// 1200 bytes are over the limit, the oldest go until 90% of it is left
+  cache.Store(d, std::string(300, 'd'));
+  EXPECT_TRUE(llvm::sys::fs::exists(GetEntryPath(a)));
+  EXPECT_FALSE(llvm::sys::fs::exists(GetEntryPath(b)));
+  EXPECT_TRUE(llvm::sys::fs::exists(GetEntryPath(c)));
+  EXPECT_TRUE(llvm::sys::fs::exists(GetEntryPath(d)));
+  EXPECT_EQ(cache.GetStats().size_, 900);
+}
+
+} // namespace toyc
@@ -1,7 +1,14 @@
+#include <AST/ASTPrint.h>
+#include <AST/FlatAST.h>
 #include <Parser/Parser.h>
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <functional>
+#include <regex>
+#include <vector>
+
 namespace toyc {
 
 class ParserTest : public testing::Test {
@@ -11,6 +18,37 @@ protected:
     path_prefix_ = "../test/Unit/Parser/";
   }
 
+  auto ParseFile(const std::string &name)
+      -> std::unique_ptr<TranslationUnitDecl> {
+    std::string file = path_prefix_ + name;
+    EXPECT_TRUE(ReadFrom(file, input_));
+    parser_.AddInput(input_);
+    return parser_.Parse();
+  }
+
+  /// the message of the error parsing `name` throws, empty if it parses
+  auto GetParseError(const std::string &name) -> std::string {
+    try {
+      ParseFile(name);
+    } catch (const ParserException &e) {
+      return e.what();
+    }
+    return "";
+  }
+
+  void ExpectParseError(const std::string &name, const std::string &msg) {
+    EXPECT_NE(GetParseError(name).find(msg), std::string::npos) << msg;
+  }
+
+  /// run `check` on the parsed tree and on its flat round trip
+  void CheckTreeAndFlat(
+      const std::string &name,
+      const std::function<void(const TranslationUnitDecl &)> &check) {
+    auto unit = ParseFile(name);
+    check(*unit);
+    check(*FlatAST::Flatten(*unit).Expand());
+  }
+
   Parser parser_;
   std::string input_;
 
@@ -18,30 +56,16 @@ protected:
 };
 
 TEST_F(ParserTest, PrimaryExprError) {
-  std::string file = path_prefix_ + "simple.toyc";
-  ASSERT_TRUE(ReadFrom(file, input_));
-  parser_.AddInput(input_);
-
-  std::string err;
   std::string err_info =
       "\033[1;37mline:4:col:11:\033[0m \033[1;31merror:\033[0m \033[1;37mparse "
       "primary expression error\033[0m";
-  try {
-    parser_.Parse();
-  } catch (ParserException e) {
-    err = e.what();
-  }
-  EXPECT_EQ(err, err_info);
+  EXPECT_EQ(GetParseError("simple.toyc"), err_info);
 }
 
 TEST_F(ParserTest, AssignExpr) {
-  std::string file = path_prefix_ + "assign.toyc";
-  std::string ast_file = path_prefix_ + "assign_ast.txt";
   std::string ast;
-  ASSERT_TRUE(ReadFrom(file, input_) && ReadFrom(ast_file, ast));
-  parser_.AddInput(input_);
-
-  auto translation_unit = parser_.Parse();
+  ASSERT_TRUE(ReadFrom(path_prefix_ + "assign_ast.txt", ast));
+  auto translation_unit = ParseFile("assign.toyc");
   std::stringstream ss;
   translation_unit->Dump(ss);
   std::cout << ss.str();
@@ -49,4 +73,167 @@ TEST_F(ParserTest, AssignExpr) {
   EXPECT_EQ(ss.str(), ast);
 }
 
+TEST_F(ParserTest, FlatAST) {
+  std::string ast;
+  ASSERT_TRUE(ReadFrom(path_prefix_ + "assign_ast.txt", ast));
+  auto translation_unit = ParseFile("assign.toyc");
+  auto flat_ast = FlatAST::Flatten(*translation_unit);
+  /// both references to `i` share one declaration
+  EXPECT_EQ(flat_ast.GetAll<FlatDeclRefExpr>().size(), 2);
+  EXPECT_EQ(flat_ast.GetAll<FlatVarDecl>().size(), 2);
+
+  std::stringstream ss;
+  flat_ast.Expand()->Dump(ss);
+  EXPECT_EQ(ss.str(), ast);
+}
+
+TEST_F(ParserTest, SourceLocations) {
+  /// locations survive the flat encoding
+  CheckTreeAndFlat("assign.toyc", [](const TranslationUnitDecl &unit) {
+    const auto &func = llvm::cast<FunctionDecl>(*unit.decls_[0]);
+    EXPECT_EQ(func.loc_, SourceLoc(1, 5));
+    const auto &body = llvm::cast<CompoundStmt>(*func.body_);
+    const auto &decl_stmt = llvm::cast<DeclStmt>(*body.stmts_[0]);
+    EXPECT_EQ(decl_stmt.loc_, SourceLoc(2, 3));
+    EXPECT_EQ(decl_stmt.decl_->loc_, SourceLoc(2, 7));
+    const auto &expr_stmt = llvm::cast<ExprStmt>(*body.stmts_[1]);
+    EXPECT_EQ(expr_stmt.loc_, SourceLoc(3, 3));
+    const auto &assign = llvm::cast<BinaryOperator>(*expr_stmt.expr_);
+    EXPECT_EQ(assign.loc_, SourceLoc(3, 5));
+    EXPECT_EQ(assign.left_->loc_, SourceLoc(3, 3));
+    const auto &add = llvm::cast<BinaryOperator>(*assign.right_);
+    EXPECT_EQ(add.loc_, SourceLoc(3, 9));
+    /// implicit casts sit where their operands are
+    EXPECT_EQ(add.right_->loc_, SourceLoc(3, 11));
+  });
+}
+
+TEST_F(ParserTest, SwitchStmt) {
+  CheckTreeAndFlat("switch.toyc", [](const TranslationUnitDecl &unit) {
+    const auto &func = llvm::cast<FunctionDecl>(*unit.decls_[0]);
+    const auto &body = llvm::cast<CompoundStmt>(*func.body_);
+    const auto &stmt = llvm::cast<SwitchStmt>(*body.stmts_[0]);
+    EXPECT_EQ(stmt.loc_, SourceLoc(2, 3));
+    EXPECT_TRUE(llvm::isa<DeclRefExpr>(*stmt.cond_));
+    /// labels sit among the statements of the body
+    const auto &stmts = llvm::cast<CompoundStmt>(*stmt.body_).stmts_;
+    std::vector<NodeKind> kinds;
+    for (const auto &child : stmts) {
+      kinds.push_back(child->GetNodeKind());
+    }
+    EXPECT_EQ(kinds, (std::vector<NodeKind>{CASE_STMT, RETURN_STMT, CASE_STMT,
+                                            CASE_STMT, EXPR_STMT, BREAK_STMT,
+                                            DEFAULT_STMT, RETURN_STMT}));
+    ASSERT_EQ(stmts.size(), 8);
+    const auto &label = llvm::cast<CaseStmt>(*stmts[2]);
+    EXPECT_EQ(label.loc_, SourceLoc(5, 3));
+    EXPECT_TRUE(label.value_->IsConstant());
+  });
+}
+
+TEST_F(ParserTest, CaseOutsideSwitch) {
+  ExpectParseError("case.toyc", "'case' label not within a switch body");
+}
+
+TEST_F(ParserTest, ConditionalExpr) {
+  CheckTreeAndFlat("conditional.toyc", [](const TranslationUnitDecl &unit) {
+    const auto &func = llvm::cast<FunctionDecl>(*unit.decls_[0]);
+    const auto &body = llvm::cast<CompoundStmt>(*func.body_);
+    const auto &ret = llvm::cast<ReturnStmt>(*body.stmts_[0]);
+    const auto &expr = llvm::cast<ConditionalOperator>(*ret.expr_);
+    EXPECT_EQ(expr.loc_, SourceLoc(2, 16));
+    EXPECT_EQ(expr.GetType(), "f64");
+    /// the `i64` arm is converted to the common type
+    EXPECT_TRUE(llvm::isa<ImplicitCastExpr>(*expr.true_expr_));
+    /// `?:` groups to the right
+    const auto &nested = llvm::cast<ConditionalOperator>(*expr.false_expr_);
+    EXPECT_EQ(nested.GetType(), "f64");
+    EXPECT_TRUE(llvm::isa<DeclRefExpr>(*nested.true_expr_));
+    EXPECT_TRUE(llvm::isa<ImplicitCastExpr>(*nested.false_expr_));
+  });
+}
+
+TEST_F(ParserTest, DeclSpecifiers) {
+  CheckTreeAndFlat("static.toyc", [](const TranslationUnitDecl &unit) {
+    ASSERT_EQ(unit.decls_.size(), 3);
+    EXPECT_TRUE(llvm::cast<VarDecl>(*unit.decls_[0]).IsStatic());
+    const auto &next = llvm::cast<FunctionDecl>(*unit.decls_[1]);
+    EXPECT_TRUE(next.IsStatic());
+    EXPECT_TRUE(next.IsInline());
+    const auto &half = llvm::cast<FunctionDecl>(*unit.decls_[2]);
+    EXPECT_FALSE(half.IsStatic());
+    EXPECT_TRUE(half.IsInline());
+  });
+  /// parameters take no storage class, `extern` included
+  ExpectParseError("extern_param.toyc",
+                   "invalid storage class specifier in function declarator");
+}
+
+TEST_F(ParserTest, ConstAssign) {
+  ExpectParseError(
+      "const.toyc",
+      "cannot assign to variable 'limit' with const-qualified type");
+}
+
+TEST_F(ParserTest, ConstLoopVariable) {
+  /// the `const` of a loop variable ends with the loop
+  CheckTreeAndFlat("const_loop.toyc", [](const TranslationUnitDecl &unit) {
+    const auto &func = llvm::cast<FunctionDecl>(*unit.decls_[0]);
+    const auto &body = llvm::cast<CompoundStmt>(*func.body_);
+    ASSERT_EQ(body.stmts_.size(), 5);
+    const auto &decl_stmt = llvm::cast<DeclStmt>(*body.stmts_[2]);
+    EXPECT_FALSE(llvm::cast<VarDecl>(*decl_stmt.decl_).IsConst());
+    EXPECT_TRUE(llvm::isa<ExprStmt>(*body.stmts_[3]));
+  });
+}
+
+TEST_F(ParserTest, FlatASTSaveLoad) {
+  std::string ast;
+  ASSERT_TRUE(ReadFrom(path_prefix_ + "assign_ast.txt", ast));
+  auto translation_unit = ParseFile("assign.toyc");
+  std::string bin_file = path_prefix_ + "assign.toyc.ast";
+  ASSERT_TRUE(FlatAST::Flatten(*translation_unit).Save(bin_file));
+
+  auto flat_ast = FlatAST::Load(bin_file);
+  std::remove(bin_file.c_str());
+  ASSERT_TRUE(flat_ast.has_value());
+  EXPECT_EQ(flat_ast->GetAll<FlatDeclRefExpr>().size(), 2);
+
+  std::stringstream ss;
+  flat_ast->Expand()->Dump(ss);
+  EXPECT_EQ(ss.str(), ast);
+
+  /// not an AST file
+  EXPECT_FALSE(FlatAST::Load(path_prefix_ + "assign.toyc").has_value());
+}
+
+TEST_F(ParserTest, ASTDumpFormats) {
+  std::string ast;
+  std::string json;
+  ASSERT_TRUE(ReadFrom(path_prefix_ + "assign_ast.txt", ast) &&
+              ReadFrom(path_prefix_ + "assign_ast.json", json));
+  auto translation_unit = ParseFile("assign.toyc");
+
+  /// the colorless tree is the colored one without escape sequences
+  std::string text;
+  llvm::raw_string_ostream text_os(text);
+  ASTDumper(text_os).Dump(*translation_unit);
+  std::regex escape("\033\\[[0-9;]*m");
+  EXPECT_EQ(text_os.str(), std::regex_replace(ast, escape, ""));
+
+  std::string output;
+  llvm::raw_string_ostream json_os(output);
+  ASTDumper(json_os, JSON_DUMP).Dump(*translation_unit);
+  EXPECT_EQ(json_os.str(), json);
+
+  /// magic, version 5 and one root, then the FunctionDecl
+  std::string binary;
+  llvm::raw_string_ostream binary_os(binary);
+  ASTDumper(binary_os, BINARY_DUMP).Dump(*translation_unit);
+  binary_os.flush();
+  ASSERT_GT(binary.size(), 11);
+  EXPECT_EQ(binary.substr(0, 11), std::string("TOYCDUMP\x05\x01") +
+                                      static_cast<char>(FUNCTION_DECL));
+}
+
 } // namespace toyc
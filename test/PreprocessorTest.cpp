@@ -39,4 +39,15 @@ TEST_F(PreprocessorTest, Include) {
   EXPECT_EQ(expected_, actually_);
 }
 
+TEST_F(PreprocessorTest, PrecompiledInclude) {
+  std::string file = path_prefix_ + "include.toyc";
+  ASSERT_TRUE(ReadFrom(file, input_));
+  processor_.SetInput(input_);
+  processor_.SetPrecompiledIncludes(true);
+  actually_ = processor_.Process();
+  EXPECT_EQ(actually_, "\n\ni64 main() {\n  return 0;\n}");
+  ASSERT_EQ(processor_.GetIncludes().size(), 1);
+  EXPECT_TRUE(processor_.GetIncludes()[0].ends_with("/include/io.toyc"));
+}
+
 } // namespace toyc
@@ -0,0 +1,187 @@
+#include <Parser/Parser.h>
+#include <Sema/Canonicalizer.h>
+#include <Sema/ConstantFolder.h>
+#include <Sema/DeadCodeEliminator.h>
+#include <Sema/FunctionAttrInference.h>
+
+#include <llvm/Support/Casting.h>
+
+#include <gtest/gtest.h>
+
+namespace toyc {
+
+class SemaTest : public testing::Test {
+protected:
+  void SetUp() override { path_prefix_ = "../test/Unit/Sema/"; }
+
+  auto ParseFile(const std::string &name)
+      -> std::unique_ptr<TranslationUnitDecl> {
+    std::string file = path_prefix_ + name;
+    EXPECT_TRUE(ReadFrom(file, input_));
+    parser_.AddInput(input_);
+    return parser_.Parse();
+  }
+
+  static auto GetBody(TranslationUnitDecl &unit, size_t idx)
+      -> CompoundStmt * {
+    auto *func = llvm::cast<FunctionDecl>(unit.decls_[idx].get());
+    return llvm::cast<CompoundStmt>(func->body_.get());
+  }
+
+  static auto GetInit(TranslationUnitDecl &unit, size_t idx) -> Expr * {
+    return llvm::cast<VarDecl>(unit.decls_[idx].get())->init_.get();
+  }
+
+  Parser parser_;
+  std::string input_;
+
+  std::string path_prefix_;
+};
+
+TEST_F(SemaTest, ConstantFolding) {
+  auto unit = ParseFile("fold.toyc");
+  ConstantFolder folder;
+  folder.Run(*unit);
+
+  auto *a = llvm::dyn_cast<IntegerLiteral>(GetInit(*unit, 0));
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->value_, 7);
+
+  auto *b = llvm::dyn_cast<FloatingLiteral>(GetInit(*unit, 1));
+  ASSERT_NE(b, nullptr);
+  EXPECT_DOUBLE_EQ(b->value_, 1.5);
+
+  /// signed overflow and division by zero are left to the runtime
+  EXPECT_TRUE(llvm::isa<BinaryOperator>(GetInit(*unit, 2)));
+  EXPECT_TRUE(llvm::isa<BinaryOperator>(GetInit(*unit, 3)));
+
+  auto *e = llvm::dyn_cast<IntegerLiteral>(GetInit(*unit, 4));
+  ASSERT_NE(e, nullptr);
+  EXPECT_EQ(e->value_, 19);
+
+  /// conversion truncates toward zero
+  auto *f = llvm::dyn_cast<IntegerLiteral>(GetInit(*unit, 5));
+  ASSERT_NE(f, nullptr);
+  EXPECT_EQ(f->value_, 7);
+
+  /// comparisons keep their `i1` form but can still be evaluated
+  auto *main = llvm::cast<FunctionDecl>(unit->decls_[6].get());
+  auto *body = llvm::cast<CompoundStmt>(main->body_.get());
+  auto *if_stmt = llvm::cast<IfStmt>(body->stmts_[0].get());
+  ASSERT_TRUE(llvm::isa<BinaryOperator>(if_stmt->cond_.get()));
+  auto cond = ConstantFolder::Evaluate(*if_stmt->cond_);
+  ASSERT_TRUE(cond.has_value());
+  EXPECT_EQ(std::get<int64_t>(*cond), 1);
+
+  /// `&&` tests operands against zero and skips the right one when the left
+  /// one decides
+  auto g = ConstantFolder::Evaluate(*GetInit(*unit, 7));
+  ASSERT_TRUE(g.has_value());
+  EXPECT_EQ(std::get<int64_t>(*g), 1);
+  auto h = ConstantFolder::Evaluate(*GetInit(*unit, 8));
+  ASSERT_TRUE(h.has_value());
+  EXPECT_EQ(std::get<int64_t>(*h), 0);
+
+  EXPECT_GT(folder.GetFolded(), 0);
+}
+
+TEST_F(SemaTest, Canonicalization) {
+  auto unit = ParseFile("canonical.toyc");
+  Canonicalizer canonicalizer;
+  canonicalizer.Run(*unit);
+
+  auto *func = llvm::cast<FunctionDecl>(unit->decls_[0].get());
+  auto *body = llvm::cast<CompoundStmt>(func->body_.get());
+  auto *ret = llvm::cast<ReturnStmt>(body->stmts_[0].get());
+
+  /// `((x + 1)) * (x)` without parentheses and identity casts
+  auto *mul = llvm::dyn_cast<BinaryOperator>(ret->expr_.get());
+  ASSERT_NE(mul, nullptr);
+  auto *add = llvm::dyn_cast<BinaryOperator>(mul->left_.get());
+  ASSERT_NE(add, nullptr);
+  EXPECT_TRUE(llvm::isa<DeclRefExpr>(add->left_.get()));
+  EXPECT_TRUE(llvm::isa<IntegerLiteral>(add->right_.get()));
+  EXPECT_TRUE(llvm::isa<DeclRefExpr>(mul->right_.get()));
+
+  /// 3 parentheses and 4 casts
+  EXPECT_EQ(canonicalizer.GetRemoved(), 7);
+}
+
+TEST_F(SemaTest, DeadCodeElimination) {
+  auto unit = ParseFile("dce.toyc");
+  DeadCodeEliminator eliminator;
+  eliminator.Run(*unit);
+
+  /// nothing follows a return
+  auto *after_return = GetBody(*unit, 2);
+  ASSERT_EQ(after_return->stmts_.size(), 1);
+  EXPECT_TRUE(llvm::isa<ReturnStmt>(after_return->stmts_[0].get()));
+
+  /// the taken branch replaces the `if`, dead `if` and `while` are gone
+  auto *constant_cond = GetBody(*unit, 3);
+  ASSERT_EQ(constant_cond->stmts_.size(), 2);
+  EXPECT_TRUE(llvm::isa<CompoundStmt>(constant_cond->stmts_[0].get()));
+  EXPECT_TRUE(llvm::isa<ReturnStmt>(constant_cond->stmts_[1].get()));
+
+  /// `a` and `b` are never read, only the calls survive
+  auto *unused_locals = GetBody(*unit, 4);
+  ASSERT_EQ(unused_locals->stmts_.size(), 4);
+  for (size_t i = 0; i < 2; i++) {
+    auto *stmt = llvm::dyn_cast<ExprStmt>(unused_locals->stmts_[i].get());
+    ASSERT_NE(stmt, nullptr);
+    EXPECT_TRUE(stmt->expr_->HasSideEffects());
+  }
+  EXPECT_TRUE(llvm::isa<DeclStmt>(unused_locals->stmts_[2].get()));
+
+  /// code after `return` and `break` is dead up to the next label
+  auto *labels = GetBody(*unit, 5);
+  auto *switch_stmt = llvm::dyn_cast<SwitchStmt>(labels->stmts_[0].get());
+  ASSERT_NE(switch_stmt, nullptr);
+  auto *switch_body = llvm::cast<CompoundStmt>(switch_stmt->body_.get());
+  ASSERT_EQ(switch_body->stmts_.size(), 7);
+  EXPECT_TRUE(llvm::isa<CaseStmt>(switch_body->stmts_[2].get()));
+  EXPECT_TRUE(llvm::isa<DefaultStmt>(switch_body->stmts_[5].get()));
+
+  /// 2 after return, if-else, if, while, `a = 1`, `a = 2`, `g = 5`, `g = 7`
+  EXPECT_EQ(eliminator.GetRemoved(), 9);
+}
+
+TEST_F(SemaTest, FunctionAttrInference) {
+  auto unit = ParseFile("attrs.toyc");
+  FunctionAttrInference inference;
+  inference.Run(*unit);
+  const auto &attrs = inference.GetAttrs();
+
+  auto square = attrs.at("square");
+  EXPECT_TRUE(square.readnone_);
+  EXPECT_TRUE(square.nounwind_);
+  EXPECT_TRUE(square.norecurse_);
+  EXPECT_TRUE(square.willreturn_);
+
+  auto get = attrs.at("get");
+  EXPECT_FALSE(get.readnone_);
+  EXPECT_TRUE(get.readonly_);
+  EXPECT_TRUE(get.willreturn_);
+
+  auto set = attrs.at("set");
+  EXPECT_FALSE(set.readonly_);
+  EXPECT_TRUE(set.nounwind_);
+
+  /// recursion and loops are not proven to terminate
+  auto fib = attrs.at("fib");
+  EXPECT_TRUE(fib.readnone_);
+  EXPECT_FALSE(fib.norecurse_);
+  EXPECT_FALSE(fib.willreturn_);
+  auto sum = attrs.at("sum");
+  EXPECT_TRUE(sum.readnone_);
+  EXPECT_TRUE(sum.norecurse_);
+  EXPECT_FALSE(sum.willreturn_);
+
+  /// calls to unknown functions block every attribute
+  auto reseed = attrs.at("reseed");
+  EXPECT_FALSE(reseed.readonly_);
+  EXPECT_FALSE(reseed.nounwind_);
+  EXPECT_FALSE(attrs.contains("seed"));
+}
+
+} // namespace toyc